@@ -0,0 +1,327 @@
+/* crc32fast.c -- CRC-32 for zip and unzip, using the CPU's CRC instructions
+   where it has them
+
+   See crc32fast.h for a description of the implementations.
+
+   The PCLMULQDQ folding follows Intel's "Fast CRC Computation for Generic
+   Polynomials Using PCLMULQDQ Instruction" (Gopal et al., 2009), with the
+   constants for the bit-reflected CRC-32 polynomial (0xEDB88320).
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "crc32fast.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || defined(__GNUC__))
+#define CRC32_PCLMUL
+#include <cpuid.h>
+#include <immintrin.h>
+#elif (defined(__aarch64__) || defined(__arm64__)) && defined(__clang__)
+#define CRC32_ARMV8
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define CRC32_BIG_ENDIAN
+#endif
+
+/* Each implementation works on the CRC before and after its final
+   inversion, so they can be chained */
+typedef uint32_t (*crc32_func) (uint32_t crc, const unsigned char* buf, size_t len);
+
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+static crc32_func crc32_impl;
+static const char* crc32_impl_name;
+
+/* crc32_table[k][n] is the CRC of byte n followed by k zero bytes */
+static uint32_t crc32_table[8][256];
+
+static uint32_t crc32_slice8 (uint32_t crc, const unsigned char* buf, size_t len)
+{
+    while ((len > 0) && (((uintptr_t)buf & 7) != 0))
+    {
+        crc = crc32_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+
+#ifndef CRC32_BIG_ENDIAN
+    while (len >= 8)
+    {
+        uint32_t one, two;
+        memcpy(&one, buf, 4);
+        memcpy(&two, buf + 4, 4);
+        one ^= crc;
+
+        crc = crc32_table[7][one & 0xff] ^
+              crc32_table[6][(one >> 8) & 0xff] ^
+              crc32_table[5][(one >> 16) & 0xff] ^
+              crc32_table[4][one >> 24] ^
+              crc32_table[3][two & 0xff] ^
+              crc32_table[2][(two >> 8) & 0xff] ^
+              crc32_table[1][(two >> 16) & 0xff] ^
+              crc32_table[0][two >> 24];
+
+        buf += 8;
+        len -= 8;
+    }
+#endif
+
+    while (len > 0)
+    {
+        crc = crc32_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+
+    return crc;
+}
+
+#ifdef CRC32_PCLMUL
+/*
+  Fold 64 bytes at a time into four 128-bit accumulators, then those into
+  one, 16 bytes at a time into that, and finally reduce it to 32 bits
+  (Barrett reduction). Anything after the last 16-byte block is left to
+  slice-by-8
+*/
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul (uint32_t crc, const unsigned char* buf, size_t len)
+{
+    static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    if (len < 64)
+        return crc32_slice8(crc, buf, len);
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    /* Fold the four accumulators into one */
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    /* Fold 128 bits down to 64 */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i*)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    crc = (uint32_t)_mm_extract_epi32(x1, 1);
+
+    return (len > 0) ? crc32_slice8(crc, buf, len) : crc;
+}
+
+static int crc32_has_pclmul (void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+
+    /* PCLMULQDQ is bit 1 of ecx, and SSE4.1 bit 19 */
+    return ((ecx & (1u << 1)) != 0) && ((ecx & (1u << 19)) != 0);
+}
+#endif
+
+#ifdef CRC32_ARMV8
+__attribute__((target("crc")))
+static uint32_t crc32_armv8 (uint32_t crc, const unsigned char* buf, size_t len)
+{
+    while ((len > 0) && (((uintptr_t)buf & 7) != 0))
+    {
+        crc = __builtin_arm_crc32b(crc, *buf++);
+        len--;
+    }
+
+    /* Four independent loads per iteration, so the next ones are in flight
+       while the CRC of the last one is computed */
+    while (len >= 32)
+    {
+        uint64_t d0, d1, d2, d3;
+        memcpy(&d0, buf, 8);
+        memcpy(&d1, buf + 8, 8);
+        memcpy(&d2, buf + 16, 8);
+        memcpy(&d3, buf + 24, 8);
+
+        crc = __builtin_arm_crc32d(crc, d0);
+        crc = __builtin_arm_crc32d(crc, d1);
+        crc = __builtin_arm_crc32d(crc, d2);
+        crc = __builtin_arm_crc32d(crc, d3);
+
+        buf += 32;
+        len -= 32;
+    }
+
+    while (len >= 8)
+    {
+        uint64_t d;
+        memcpy(&d, buf, 8);
+        crc = __builtin_arm_crc32d(crc, d);
+        buf += 8;
+        len -= 8;
+    }
+
+    while (len > 0)
+    {
+        crc = __builtin_arm_crc32b(crc, *buf++);
+        len--;
+    }
+
+    return crc;
+}
+
+static int crc32_has_armv8 (void)
+{
+#if defined(__ARM_FEATURE_CRC32)
+    return 1;
+#elif defined(__APPLE__)
+    int value = 0;
+    size_t size = sizeof(value);
+    return (sysctlbyname("hw.optional.armv8_crc32", &value, &size, NULL, 0) == 0) && (value != 0);
+#elif defined(__linux__) && defined(HWCAP_CRC32)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return 0;
+#endif
+}
+#endif
+
+static void crc32_init (void)
+{
+    uint32_t n, c;
+    int k;
+
+    for (n = 0; n < 256; n++)
+    {
+        c = n;
+        for (k = 0; k < 8; k++)
+            c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+        crc32_table[0][n] = c;
+    }
+
+    for (n = 0; n < 256; n++)
+    {
+        c = crc32_table[0][n];
+        for (k = 1; k < 8; k++)
+        {
+            c = crc32_table[0][c & 0xff] ^ (c >> 8);
+            crc32_table[k][n] = c;
+        }
+    }
+
+    crc32_impl = crc32_slice8;
+    crc32_impl_name = "slice-by-8";
+
+#ifdef CRC32_PCLMUL
+    if (crc32_has_pclmul())
+    {
+        crc32_impl = crc32_pclmul;
+        crc32_impl_name = "pclmul";
+    }
+#endif
+
+#ifdef CRC32_ARMV8
+    if (crc32_has_armv8())
+    {
+        crc32_impl = crc32_armv8;
+        crc32_impl_name = "armv8";
+    }
+#endif
+}
+
+uLong crc32_fast (uLong crc, const Bytef* buf, size_t len)
+{
+    if (buf == NULL)
+        return 0;
+
+    pthread_once(&crc32_once, crc32_init);
+    return (uLong)(crc32_impl((uint32_t)crc ^ 0xffffffff, buf, len) ^ 0xffffffff);
+}
+
+const char* crc32_fast_implementation (void)
+{
+    pthread_once(&crc32_once, crc32_init);
+    return crc32_impl_name;
+}
@@ -0,0 +1,43 @@
+/* crc32fast.h -- CRC-32 for zip and unzip, using the CPU's CRC instructions
+   where it has them
+
+   Computes the same CRC-32 as zlib's crc32(), picking the fastest of these
+   the first time it's called:
+
+   - The ARMv8 CRC32 instructions
+   - Folding with carry-less multiplication (PCLMULQDQ), on x86 processors
+     that have it, along with SSE4.1
+   - Slice-by-8 table lookups, processing 8 bytes at a time, otherwise
+*/
+
+#ifndef _CRC32FAST_H
+#define _CRC32FAST_H
+
+#include <stddef.h>
+
+#ifndef _ZLIB_H
+#include "zlib.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Update a running CRC-32 with len bytes of buf, and return the updated CRC.
+  As with crc32(), start with 0, and if buf is NULL, 0 is returned. Unlike
+  crc32(), len isn't limited to 4 GB.
+*/
+extern uLong crc32_fast OF((uLong crc, const Bytef* buf, size_t len));
+
+/*
+  The name of the implementation crc32_fast uses on this CPU, for logging
+  and benchmarks: "armv8", "pclmul", or "slice-by-8"
+*/
+extern const char* crc32_fast_implementation OF((void));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRC32FAST_H */
@@ -32,7 +32,7 @@
 /***********************************************************************
  * Return the next byte in the pseudo-random sequence
  */
-static int decrypt_byte(unsigned long* pkeys, const unsigned long* pcrc_32_tab)
+static int decrypt_byte(unsigned long* pkeys, const z_crc_t* pcrc_32_tab)
 {
     unsigned temp;  /* POTENTIAL BUG:  temp*(temp^1) may overflow in an
                      * unpredictable manner on 16-bit systems; not a problem
@@ -45,7 +45,7 @@ static int decrypt_byte(unsigned long* pkeys, const unsigned long* pcrc_32_tab)
 /***********************************************************************
  * Update the encryption keys with the next byte of plain text
  */
-static int update_keys(unsigned long* pkeys,const unsigned long* pcrc_32_tab,int c)
+static int update_keys(unsigned long* pkeys,const z_crc_t* pcrc_32_tab,int c)
 {
     (*(pkeys+0)) = CRC32((*(pkeys+0)), c);
     (*(pkeys+1)) += (*(pkeys+0)) & 0xff;
@@ -62,7 +62,7 @@ static int update_keys(unsigned long* pkeys,const unsigned long* pcrc_32_tab,int
  * Initialize the encryption keys and the random header according to
  * the given password.
  */
-static void init_keys(const char* passwd,unsigned long* pkeys,const unsigned long* pcrc_32_tab)
+static void init_keys(const char* passwd,unsigned long* pkeys,const z_crc_t* pcrc_32_tab)
 {
     *(pkeys+0) = 305419896L;
     *(pkeys+1) = 591751049L;
@@ -76,6 +76,51 @@ static void init_keys(const char* passwd,unsigned long* pkeys,const unsigned lon
 #define zdecode(pkeys,pcrc_32_tab,c) \
     (update_keys(pkeys,pcrc_32_tab,c ^= decrypt_byte(pkeys,pcrc_32_tab)))
 
+#ifdef INCLUDEDECRYPTINGCODE
+
+/***********************************************************************
+ * Decrypt a buffer in place. Gives the same result as zdecode on each
+ * byte in turn, but keeps the keys in local variables for the whole
+ * buffer, instead of reloading them through pkeys for every byte
+ */
+#define ZCR_DECODE_STEP(buf,i) \
+    { \
+        unsigned temp = ((unsigned)key2 & 0xffff) | 2; \
+        c = (buf)[i] ^ (int)(((temp * (temp ^ 1)) >> 8) & 0xff); \
+        (buf)[i] = (unsigned char)c; \
+        key0 = CRC32(key0, c); \
+        key1 = (key1 + (key0 & 0xff)) * 134775813L + 1; \
+        key2 = CRC32(key2, (int)(key1 >> 24)); \
+    }
+
+static void zdecode_buffer(unsigned long* pkeys, const z_crc_t* pcrc_32_tab,
+                           unsigned char* buf, unsigned long len)
+{
+    unsigned long key0 = pkeys[0];
+    unsigned long key1 = pkeys[1];
+    unsigned long key2 = pkeys[2];
+    unsigned long i = 0;
+    int c;
+
+    /* Each byte depends on the keys left by the one before, so the
+     * unrolling only saves loop overhead */
+    for (; i + 4 <= len; i += 4)
+    {
+        ZCR_DECODE_STEP(buf, i)
+        ZCR_DECODE_STEP(buf, i + 1)
+        ZCR_DECODE_STEP(buf, i + 2)
+        ZCR_DECODE_STEP(buf, i + 3)
+    }
+    for (; i < len; i++)
+        ZCR_DECODE_STEP(buf, i)
+
+    pkeys[0] = key0;
+    pkeys[1] = key1;
+    pkeys[2] = key2;
+}
+
+#endif
+
 #define zencode(pkeys,pcrc_32_tab,c,t) \
     (t=decrypt_byte(pkeys,pcrc_32_tab), update_keys(pkeys,pcrc_32_tab,c), t^(c))
 
@@ -91,7 +136,7 @@ static int crypthead(const char* passwd,      /* password string */
                      unsigned char* buf,      /* where to write header */
                      int bufSize,
                      unsigned long* pkeys,
-                     const unsigned long* pcrc_32_tab,
+                     const z_crc_t* pcrc_32_tab,
                      unsigned long crcForCrypting)
 {
     int n;                       /* index in random header */
@@ -128,4 +173,43 @@ static int crypthead(const char* passwd,      /* password string */
     return n;
 }
 
+/***********************************************************************
+ * Encrypt a buffer in place. Gives the same result as zencode on each
+ * byte in turn, with the keys held in local variables as in
+ * zdecode_buffer
+ */
+#define ZCR_ENCODE_STEP(buf,i) \
+    { \
+        unsigned temp = ((unsigned)key2 & 0xffff) | 2; \
+        c = (buf)[i]; \
+        (buf)[i] = (unsigned char)(c ^ (int)(((temp * (temp ^ 1)) >> 8) & 0xff)); \
+        key0 = CRC32(key0, c); \
+        key1 = (key1 + (key0 & 0xff)) * 134775813L + 1; \
+        key2 = CRC32(key2, (int)(key1 >> 24)); \
+    }
+
+static void zencode_buffer(unsigned long* pkeys, const z_crc_t* pcrc_32_tab,
+                           unsigned char* buf, unsigned long len)
+{
+    unsigned long key0 = pkeys[0];
+    unsigned long key1 = pkeys[1];
+    unsigned long key2 = pkeys[2];
+    unsigned long i = 0;
+    int c;
+
+    for (; i + 4 <= len; i += 4)
+    {
+        ZCR_ENCODE_STEP(buf, i)
+        ZCR_ENCODE_STEP(buf, i + 1)
+        ZCR_ENCODE_STEP(buf, i + 2)
+        ZCR_ENCODE_STEP(buf, i + 3)
+    }
+    for (; i < len; i++)
+        ZCR_ENCODE_STEP(buf, i)
+
+    pkeys[0] = key0;
+    pkeys[1] = key1;
+    pkeys[2] = key2;
+}
+
 #endif
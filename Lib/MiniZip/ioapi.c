@@ -54,6 +54,13 @@ ZPOS64_T call_ztell64 (const zlib_filefunc64_32_def* pfilefunc,voidpf filestream
     }
 }
 
+const void* call_zmap64 (const zlib_filefunc64_32_def* pfilefunc,voidpf filestream, ZPOS64_T offset, uLong size)
+{
+    if (pfilefunc->zmap64_file == NULL)
+        return NULL;
+    return (*(pfilefunc->zmap64_file)) (pfilefunc->zfile_func64.opaque,filestream,offset,size);
+}
+
 void fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def* p_filefunc64_32,const zlib_filefunc_def* p_filefunc32)
 {
     p_filefunc64_32->zfile_func64.zopen64_file = NULL;
@@ -66,6 +73,7 @@ void fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def* p_filef
     p_filefunc64_32->zfile_func64.zclose_file = p_filefunc32->zclose_file;
     p_filefunc64_32->zfile_func64.zerror_file = p_filefunc32->zerror_file;
     p_filefunc64_32->zfile_func64.opaque = p_filefunc32->opaque;
+    p_filefunc64_32->zmap64_file = NULL;
     p_filefunc64_32->zseek32_file = p_filefunc32->zseek_file;
     p_filefunc64_32->ztell32_file = p_filefunc32->ztell_file;
 }
@@ -233,3 +241,305 @@ void fill_fopen64_filefunc (zlib_filefunc64_def*  pzlib_filefunc_def)
     pzlib_filefunc_def->zerror_file = ferror_file_func;
     pzlib_filefunc_def->opaque = NULL;
 }
+
+
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct
+{
+    const unsigned char* base;  /* NULL for an empty file */
+    ZPOS64_T size;
+    ZPOS64_T pos;
+} mmap_file_stream;
+
+static voidpf ZCALLBACK mmap_open64_file_func (voidpf opaque, const void* filename, int mode)
+{
+    mmap_file_stream* mfs;
+    struct stat st;
+    int fd;
+
+    if ((filename==NULL) || ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER)!=ZLIB_FILEFUNC_MODE_READ))
+        return NULL;
+
+    fd = open((const char*)filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    mfs = (mmap_file_stream*)malloc(sizeof(mmap_file_stream));
+    if ((mfs == NULL) || (fstat(fd, &st) != 0) || ((ZPOS64_T)st.st_size != (ZPOS64_T)(size_t)st.st_size))
+    {
+        free(mfs);
+        close(fd);
+        return NULL;
+    }
+
+    mfs->size = (ZPOS64_T)st.st_size;
+    mfs->pos = 0;
+    mfs->base = NULL;
+
+    if (mfs->size > 0)
+    {
+        void* base = mmap(NULL, (size_t)mfs->size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            free(mfs);
+            close(fd);
+            return NULL;
+        }
+        mfs->base = (const unsigned char*)base;
+    }
+
+    /* The mapping stays valid after the descriptor is closed */
+    close(fd);
+    return mfs;
+}
+
+static uLong ZCALLBACK mmap_read_file_func (voidpf opaque, voidpf stream, void* buf, uLong size)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    ZPOS64_T available = (mfs->pos < mfs->size) ? mfs->size - mfs->pos : 0;
+
+    if (size > available)
+        size = (uLong)available;
+    if (size > 0)
+        memcpy(buf, mfs->base + mfs->pos, (size_t)size);
+    mfs->pos += size;
+    return size;
+}
+
+static uLong ZCALLBACK mmap_write_file_func (voidpf opaque, voidpf stream, const void* buf, uLong size)
+{
+    return 0;
+}
+
+static ZPOS64_T ZCALLBACK mmap_tell64_file_func (voidpf opaque, voidpf stream)
+{
+    return ((mmap_file_stream*)stream)->pos;
+}
+
+static long ZCALLBACK mmap_seek64_file_func (voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    ZPOS64_T new_pos;
+
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        new_pos = mfs->pos + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        new_pos = mfs->size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        new_pos = offset;
+        break;
+    default: return -1;
+    }
+
+    if (new_pos > mfs->size)
+        return -1;
+    mfs->pos = new_pos;
+    return 0;
+}
+
+static const void* ZCALLBACK mmap_map64_file_func (voidpf opaque, voidpf stream, ZPOS64_T offset, uLong size)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+
+    if ((offset > mfs->size) || (size > mfs->size - offset))
+        return NULL;
+    return mfs->base + offset;
+}
+
+static int ZCALLBACK mmap_close_file_func (voidpf opaque, voidpf stream)
+{
+    mmap_file_stream* mfs = (mmap_file_stream*)stream;
+    int ret = 0;
+
+    if (mfs->base != NULL)
+        ret = munmap((void*)mfs->base, (size_t)mfs->size);
+    free(mfs);
+    return ret;
+}
+
+static int ZCALLBACK mmap_error_file_func (voidpf opaque, voidpf stream)
+{
+    return 0;
+}
+
+void fill_mmap64_filefunc (zlib_filefunc64_map_def*  pzlib_filefunc_def)
+{
+    pzlib_filefunc_def->zfile_func64.zopen64_file = mmap_open64_file_func;
+    pzlib_filefunc_def->zfile_func64.zread_file = mmap_read_file_func;
+    pzlib_filefunc_def->zfile_func64.zwrite_file = mmap_write_file_func;
+    pzlib_filefunc_def->zfile_func64.ztell64_file = mmap_tell64_file_func;
+    pzlib_filefunc_def->zfile_func64.zseek64_file = mmap_seek64_file_func;
+    pzlib_filefunc_def->zfile_func64.zclose_file = mmap_close_file_func;
+    pzlib_filefunc_def->zfile_func64.zerror_file = mmap_error_file_func;
+    pzlib_filefunc_def->zfile_func64.opaque = NULL;
+    pzlib_filefunc_def->zmap64_file = mmap_map64_file_func;
+}
+
+
+typedef struct
+{
+    int fd;
+    int owns_fd;    /* 0 when the descriptor is shared, and closed by the caller */
+    ZPOS64_T pos;
+    int error;
+} pread_file_stream;
+
+static voidpf ZCALLBACK pread_open64_file_func (voidpf opaque, const void* filename, int mode)
+{
+    pread_file_stream* pfs;
+    int fd;
+
+    if ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER)!=ZLIB_FILEFUNC_MODE_READ)
+        return NULL;
+
+    if (opaque != NULL)
+        fd = *(const int*)opaque;
+    else if (filename != NULL)
+        fd = open((const char*)filename, O_RDONLY);
+    else
+        return NULL;
+
+    if (fd < 0)
+        return NULL;
+
+    pfs = (pread_file_stream*)malloc(sizeof(pread_file_stream));
+    if (pfs == NULL)
+    {
+        if (opaque == NULL)
+            close(fd);
+        return NULL;
+    }
+
+    pfs->fd = fd;
+    pfs->owns_fd = (opaque == NULL);
+    pfs->pos = 0;
+    pfs->error = 0;
+    return pfs;
+}
+
+static uLong ZCALLBACK pread_read_file_func (voidpf opaque, voidpf stream, void* buf, uLong size)
+{
+    pread_file_stream* pfs = (pread_file_stream*)stream;
+    uLong done = 0;
+
+    while (done < size)
+    {
+        ssize_t n = pread(pfs->fd, (char*)buf + done, (size_t)(size - done), (off_t)(pfs->pos + done));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            pfs->error = errno;
+            break;
+        }
+        if (n == 0)
+            break;
+        done += (uLong)n;
+    }
+
+    pfs->pos += done;
+    return done;
+}
+
+static uLong ZCALLBACK pread_write_file_func (voidpf opaque, voidpf stream, const void* buf, uLong size)
+{
+    return 0;
+}
+
+static ZPOS64_T ZCALLBACK pread_tell64_file_func (voidpf opaque, voidpf stream)
+{
+    return ((pread_file_stream*)stream)->pos;
+}
+
+static long ZCALLBACK pread_seek64_file_func (voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+    pread_file_stream* pfs = (pread_file_stream*)stream;
+    struct stat st;
+
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        pfs->pos += offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        if (fstat(pfs->fd, &st) != 0)
+        {
+            pfs->error = errno;
+            return -1;
+        }
+        pfs->pos = (ZPOS64_T)st.st_size + offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        pfs->pos = offset;
+        break;
+    default: return -1;
+    }
+
+    return 0;
+}
+
+static int ZCALLBACK pread_close_file_func (voidpf opaque, voidpf stream)
+{
+    pread_file_stream* pfs = (pread_file_stream*)stream;
+    int ret = 0;
+
+    if (pfs->owns_fd)
+        ret = close(pfs->fd);
+    free(pfs);
+    return ret;
+}
+
+static int ZCALLBACK pread_error_file_func (voidpf opaque, voidpf stream)
+{
+    return ((pread_file_stream*)stream)->error;
+}
+
+void fill_pread64_filefunc (zlib_filefunc64_def*  pzlib_filefunc_def)
+{
+    fill_pread64_shared_filefunc(pzlib_filefunc_def, NULL);
+}
+
+void fill_pread64_shared_filefunc (zlib_filefunc64_def*  pzlib_filefunc_def, const int* pfd)
+{
+    pzlib_filefunc_def->zopen64_file = pread_open64_file_func;
+    pzlib_filefunc_def->zread_file = pread_read_file_func;
+    pzlib_filefunc_def->zwrite_file = pread_write_file_func;
+    pzlib_filefunc_def->ztell64_file = pread_tell64_file_func;
+    pzlib_filefunc_def->zseek64_file = pread_seek64_file_func;
+    pzlib_filefunc_def->zclose_file = pread_close_file_func;
+    pzlib_filefunc_def->zerror_file = pread_error_file_func;
+    pzlib_filefunc_def->opaque = (voidpf)(size_t)pfd;
+}
+
+#else
+
+void fill_mmap64_filefunc (zlib_filefunc64_map_def*  pzlib_filefunc_def)
+{
+    fill_fopen64_filefunc(&pzlib_filefunc_def->zfile_func64);
+    pzlib_filefunc_def->zmap64_file = NULL;
+}
+
+void fill_pread64_filefunc (zlib_filefunc64_def*  pzlib_filefunc_def)
+{
+    fill_fopen64_filefunc(pzlib_filefunc_def);
+}
+
+void fill_pread64_shared_filefunc (zlib_filefunc64_def*  pzlib_filefunc_def, const int* pfd)
+{
+    fill_fopen64_filefunc(pzlib_filefunc_def);
+}
+
+#endif
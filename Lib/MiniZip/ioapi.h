@@ -169,9 +169,34 @@ typedef struct zlib_filefunc64_def_s
     voidpf              opaque;
 } zlib_filefunc64_def;
 
+/* Returns a pointer to size bytes of the file starting at offset, valid until
+   the stream is closed, or NULL if that range can't be accessed directly */
+typedef const void* (ZCALLBACK *map64_file_func)  OF((voidpf opaque, voidpf stream, ZPOS64_T offset, uLong size));
+
+/* zlib_filefunc64_def along with the optional map function, for unzOpen2_64_map.
+   It's kept out of zlib_filefunc64_def, so callers that fill that in one field
+   at a time never leave it uninitialized */
+typedef struct zlib_filefunc64_map_def_s
+{
+    zlib_filefunc64_def zfile_func64;
+    map64_file_func     zmap64_file;
+} zlib_filefunc64_map_def;
+
 void fill_fopen64_filefunc OF((zlib_filefunc64_def* pzlib_filefunc_def));
 void fill_fopen_filefunc OF((zlib_filefunc_def* pzlib_filefunc_def));
 
+/* Read-only access through a memory mapping of the whole file, which also
+   provides zmap64_file so compressed data can be used in place */
+void fill_mmap64_filefunc OF((zlib_filefunc64_map_def* pzlib_filefunc_def));
+
+/* Read-only access built on pread. Every stream keeps its own offset instead
+   of sharing the descriptor's, so several unzFiles can read the same archive
+   at the same time. fill_pread64_filefunc opens a descriptor per stream, and
+   fill_pread64_shared_filefunc makes every stream read from *pfd, which the
+   caller keeps open until they're all closed. The Windows versions use stdio */
+void fill_pread64_filefunc OF((zlib_filefunc64_def* pzlib_filefunc_def));
+void fill_pread64_shared_filefunc OF((zlib_filefunc64_def* pzlib_filefunc_def, const int* pfd));
+
 /* now internal definition, only for zip.c and unzip.h */
 typedef struct zlib_filefunc64_32_def_s
 {
@@ -179,6 +204,7 @@ typedef struct zlib_filefunc64_32_def_s
     open_file_func      zopen32_file;
     tell_file_func      ztell32_file;
     seek_file_func      zseek32_file;
+    map64_file_func     zmap64_file;
 } zlib_filefunc64_32_def;
 
 
@@ -192,12 +218,14 @@ typedef struct zlib_filefunc64_32_def_s
 voidpf call_zopen64 OF((const zlib_filefunc64_32_def* pfilefunc,const void*filename,int mode));
 long    call_zseek64 OF((const zlib_filefunc64_32_def* pfilefunc,voidpf filestream, ZPOS64_T offset, int origin));
 ZPOS64_T call_ztell64 OF((const zlib_filefunc64_32_def* pfilefunc,voidpf filestream));
+const void* call_zmap64 OF((const zlib_filefunc64_32_def* pfilefunc,voidpf filestream, ZPOS64_T offset, uLong size));
 
 void    fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def* p_filefunc64_32,const zlib_filefunc_def* p_filefunc32);
 
 #define ZOPEN64(filefunc,filename,mode)         (call_zopen64((&(filefunc)),(filename),(mode)))
 #define ZTELL64(filefunc,filestream)            (call_ztell64((&(filefunc)),(filestream)))
 #define ZSEEK64(filefunc,filestream,pos,mode)   (call_zseek64((&(filefunc)),(filestream),(pos),(mode)))
+#define ZMAP64(filefunc,filestream,pos,size)    (call_zmap64((&(filefunc)),(filestream),(pos),(size)))
 
 #ifdef __cplusplus
 }
@@ -79,6 +79,11 @@
 
 #include "zlib.h"
 #include "unzip.h"
+#include "crc32fast.h"
+
+#ifndef NOUNCRYPT
+#include "wzaes.h"
+#endif
 
 #ifdef STDC
 #  include <stddef.h>
@@ -139,6 +144,7 @@ typedef struct unz_file_info64_internal_s
 typedef struct
 {
     char  *read_buffer;         /* internal buffer for compressed data */
+    uInt  read_buffer_size;     /* size of read_buffer */
     z_stream stream;            /* zLib stream structure for inflate */
 
 #ifdef HAVE_BZIP2
@@ -165,6 +171,26 @@ typedef struct
 } file_in_zip64_read_info_s;
 
 
+/* unz64_name_index is a hash table of the filenames in the central dir,
+   built on demand by unzLocateFileIndexed
+*/
+typedef struct
+{
+    ZPOS64_T name_offset;   /* offset of the filename in names, +1 (0 == empty slot) */
+    uLong hash;
+    unz64_file_pos file_pos;
+} unz64_name_index_slot;
+
+typedef struct
+{
+    int iCaseSensitivity;
+    ZPOS64_T slot_mask;     /* number of slots - 1, a power of 2 minus 1 */
+    unz64_name_index_slot* slots;
+    char* names;            /* null-terminated filenames, back to back */
+    ZPOS64_T names_used;
+} unz64_name_index;
+
+
 /* unz64_s contain internal information about the zipfile
 */
 typedef struct
@@ -191,14 +217,24 @@ typedef struct
 
     int isZip64;
 
+    unz64_name_index* name_index[2]; /* case sensitive, case insensitive */
+    uInt read_buffer_size;     /* size of the read buffer of files opened from now on */
+
 #    ifndef NOUNCRYPT
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
-    const unsigned long* pcrc_32_tab;
+    const z_crc_t* pcrc_32_tab;
+#    ifdef HAVE_AES
+    uLong aes_version;         /* AE-1 or AE-2 if the current file is encrypted with WinZip AES, otherwise 0 */
+    wzaes_ctx aes_ctx;
+    unz_derive_keys_callback derive_keys; /* replaces wzaes_derive_keys, if set */
+    void* derive_keys_opaque;
+#    endif
 #    endif
 } unz64_s;
 
 
 #ifndef NOUNCRYPT
+#define INCLUDEDECRYPTINGCODE
 #include "crypt.h"
 #endif
 
@@ -610,6 +646,7 @@ local unzFile unzOpenInternal (const void *path,
 
     us.z_filefunc.zseek32_file = NULL;
     us.z_filefunc.ztell32_file = NULL;
+    us.z_filefunc.zmap64_file = NULL;
     if (pzlib_filefunc64_32_def==NULL)
         fill_fopen64_filefunc(&us.z_filefunc.zfile_func64);
     else
@@ -755,6 +792,14 @@ local unzFile unzOpenInternal (const void *path,
     us.central_pos = central_pos;
     us.pfile_in_zip_read = NULL;
     us.encrypted = 0;
+#    ifdef HAVE_AES
+    us.aes_version = 0;
+    us.derive_keys = NULL;
+    us.derive_keys_opaque = NULL;
+#    endif
+    us.name_index[0] = NULL;
+    us.name_index[1] = NULL;
+    us.read_buffer_size = UNZ_BUFSIZE;
 
 
     s=(unz64_s*)ALLOC(sizeof(unz64_s));
@@ -789,6 +834,23 @@ extern unzFile ZEXPORT unzOpen2_64 (const void *path,
         zlib_filefunc64_32_def_fill.zfile_func64 = *pzlib_filefunc_def;
         zlib_filefunc64_32_def_fill.ztell32_file = NULL;
         zlib_filefunc64_32_def_fill.zseek32_file = NULL;
+        zlib_filefunc64_32_def_fill.zmap64_file = NULL;
+        return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 1);
+    }
+    else
+        return unzOpenInternal(path, NULL, 1);
+}
+
+extern unzFile ZEXPORT unzOpen2_64_map (const void *path,
+                                         const zlib_filefunc64_map_def* pzlib_filefunc_def)
+{
+    if (pzlib_filefunc_def != NULL)
+    {
+        zlib_filefunc64_32_def zlib_filefunc64_32_def_fill;
+        zlib_filefunc64_32_def_fill.zfile_func64 = pzlib_filefunc_def->zfile_func64;
+        zlib_filefunc64_32_def_fill.ztell32_file = NULL;
+        zlib_filefunc64_32_def_fill.zseek32_file = NULL;
+        zlib_filefunc64_32_def_fill.zmap64_file = pzlib_filefunc_def->zmap64_file;
         return unzOpenInternal(path, &zlib_filefunc64_32_def_fill, 1);
     }
     else
@@ -805,6 +867,8 @@ extern unzFile ZEXPORT unzOpen64 (const void *path)
     return unzOpenInternal(path, NULL, 1);
 }
 
+local void unz64local_FreeNameIndex OF((unz64_name_index* index));
+
 /*
   Close a ZipFile opened with unzipOpen.
   If there is files inside the .Zip opened with unzipOpenCurrentFile (see later),
@@ -820,6 +884,9 @@ extern int ZEXPORT unzClose (unzFile file)
     if (s->pfile_in_zip_read!=NULL)
         unzCloseCurrentFile(file);
 
+    unz64local_FreeNameIndex(s->name_index[0]);
+    unz64local_FreeNameIndex(s->name_index[1]);
+
     ZCLOSE64(s->z_filefunc, s->filestream);
     TRYFREE(s);
     return UNZ_OK;
@@ -1375,6 +1442,329 @@ extern int ZEXPORT unzGoToFilePos(
     return unzGoToFilePos64(file,&file_pos64);
 }
 
+extern int ZEXPORT unzGoToCentralDirEntry64(unzFile file,
+                                            const unz_file_info64* file_info,
+                                            const unz64_file_pos* file_pos,
+                                            ZPOS64_T offset_curfile)
+{
+    unz64_s* s;
+
+    if (file==NULL || file_info==NULL || file_pos==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+
+    if (file_pos->pos_in_zip_directory < s->offset_central_dir ||
+        file_pos->pos_in_zip_directory >= s->offset_central_dir + s->size_central_dir ||
+        file_pos->num_of_file >= s->gi.number_entry)
+        return UNZ_PARAMERROR;
+
+    s->pos_in_central_dir = file_pos->pos_in_zip_directory;
+    s->num_file           = file_pos->num_of_file;
+    s->cur_file_info      = *file_info;
+    s->cur_file_info_internal.offset_curfile = offset_curfile;
+    s->current_file_ok    = 1;
+    return UNZ_OK;
+}
+
+/*
+  Read the whole central directory with a single read, and decode the
+  entries from memory instead of going through unz64local_getByte for
+  every byte of every header.
+*/
+local uLong unz64local_readShortFromBuffer OF((const unsigned char* p));
+local uLong unz64local_readShortFromBuffer (const unsigned char* p)
+{
+    return (uLong)p[0] | ((uLong)p[1] << 8);
+}
+
+local uLong unz64local_readLongFromBuffer OF((const unsigned char* p));
+local uLong unz64local_readLongFromBuffer (const unsigned char* p)
+{
+    return (uLong)p[0] | ((uLong)p[1] << 8) | ((uLong)p[2] << 16) | ((uLong)p[3] << 24);
+}
+
+local ZPOS64_T unz64local_readLong64FromBuffer OF((const unsigned char* p));
+local ZPOS64_T unz64local_readLong64FromBuffer (const unsigned char* p)
+{
+    return (ZPOS64_T)unz64local_readLongFromBuffer(p) |
+           ((ZPOS64_T)unz64local_readLongFromBuffer(p + 4) << 32);
+}
+
+extern int ZEXPORT unzReadCentralDirectory64 (unzFile file,
+                                              unz_central_dir_callback callback,
+                                              void* opaque)
+{
+    unz64_s* s;
+    unsigned char* buf = NULL;
+    const unsigned char* cd;
+    const unsigned char* p;
+    const unsigned char* end;
+    ZPOS64_T num_file;
+    unz_central_dir_entry64 entry;
+    int err=UNZ_OK;
+
+    if (file==NULL || callback==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+
+    if ((ZPOS64_T)(uLong)s->size_central_dir != s->size_central_dir)
+        return UNZ_BADZIPFILE;
+    if (s->size_central_dir == 0)
+        return UNZ_OK;
+
+    /* Use the central dir in place if the file is memory-mapped */
+    cd = (const unsigned char*)ZMAP64(s->z_filefunc, s->filestream,
+                                      s->offset_central_dir+s->byte_before_the_zipfile,
+                                      (uLong)s->size_central_dir);
+    if (cd == NULL)
+    {
+        buf = (unsigned char*)ALLOC((uLong)s->size_central_dir);
+        if (buf==NULL)
+            return UNZ_INTERNALERROR;
+
+        if (ZSEEK64(s->z_filefunc, s->filestream,
+                    s->offset_central_dir+s->byte_before_the_zipfile,
+                    ZLIB_FILEFUNC_SEEK_SET)!=0)
+            err=UNZ_ERRNO;
+
+        if (err==UNZ_OK &&
+            ZREAD64(s->z_filefunc, s->filestream, buf, (uLong)s->size_central_dir)!=(uLong)s->size_central_dir)
+            err=UNZ_ERRNO;
+
+        cd = buf;
+    }
+
+    p = cd;
+    end = cd + s->size_central_dir;
+
+    for (num_file = 0; err==UNZ_OK && num_file < s->gi.number_entry; num_file++)
+    {
+        unz_file_info64* fi = &entry.file_info;
+        const unsigned char* extra;
+        const unsigned char* extra_end;
+
+        if ((ZPOS64_T)(end - p) < SIZECENTRALDIRITEM ||
+            unz64local_readLongFromBuffer(p) != 0x02014b50)
+        {
+            err=UNZ_BADZIPFILE;
+            break;
+        }
+
+        fi->version            = unz64local_readShortFromBuffer(p + 4);
+        fi->version_needed     = unz64local_readShortFromBuffer(p + 6);
+        fi->flag               = unz64local_readShortFromBuffer(p + 8);
+        fi->compression_method = unz64local_readShortFromBuffer(p + 10);
+        fi->dosDate            = unz64local_readLongFromBuffer(p + 12);
+        fi->crc                = unz64local_readLongFromBuffer(p + 16);
+        fi->compressed_size    = unz64local_readLongFromBuffer(p + 20);
+        fi->uncompressed_size  = unz64local_readLongFromBuffer(p + 24);
+        fi->size_filename      = unz64local_readShortFromBuffer(p + 28);
+        fi->size_file_extra    = unz64local_readShortFromBuffer(p + 30);
+        fi->size_file_comment  = unz64local_readShortFromBuffer(p + 32);
+        fi->disk_num_start     = unz64local_readShortFromBuffer(p + 34);
+        fi->internal_fa        = unz64local_readShortFromBuffer(p + 36);
+        fi->external_fa        = unz64local_readLongFromBuffer(p + 38);
+        entry.offset_curfile   = unz64local_readLongFromBuffer(p + 42);
+        unz64local_DosDateToTmuDate(fi->dosDate, &fi->tmu_date);
+
+        if ((ZPOS64_T)(end - p) < SIZECENTRALDIRITEM + fi->size_filename +
+                                  fi->size_file_extra + fi->size_file_comment)
+        {
+            err=UNZ_BADZIPFILE;
+            break;
+        }
+
+        entry.filename = (const char*)(p + SIZECENTRALDIRITEM);
+
+        /* ZIP64 extra field: only the values saturated in the fixed header are present */
+        extra = p + SIZECENTRALDIRITEM + fi->size_filename;
+        extra_end = extra + fi->size_file_extra;
+        while (extra_end - extra >= 4)
+        {
+            uLong headerId = unz64local_readShortFromBuffer(extra);
+            uLong dataSize = unz64local_readShortFromBuffer(extra + 2);
+            const unsigned char* data = extra + 4;
+            const unsigned char* data_end;
+
+            if ((uLong)(extra_end - data) < dataSize)
+                break;
+            data_end = data + dataSize;
+
+            if (headerId == 0x0001)
+            {
+                if (fi->uncompressed_size == 0xFFFFFFFF && data_end - data >= 8)
+                {
+                    fi->uncompressed_size = unz64local_readLong64FromBuffer(data);
+                    data += 8;
+                }
+                if (fi->compressed_size == 0xFFFFFFFF && data_end - data >= 8)
+                {
+                    fi->compressed_size = unz64local_readLong64FromBuffer(data);
+                    data += 8;
+                }
+                if (entry.offset_curfile == 0xFFFFFFFF && data_end - data >= 8)
+                    entry.offset_curfile = unz64local_readLong64FromBuffer(data);
+            }
+
+            extra = data_end;
+        }
+
+        entry.file_pos.pos_in_zip_directory = s->offset_central_dir + (ZPOS64_T)(p - cd);
+        entry.file_pos.num_of_file = num_file;
+
+        if (callback(&entry, opaque) != 0)
+            break;
+
+        p += SIZECENTRALDIRITEM + fi->size_filename + fi->size_file_extra + fi->size_file_comment;
+    }
+
+    TRYFREE(buf);
+    return err;
+}
+
+/*
+  Hash table of filenames, so looking up an entry by name doesn't scan the
+  whole central directory. Case insensitive tables fold ASCII letters, like
+  strcmpcasenosensitive_internal.
+*/
+local uLong unz64local_HashFileName OF((const char* fileName,
+                                        uLong size_filename,
+                                        int iCaseSensitivity));
+local uLong unz64local_HashFileName (const char* fileName,
+                                     uLong size_filename,
+                                     int iCaseSensitivity)
+{
+    uLong hash = 2166136261UL;   /* FNV-1a */
+    uLong i;
+    for (i = 0; i < size_filename; i++)
+    {
+        unsigned char c = (unsigned char)fileName[i];
+        if ((iCaseSensitivity != 1) && (c>='a') && (c<='z'))
+            c -= 0x20;
+        hash = ((hash ^ c) * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+local void unz64local_FreeNameIndex (unz64_name_index* index)
+{
+    if (index == NULL)
+        return;
+    TRYFREE(index->slots);
+    TRYFREE(index->names);
+    TRYFREE(index);
+}
+
+local int unz64local_AddToNameIndex OF((const unz_central_dir_entry64* entry, void* opaque));
+local int unz64local_AddToNameIndex (const unz_central_dir_entry64* entry, void* opaque)
+{
+    unz64_name_index* index = (unz64_name_index*)opaque;
+    uLong size_filename = entry->file_info.size_filename;
+    uLong hash = unz64local_HashFileName(entry->filename, size_filename, index->iCaseSensitivity);
+    char* name = index->names + index->names_used;
+    ZPOS64_T i;
+
+    memcpy(name, entry->filename, size_filename);
+    name[size_filename] = '\0';
+
+    for (i = hash & index->slot_mask; index->slots[i].name_offset != 0; i = (i + 1) & index->slot_mask)
+    {
+        /* Keep the first of several entries with the same name, like unzLocateFile */
+        if (index->slots[i].hash == hash &&
+            unzStringFileNameCompare(index->names + index->slots[i].name_offset - 1,
+                                     name, index->iCaseSensitivity) == 0)
+            return 0;
+    }
+
+    index->slots[i].name_offset = index->names_used + 1;
+    index->slots[i].hash = hash;
+    index->slots[i].file_pos = entry->file_pos;
+    index->names_used += size_filename + 1;
+    return 0;
+}
+
+local unz64_name_index* unz64local_BuildNameIndex OF((unz64_s* s, int iCaseSensitivity, int* perr));
+local unz64_name_index* unz64local_BuildNameIndex (unz64_s* s, int iCaseSensitivity, int* perr)
+{
+    unz64_name_index* index;
+    ZPOS64_T slot_count = 16;
+
+    while (slot_count < 2 * s->gi.number_entry)
+        slot_count <<= 1;
+
+    index = (unz64_name_index*)ALLOC(sizeof(unz64_name_index));
+    if (index == NULL)
+    {
+        *perr = UNZ_INTERNALERROR;
+        return NULL;
+    }
+
+    index->iCaseSensitivity = iCaseSensitivity;
+    index->slot_mask = slot_count - 1;
+    index->names_used = 0;
+    /* Filenames are stored in the central dir, so its size bounds theirs */
+    index->names = (char*)ALLOC((uLong)(s->size_central_dir + s->gi.number_entry + 1));
+    index->slots = (unz64_name_index_slot*)ALLOC((uLong)(slot_count * sizeof(unz64_name_index_slot)));
+
+    if (index->names == NULL || index->slots == NULL)
+    {
+        unz64local_FreeNameIndex(index);
+        *perr = UNZ_INTERNALERROR;
+        return NULL;
+    }
+    memset(index->slots, 0, (size_t)(slot_count * sizeof(unz64_name_index_slot)));
+
+    *perr = unzReadCentralDirectory64((unzFile)s, unz64local_AddToNameIndex, index);
+    if (*perr != UNZ_OK)
+    {
+        unz64local_FreeNameIndex(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+extern int ZEXPORT unzLocateFileIndexed (unzFile file, const char *szFileName, int iCaseSensitivity)
+{
+    unz64_s* s;
+    unz64_name_index* index;
+    uLong hash;
+    ZPOS64_T i;
+    int err = UNZ_OK;
+
+    if (file==NULL || szFileName==NULL)
+        return UNZ_PARAMERROR;
+
+    if (strlen(szFileName)>=UNZ_MAXFILENAMEINZIP)
+        return UNZ_PARAMERROR;
+
+    if (iCaseSensitivity==0)
+        iCaseSensitivity=CASESENSITIVITYDEFAULTVALUE;
+    if (iCaseSensitivity!=1)
+        iCaseSensitivity=2;
+
+    s=(unz64_s*)file;
+    index = s->name_index[iCaseSensitivity - 1];
+    if (index == NULL)
+    {
+        index = unz64local_BuildNameIndex(s, iCaseSensitivity, &err);
+        if (index == NULL)
+            return err;
+        s->name_index[iCaseSensitivity - 1] = index;
+    }
+
+    hash = unz64local_HashFileName(szFileName, (uLong)strlen(szFileName), iCaseSensitivity);
+    for (i = hash & index->slot_mask; index->slots[i].name_offset != 0; i = (i + 1) & index->slot_mask)
+    {
+        if (index->slots[i].hash == hash &&
+            unzStringFileNameCompare(index->names + index->slots[i].name_offset - 1,
+                                     szFileName, iCaseSensitivity) == 0)
+            return unzGoToFilePos64(file, &index->slots[i].file_pos);
+    }
+
+    return UNZ_END_OF_LIST_OF_FILE;
+}
+
 /*
 // Unzip Helper Functions - should be here?
 ///////////////////////////////////////////
@@ -1394,14 +1784,18 @@ local int unz64local_CheckCurrentFileCoherencyHeader (unz64_s* s, uInt* piSizeVa
     uLong uMagic,uData,uFlags;
     uLong size_filename;
     uLong size_extra_field;
+    ZPOS64_T uHeaderPos;
     int err=UNZ_OK;
 
     *piSizeVar = 0;
     *poffset_local_extrafield = 0;
     *psize_local_extrafield = 0;
 
-    if (ZSEEK64(s->z_filefunc, s->filestream,s->cur_file_info_internal.offset_curfile +
-                                s->byte_before_the_zipfile,ZLIB_FILEFUNC_SEEK_SET)!=0)
+    /* When files are read in the order they're stored, the local header
+       directly follows the previous file's data, so the stream is already there */
+    uHeaderPos = s->cur_file_info_internal.offset_curfile + s->byte_before_the_zipfile;
+    if ((ZTELL64(s->z_filefunc, s->filestream) != uHeaderPos) &&
+        (ZSEEK64(s->z_filefunc, s->filestream,uHeaderPos,ZLIB_FILEFUNC_SEEK_SET)!=0))
         return UNZ_ERRNO;
 
 
@@ -1431,6 +1825,9 @@ local int unz64local_CheckCurrentFileCoherencyHeader (unz64_s* s, uInt* piSizeVa
 /* #ifdef HAVE_BZIP2 */
                          (s->cur_file_info.compression_method!=Z_BZIP2ED) &&
 /* #endif */
+#ifdef HAVE_AES
+                         (s->cur_file_info.compression_method!=AES_METHOD) &&
+#endif
                          (s->cur_file_info.compression_method!=Z_DEFLATED))
         err=UNZ_BADZIPFILE;
 
@@ -1470,6 +1867,104 @@ local int unz64local_CheckCurrentFileCoherencyHeader (unz64_s* s, uInt* piSizeVa
     return err;
 }
 
+#ifdef HAVE_AES
+/*
+  Find the WinZip AES extra field in an extra field buffer, giving the AE
+  version, the key strength, and the real compression method
+*/
+local int unz64local_ParseAESExtraField (const unsigned char* extra, uLong size_extra,
+                                         uLong* version, int* strength,
+                                         uLong* compression_method)
+{
+    const unsigned char* p = extra;
+
+    while (extra + size_extra - p >= 4)
+    {
+        uLong headerId = unz64local_readShortFromBuffer(p);
+        uLong dataSize = unz64local_readShortFromBuffer(p + 2);
+
+        if ((uLong)(extra + size_extra - (p + 4)) < dataSize)
+            break;
+
+        if ((headerId == AES_EXTRAFIELD_ID) && (dataSize >= AES_EXTRAFIELD_SIZE) &&
+            (p[6] == 'A') && (p[7] == 'E'))
+        {
+            *version = unz64local_readShortFromBuffer(p + 4);
+            *strength = p[8];
+            *compression_method = unz64local_readShortFromBuffer(p + 9);
+            if (((*version == AES_VERSION_AE1) || (*version == AES_VERSION_AE2)) &&
+                (*strength >= AES_MODE_128) && (*strength <= AES_MODE_256))
+                return UNZ_OK;
+            break;
+        }
+
+        p += 4 + dataSize;
+    }
+
+    return UNZ_BADZIPFILE;
+}
+
+/*
+  Read the WinZip AES extra field from the local header of the current file
+*/
+local int unz64local_GetAESExtraField (unz64_s* s, ZPOS64_T offset_local_extrafield,
+                                       uInt size_local_extrafield, uLong* version,
+                                       int* strength, uLong* compression_method)
+{
+    unsigned char* extra;
+    int err;
+
+    extra = (unsigned char*)ALLOC(size_local_extrafield);
+    if (extra==NULL)
+        return UNZ_INTERNALERROR;
+
+    if ((ZSEEK64(s->z_filefunc, s->filestream, offset_local_extrafield + s->byte_before_the_zipfile,
+                 ZLIB_FILEFUNC_SEEK_SET)!=0) ||
+        (ZREAD64(s->z_filefunc, s->filestream, extra, size_local_extrafield)!=size_local_extrafield))
+    {
+        TRYFREE(extra);
+        return UNZ_ERRNO;
+    }
+
+    err = unz64local_ParseAESExtraField(extra, size_local_extrafield,
+                                        version, strength, compression_method);
+    TRYFREE(extra);
+    return err;
+}
+
+/*
+  Read the salt and password verifier of the current file, which start at
+  pos, and derive the keys for password, into derived.
+  return UNZ_BADPASSWORD if the password verifier doesn't match
+*/
+local int unz64local_DeriveAESKeys (unz64_s* s, ZPOS64_T pos, int strength,
+                                    const char* password, unsigned char* derived)
+{
+    unsigned char head[AES_MAXSALTLENGTH + AES_PWVERIFYSIZE];
+    uInt sizeSalt = AES_SALTLENGTH(strength);
+    uInt sizeHead = sizeSalt + AES_PWVERIFYSIZE;
+    int err;
+
+    if ((ZSEEK64(s->z_filefunc, s->filestream, pos + s->byte_before_the_zipfile,
+                 ZLIB_FILEFUNC_SEEK_SET)!=0) ||
+        (ZREAD64(s->z_filefunc, s->filestream, head, sizeHead)<sizeHead))
+        return UNZ_INTERNALERROR;
+
+    if (s->derive_keys != NULL)
+        err = s->derive_keys(strength, password, head, derived, s->derive_keys_opaque);
+    else
+        err = wzaes_derive_keys(strength, password, head, derived);
+
+    if (err != 0)
+        return UNZ_INTERNALERROR;
+
+    if (memcmp(AES_PWVERIFY(strength, derived), head + sizeSalt, AES_PWVERIFYSIZE) != 0)
+        return UNZ_BADPASSWORD;
+
+    return UNZ_OK;
+}
+#endif
+
 /*
   Open for reading data the current file in the zipfile.
   If there is no error and the file is opened, the return value is UNZ_OK.
@@ -1483,6 +1978,11 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
     file_in_zip64_read_info_s* pfile_in_zip_read_info;
     ZPOS64_T offset_local_extrafield;  /* offset of the local extra field */
     uInt  size_local_extrafield;    /* size of the local extra field */
+    uLong compression_method;
+#    ifdef HAVE_AES
+    uLong aes_version = 0;
+    int aes_strength = 0;
+#    endif
 #    ifndef NOUNCRYPT
     char source[12];
 #    else
@@ -1502,11 +2002,33 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
     if (unz64local_CheckCurrentFileCoherencyHeader(s,&iSizeVar, &offset_local_extrafield,&size_local_extrafield)!=UNZ_OK)
         return UNZ_BADZIPFILE;
 
+    compression_method = s->cur_file_info.compression_method;
+#    ifdef HAVE_AES
+    if (compression_method == AES_METHOD)
+    {
+        err = unz64local_GetAESExtraField(s, offset_local_extrafield, size_local_extrafield,
+                                          &aes_version, &aes_strength, &compression_method);
+        if (err != UNZ_OK)
+            return err;
+
+        /* the data can only be read if it can be decrypted */
+        if ((password == NULL) && (!raw))
+            return UNZ_BADPASSWORD;
+    }
+#    endif
+
     pfile_in_zip_read_info = (file_in_zip64_read_info_s*)ALLOC(sizeof(file_in_zip64_read_info_s));
     if (pfile_in_zip_read_info==NULL)
         return UNZ_INTERNALERROR;
 
-    pfile_in_zip_read_info->read_buffer=(char*)ALLOC(UNZ_BUFSIZE);
+    /* a large read buffer is only worth allocating if there's enough data to fill it */
+    pfile_in_zip_read_info->read_buffer_size=s->read_buffer_size;
+    if ((s->read_buffer_size > UNZ_BUFSIZE) &&
+        (s->cur_file_info.compressed_size < s->read_buffer_size))
+        pfile_in_zip_read_info->read_buffer_size =
+            (s->cur_file_info.compressed_size > UNZ_BUFSIZE) ?
+                (uInt)s->cur_file_info.compressed_size : UNZ_BUFSIZE;
+    pfile_in_zip_read_info->read_buffer=(char*)ALLOC(pfile_in_zip_read_info->read_buffer_size);
     pfile_in_zip_read_info->offset_local_extrafield = offset_local_extrafield;
     pfile_in_zip_read_info->size_local_extrafield = size_local_extrafield;
     pfile_in_zip_read_info->pos_local_extrafield=0;
@@ -1534,25 +2056,25 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
         }
     }
 
-    if ((s->cur_file_info.compression_method!=0) &&
+    if ((compression_method!=0) &&
 /* #ifdef HAVE_BZIP2 */
-        (s->cur_file_info.compression_method!=Z_BZIP2ED) &&
+        (compression_method!=Z_BZIP2ED) &&
 /* #endif */
-        (s->cur_file_info.compression_method!=Z_DEFLATED))
+        (compression_method!=Z_DEFLATED))
 
         err=UNZ_BADZIPFILE;
 
     pfile_in_zip_read_info->crc32_wait=s->cur_file_info.crc;
     pfile_in_zip_read_info->crc32=0;
     pfile_in_zip_read_info->total_out_64=0;
-    pfile_in_zip_read_info->compression_method = s->cur_file_info.compression_method;
+    pfile_in_zip_read_info->compression_method = compression_method;
     pfile_in_zip_read_info->filestream=s->filestream;
     pfile_in_zip_read_info->z_filefunc=s->z_filefunc;
     pfile_in_zip_read_info->byte_before_the_zipfile=s->byte_before_the_zipfile;
 
     pfile_in_zip_read_info->stream.total_out = 0;
 
-    if ((s->cur_file_info.compression_method==Z_BZIP2ED) && (!raw))
+    if ((compression_method==Z_BZIP2ED) && (!raw))
     {
 #ifdef HAVE_BZIP2
       pfile_in_zip_read_info->bstream.bzalloc = (void *(*) (void *, int, int))0;
@@ -1578,7 +2100,7 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
       pfile_in_zip_read_info->raw=1;
 #endif
     }
-    else if ((s->cur_file_info.compression_method==Z_DEFLATED) && (!raw))
+    else if ((compression_method==Z_DEFLATED) && (!raw))
     {
       pfile_in_zip_read_info->stream.zalloc = (alloc_func)0;
       pfile_in_zip_read_info->stream.zfree = (free_func)0;
@@ -1618,6 +2140,41 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
                 s->encrypted = 0;
 
 #    ifndef NOUNCRYPT
+#    ifdef HAVE_AES
+    if ((password != NULL) && (aes_version != 0))
+    {
+        /* The salt and password verifier come before the encrypted data,
+           and the authentication code after it */
+        unsigned char derived[AES_MAXDERIVEDKEYSIZE];
+        uInt sizeHead = AES_SALTLENGTH(aes_strength) + AES_PWVERIFYSIZE;
+
+        if (s->pfile_in_zip_read->rest_read_compressed < sizeHead + AES_AUTHCODESIZE)
+            err = UNZ_BADZIPFILE;
+        else
+            err = unz64local_DeriveAESKeys(s, s->pfile_in_zip_read->pos_in_zipfile,
+                                           aes_strength, password, derived);
+
+        if ((err == UNZ_OK) && (wzaes_init_keys(&s->aes_ctx, aes_strength, derived) != 0))
+            err = UNZ_INTERNALERROR;
+
+        if (err == UNZ_OK)
+            s->aes_version = aes_version;
+
+        memset(derived, 0, sizeof(derived));
+
+        /* don't leave a file open that can't be read */
+        if (err != UNZ_OK)
+        {
+            unzCloseCurrentFile(file);
+            return err;
+        }
+
+        s->pfile_in_zip_read->pos_in_zipfile+=sizeHead;
+        s->pfile_in_zip_read->rest_read_compressed-=sizeHead + AES_AUTHCODESIZE;
+        s->encrypted=1;
+    }
+    else
+#    endif
     if (password != NULL)
     {
         int i;
@@ -1643,6 +2200,132 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
     return UNZ_OK;
 }
 
+extern int ZEXPORT unzSetReadBufferSize (unzFile file, uInt size)
+{
+    unz64_s* s;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    s->read_buffer_size = (size == 0) ? UNZ_BUFSIZE : size;
+    return UNZ_OK;
+}
+
+extern int ZEXPORT unzSetDeriveKeysFunc (unzFile file, unz_derive_keys_callback callback,
+                                         void* opaque)
+{
+#    ifdef HAVE_AES
+    unz64_s* s;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    s->derive_keys = callback;
+    s->derive_keys_opaque = opaque;
+    return UNZ_OK;
+#    else
+    (void)callback;
+    (void)opaque;
+    return (file==NULL) ? UNZ_PARAMERROR : UNZ_OK;
+#    endif
+}
+
+extern int ZEXPORT unzCheckCurrentFilePassword (unzFile file, const char* password)
+{
+#    ifndef NOUNCRYPT
+    uInt iSizeVar;
+    unz64_s* s;
+    ZPOS64_T offset_local_extrafield;
+    uInt  size_local_extrafield;
+    ZPOS64_T pos_in_zipfile;
+    unsigned long keys[3];
+    const z_crc_t* pcrc_32_tab;
+    char source[12];
+    int i, check;
+
+    if ((file==NULL) || (password==NULL))
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    if ((!s->current_file_ok) || ((s->cur_file_info.flag & 1) == 0))
+        return UNZ_PARAMERROR;
+
+    if (unz64local_CheckCurrentFileCoherencyHeader(s,&iSizeVar, &offset_local_extrafield,&size_local_extrafield)!=UNZ_OK)
+        return UNZ_BADZIPFILE;
+
+    pos_in_zipfile = s->cur_file_info_internal.offset_curfile + SIZEZIPLOCALHEADER + iSizeVar;
+
+#    ifdef HAVE_AES
+    if (s->cur_file_info.compression_method == AES_METHOD)
+    {
+        unsigned char derived[AES_MAXDERIVEDKEYSIZE];
+        uLong aes_version, compression_method;
+        int aes_strength;
+        int err = unz64local_GetAESExtraField(s, offset_local_extrafield, size_local_extrafield,
+                                              &aes_version, &aes_strength, &compression_method);
+        if (err == UNZ_OK)
+            err = unz64local_DeriveAESKeys(s, pos_in_zipfile, aes_strength, password, derived);
+
+        memset(derived, 0, sizeof(derived));
+        return err;
+    }
+#    endif
+
+    if ((ZSEEK64(s->z_filefunc, s->filestream, pos_in_zipfile + s->byte_before_the_zipfile,
+                 ZLIB_FILEFUNC_SEEK_SET)!=0) ||
+        (ZREAD64(s->z_filefunc, s->filestream,source, 12)<12))
+        return UNZ_INTERNALERROR;
+
+    /* The last byte of the decrypted header is the high byte of the CRC, or
+       of the file time if the CRC comes after the data */
+    pcrc_32_tab = get_crc_table();
+    init_keys(password,keys,pcrc_32_tab);
+    for (i = 0; i<12; i++)
+        zdecode(keys,pcrc_32_tab,source[i]);
+
+    if (s->cur_file_info.flag & 8)
+        check = (int)((s->cur_file_info.dosDate >> 8) & 0xff);
+    else
+        check = (int)((s->cur_file_info.crc >> 24) & 0xff);
+
+    return ((source[11] & 0xff) == check) ? UNZ_OK : UNZ_BADPASSWORD;
+#    else
+    return UNZ_PARAMERROR;
+#    endif
+}
+
+extern int ZEXPORT unzGetCurrentFileAESVersion (unzFile file)
+{
+    unz64_s* s;
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    if (!s->current_file_ok)
+        return UNZ_PARAMERROR;
+
+#    if defined(HAVE_AES) && !defined(NOUNCRYPT)
+    if (s->cur_file_info.compression_method == AES_METHOD)
+    {
+        uLong size_extra = s->cur_file_info.size_file_extra;
+        uLong aes_version = 0, compression_method;
+        int aes_strength;
+        unsigned char* extra;
+        int err;
+
+        extra = (unsigned char*)ALLOC(size_extra + 1);
+        if (extra==NULL)
+            return UNZ_INTERNALERROR;
+
+        err = unzGetCurrentFileInfo64(file, NULL, NULL, 0, extra, size_extra, NULL, 0);
+        if (err == UNZ_OK)
+            err = unz64local_ParseAESExtraField(extra, size_extra, &aes_version,
+                                                &aes_strength, &compression_method);
+
+        TRYFREE(extra);
+        return (err == UNZ_OK) ? (int)aes_version : err;
+    }
+#    endif
+
+    return 0;
+}
+
 extern int ZEXPORT unzOpenCurrentFile (unzFile file)
 {
     return unzOpenCurrentFile3(file, NULL, NULL, 0, NULL);
@@ -1723,19 +2406,49 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
 
     while (pfile_in_zip_read_info->stream.avail_out>0)
     {
+        if ((pfile_in_zip_read_info->stream.avail_in==0) &&
+            (pfile_in_zip_read_info->rest_read_compressed>0) &&
+            (!s->encrypted))
+        {
+            /* If the file is memory-mapped, hand the compressed data to inflate in place */
+            uInt uMapThis = (uInt)-1;
+            const void* mapped;
+            if (pfile_in_zip_read_info->rest_read_compressed<uMapThis)
+                uMapThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
+
+            mapped = ZMAP64(pfile_in_zip_read_info->z_filefunc,
+                            pfile_in_zip_read_info->filestream,
+                            pfile_in_zip_read_info->pos_in_zipfile +
+                               pfile_in_zip_read_info->byte_before_the_zipfile,
+                            uMapThis);
+            if (mapped != NULL)
+            {
+                pfile_in_zip_read_info->pos_in_zipfile += uMapThis;
+                pfile_in_zip_read_info->rest_read_compressed-=uMapThis;
+                pfile_in_zip_read_info->stream.next_in = (Bytef*)mapped;
+                pfile_in_zip_read_info->stream.avail_in = uMapThis;
+            }
+        }
+
         if ((pfile_in_zip_read_info->stream.avail_in==0) &&
             (pfile_in_zip_read_info->rest_read_compressed>0))
         {
-            uInt uReadThis = UNZ_BUFSIZE;
+            uInt uReadThis = pfile_in_zip_read_info->read_buffer_size;
+            ZPOS64_T uReadPos = pfile_in_zip_read_info->pos_in_zipfile +
+                                pfile_in_zip_read_info->byte_before_the_zipfile;
             if (pfile_in_zip_read_info->rest_read_compressed<uReadThis)
                 uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
             if (uReadThis == 0)
                 return UNZ_EOF;
-            if (ZSEEK64(pfile_in_zip_read_info->z_filefunc,
+            /* Unless something else moved the stream, it's still where the
+               previous read left it. Seeking anyway can discard the stdio
+               read buffer, so only seek when the position is different */
+            if ((ZTELL64(pfile_in_zip_read_info->z_filefunc,
+                         pfile_in_zip_read_info->filestream) != uReadPos) &&
+                (ZSEEK64(pfile_in_zip_read_info->z_filefunc,
                       pfile_in_zip_read_info->filestream,
-                      pfile_in_zip_read_info->pos_in_zipfile +
-                         pfile_in_zip_read_info->byte_before_the_zipfile,
-                         ZLIB_FILEFUNC_SEEK_SET)!=0)
+                      uReadPos,
+                      ZLIB_FILEFUNC_SEEK_SET)!=0))
                 return UNZ_ERRNO;
             if (ZREAD64(pfile_in_zip_read_info->z_filefunc,
                       pfile_in_zip_read_info->filestream,
@@ -1745,14 +2458,19 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
 
 
 #            ifndef NOUNCRYPT
-            if(s->encrypted)
+#            ifdef HAVE_AES
+            if(s->encrypted && s->aes_version)
             {
-                uInt i;
-                for(i=0;i<uReadThis;i++)
-                  pfile_in_zip_read_info->read_buffer[i] =
-                      zdecode(s->keys,s->pcrc_32_tab,
-                              pfile_in_zip_read_info->read_buffer[i]);
+                if (wzaes_decrypt(&s->aes_ctx,
+                                  (unsigned char*)pfile_in_zip_read_info->read_buffer,uReadThis) != 0)
+                    return UNZ_INTERNALERROR;
             }
+            else
+#            endif
+            if(s->encrypted)
+                zdecode_buffer(s->keys,s->pcrc_32_tab,
+                               (unsigned char*)pfile_in_zip_read_info->read_buffer,
+                               uReadThis);
 #            endif
 
 
@@ -1767,7 +2485,7 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
 
         if ((pfile_in_zip_read_info->compression_method==0) || (pfile_in_zip_read_info->raw))
         {
-            uInt uDoCopy,i ;
+            uInt uDoCopy ;
 
             if ((pfile_in_zip_read_info->stream.avail_in == 0) &&
                 (pfile_in_zip_read_info->rest_read_compressed == 0))
@@ -1779,13 +2497,12 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
             else
                 uDoCopy = pfile_in_zip_read_info->stream.avail_in ;
 
-            for (i=0;i<uDoCopy;i++)
-                *(pfile_in_zip_read_info->stream.next_out+i) =
-                        *(pfile_in_zip_read_info->stream.next_in+i);
+            memcpy(pfile_in_zip_read_info->stream.next_out,
+                   pfile_in_zip_read_info->stream.next_in, uDoCopy);
 
             pfile_in_zip_read_info->total_out_64 = pfile_in_zip_read_info->total_out_64 + uDoCopy;
 
-            pfile_in_zip_read_info->crc32 = crc32(pfile_in_zip_read_info->crc32,
+            pfile_in_zip_read_info->crc32 = crc32_fast(pfile_in_zip_read_info->crc32,
                                 pfile_in_zip_read_info->stream.next_out,
                                 uDoCopy);
             pfile_in_zip_read_info->rest_read_uncompressed-=uDoCopy;
@@ -1822,7 +2539,7 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
 
             pfile_in_zip_read_info->total_out_64 = pfile_in_zip_read_info->total_out_64 + uOutThis;
 
-            pfile_in_zip_read_info->crc32 = crc32(pfile_in_zip_read_info->crc32,bufBefore, (uInt)(uOutThis));
+            pfile_in_zip_read_info->crc32 = crc32_fast(pfile_in_zip_read_info->crc32,bufBefore, (uInt)(uOutThis));
             pfile_in_zip_read_info->rest_read_uncompressed -= uOutThis;
             iRead += (uInt)(uTotalOutAfter - uTotalOutBefore);
 
@@ -1866,7 +2583,7 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
             pfile_in_zip_read_info->total_out_64 = pfile_in_zip_read_info->total_out_64 + uOutThis;
 
             pfile_in_zip_read_info->crc32 =
-                crc32(pfile_in_zip_read_info->crc32,bufBefore,
+                crc32_fast(pfile_in_zip_read_info->crc32,bufBefore,
                         (uInt)(uOutThis));
 
             pfile_in_zip_read_info->rest_read_uncompressed -=
@@ -2023,10 +2740,42 @@ extern int ZEXPORT unzCloseCurrentFile (unzFile file)
     if ((pfile_in_zip_read_info->rest_read_uncompressed == 0) &&
         (!pfile_in_zip_read_info->raw))
     {
-        if (pfile_in_zip_read_info->crc32 != pfile_in_zip_read_info->crc32_wait)
+        /* AE-2 doesn't store the CRC, only the authentication code below */
+        if ((pfile_in_zip_read_info->crc32 != pfile_in_zip_read_info->crc32_wait)
+#ifdef HAVE_AES
+            && (s->aes_version != AES_VERSION_AE2)
+#endif
+           )
             err=UNZ_CRCERROR;
     }
 
+#ifdef HAVE_AES
+    if (s->aes_version != 0)
+    {
+        unsigned char authcode[AES_AUTHCODESIZE];
+        unsigned char expected[AES_AUTHCODESIZE];
+
+        wzaes_end(&s->aes_ctx, authcode);
+
+        if ((pfile_in_zip_read_info->rest_read_uncompressed == 0) &&
+            (pfile_in_zip_read_info->rest_read_compressed == 0) &&
+            (!pfile_in_zip_read_info->raw))
+        {
+            if ((ZSEEK64(pfile_in_zip_read_info->z_filefunc, pfile_in_zip_read_info->filestream,
+                         pfile_in_zip_read_info->pos_in_zipfile +
+                            pfile_in_zip_read_info->byte_before_the_zipfile,
+                         ZLIB_FILEFUNC_SEEK_SET) != 0) ||
+                (ZREAD64(pfile_in_zip_read_info->z_filefunc, pfile_in_zip_read_info->filestream,
+                         expected, AES_AUTHCODESIZE) != AES_AUTHCODESIZE))
+                err = UNZ_ERRNO;
+            else if (memcmp(authcode, expected, AES_AUTHCODESIZE) != 0)
+                err = UNZ_CRCERROR;
+        }
+
+        s->aes_version = 0;
+    }
+#endif
+
 
     TRYFREE(pfile_in_zip_read_info->read_buffer);
     pfile_in_zip_read_info->read_buffer = NULL;
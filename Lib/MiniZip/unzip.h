@@ -79,6 +79,7 @@ typedef voidp unzFile;
 #define UNZ_BADZIPFILE                  (-103)
 #define UNZ_INTERNALERROR               (-104)
 #define UNZ_CRCERROR                    (-105)
+#define UNZ_BADPASSWORD                 (-106)
 
 /* tm_unz contain date/time info */
 typedef struct tm_unz_s
@@ -195,6 +196,13 @@ extern unzFile ZEXPORT unzOpen2_64 OF((const void *path,
       for read/write the zip file (see ioapi.h)
 */
 
+extern unzFile ZEXPORT unzOpen2_64_map OF((const void *path,
+                                    const zlib_filefunc64_map_def* pzlib_filefunc_def));
+/*
+   Open a Zip file, like unzOpen2_64, with a map function too, so data can be
+      read in place instead of being copied (see fill_mmap64_filefunc in ioapi.h)
+*/
+
 extern int ZEXPORT unzClose OF((unzFile file));
 /*
   Close a ZipFile opened with unzipOpen.
@@ -283,6 +291,57 @@ extern int ZEXPORT unzGoToFilePos64(
     unzFile file,
     const unz64_file_pos* file_pos);
 
+typedef struct unz_central_dir_entry64_s
+{
+    unz_file_info64 file_info;   /* public info about the file                  */
+    const char* filename;        /* file_info.size_filename bytes, not
+                                    null-terminated                             */
+    unz64_file_pos file_pos;     /* can be passed to unzGoToFilePos64           */
+    ZPOS64_T offset_curfile;     /* relative offset of the local header         */
+} unz_central_dir_entry64;
+
+typedef int (*unz_central_dir_callback) OF((const unz_central_dir_entry64* entry,
+                                            void* opaque));
+
+extern int ZEXPORT unzReadCentralDirectory64 OF((unzFile file,
+                                                 unz_central_dir_callback callback,
+                                                 void* opaque));
+/*
+  Read the whole central directory of the zipfile in a single read, and call
+    callback once per entry, in central directory order.
+  The entry (and its filename) is only valid for the duration of the call.
+  If callback returns a non-zero value, the enumeration stops.
+  Does not change the current file of the zipfile.
+  return UNZ_OK if the enumeration completed or was stopped by callback,
+    UNZ_BADZIPFILE if the central directory is corrupt, or UNZ_ERRNO if it
+    couldn't be read.
+*/
+
+extern int ZEXPORT unzGoToCentralDirEntry64 OF((unzFile file,
+                                                const unz_file_info64* file_info,
+                                                const unz64_file_pos* file_pos,
+                                                ZPOS64_T offset_curfile));
+/*
+  Same as unzGoToFilePos64, but takes the file's info from an entry passed to
+    the unzReadCentralDirectory64 callback instead of reading it from the
+    central directory again, so the zipfile isn't read at all. Going to files
+    in order of offset_curfile then reads their data front to back.
+  return UNZ_OK, or UNZ_PARAMERROR if file_pos isn't in the central directory
+*/
+
+extern int ZEXPORT unzLocateFileIndexed OF((unzFile file,
+                                            const char *szFileName,
+                                            int iCaseSensitivity));
+/*
+  Same as unzLocateFile, but looks the name up in a hash table instead of
+    scanning the central directory. The table is built from the central
+    directory the first time it's needed for a given iCaseSensitivity, and
+    kept until unzClose.
+  return value :
+  UNZ_OK if the file is found. It becomes the current file.
+  UNZ_END_OF_LIST_OF_FILE if the file is not found. The current file is unchanged
+*/
+
 /* ****************************************** */
 
 extern int ZEXPORT unzGetCurrentFileInfo64 OF((unzFile file,
@@ -328,6 +387,55 @@ extern ZPOS64_T ZEXPORT unzGetCurrentFileZStreamPos64 OF((unzFile file));
    from it, and close it (you can close it before reading all the file)
    */
 
+extern int ZEXPORT unzSetReadBufferSize OF((unzFile file, uInt size));
+/*
+  Set the size of the buffer compressed data is read into, for files opened
+    after the call. Larger buffers mean fewer, larger reads of the zipfile.
+  size is in bytes. 0 restores the default (UNZ_BUFSIZE, 16 KB)
+  return UNZ_OK, or UNZ_PARAMERROR if file is NULL
+*/
+
+typedef int (*unz_derive_keys_callback) OF((int strength,
+                                            const char* password,
+                                            const unsigned char* salt,
+                                            unsigned char* derived,
+                                            void* opaque));
+
+extern int ZEXPORT unzSetDeriveKeysFunc OF((unzFile file,
+                                            unz_derive_keys_callback callback,
+                                            void* opaque));
+/*
+  Derive the keys for files encrypted with WinZip AES by calling callback,
+    instead of deriving them every time a file is opened. The derivation is
+    deliberately slow, so callback can cache the keys for a password and
+    salt, and share them between zipfiles.
+  callback must write the same bytes as wzaes_derive_keys (see wzaes.h),
+    and return 0 if there is no problem.
+  NULL restores the default.
+  return UNZ_OK, or UNZ_PARAMERROR if file is NULL
+*/
+
+extern int ZEXPORT unzCheckCurrentFilePassword OF((unzFile file,
+                                                   const char* password));
+/*
+  Check password against the password verifier of the current file,
+    without opening it or reading its data.
+  For WinZip AES, the verifier is 2 bytes, so about 1 in 65536 wrong
+    passwords pass. For Traditional PKWARE Encryption it's a single byte,
+    and about 1 in 256 pass, so the only way to be sure is to read the file.
+  return UNZ_OK if password may be right, UNZ_BADPASSWORD if it's wrong, or
+    UNZ_PARAMERROR if the current file is not encrypted
+*/
+
+extern int ZEXPORT unzGetCurrentFileAESVersion OF((unzFile file));
+/*
+  Get the WinZip AES version of the current file, from its extra field in
+  the central directory.
+  return 1 (AE-1) or 2 (AE-2) for a file encrypted with AES, 0 for any other
+    file, or an error code (negative). AE-2 files don't store a CRC, and
+    are checked against their authentication code instead
+*/
+
 extern int ZEXPORT unzOpenCurrentFile OF((unzFile file));
 /*
   Open for reading data the current file in the zipfile.
@@ -338,8 +446,10 @@ extern int ZEXPORT unzOpenCurrentFilePassword OF((unzFile file,
                                                   const char* password));
 /*
   Open for reading data the current file in the zipfile.
-  password is a crypting password
-  If there is no error, the return value is UNZ_OK.
+  password is a crypting password, for Traditional PKWARE Encryption or
+    WinZip AES
+  If there is no error, the return value is UNZ_OK. For a file encrypted
+    with AES, UNZ_BADPASSWORD is returned if the password is wrong
 */
 
 extern int ZEXPORT unzOpenCurrentFile2 OF((unzFile file,
@@ -373,7 +483,8 @@ extern int ZEXPORT unzOpenCurrentFile3 OF((unzFile file,
 extern int ZEXPORT unzCloseCurrentFile OF((unzFile file));
 /*
   Close the file in zip opened with unzOpenCurrentFile
-  Return UNZ_CRCERROR if all the file was read but the CRC is not good
+  Return UNZ_CRCERROR if all the file was read but the CRC is not good, or
+    the file is encrypted with AES and its authentication code is not good
 */
 
 extern int ZEXPORT unzReadCurrentFile OF((unzFile file,
@@ -0,0 +1,143 @@
+/* wzaes.c -- WinZip AES encryption for zip and unzip
+
+   See wzaes.h for a description of the format.
+*/
+
+#include <string.h>
+#include "wzaes.h"
+
+#ifdef HAVE_AES
+
+#include <CommonCrypto/CommonKeyDerivation.h>
+
+#define AES_KEYITERATIONS (1000)
+
+int wzaes_derive_keys(int mode, const char* password, const unsigned char* salt,
+                      unsigned char* derived)
+{
+    /* One derivation gives the encryption key, the HMAC key, and the
+       password verifier, in that order */
+    if (CCKeyDerivationPBKDF(kCCPBKDF2, password, strlen(password),
+                             salt, AES_SALTLENGTH(mode),
+                             kCCPRFHmacAlgSHA1, AES_KEYITERATIONS,
+                             derived, AES_DERIVEDKEYSIZE(mode)) != kCCSuccess)
+        return -1;
+
+    return 0;
+}
+
+int wzaes_init_keys(wzaes_ctx* ctx, int mode, const unsigned char* derived)
+{
+    size_t keyLength = AES_KEYLENGTH(mode);
+
+    if (CCCryptorCreate(kCCEncrypt, kCCAlgorithmAES, kCCOptionECBMode,
+                        derived, keyLength, NULL, &ctx->cryptor) != kCCSuccess)
+        return -1;
+
+    CCHmacInit(&ctx->hmac, kCCHmacAlgSHA1, derived + keyLength, keyLength);
+    memset(ctx->counter, 0, sizeof(ctx->counter));
+    ctx->keystream_pos = sizeof(ctx->keystream);
+    return 0;
+}
+
+int wzaes_init(wzaes_ctx* ctx, int mode, const char* password,
+               const unsigned char* salt, unsigned char* pwverify)
+{
+    unsigned char derived[AES_MAXDERIVEDKEYSIZE];
+    int err = wzaes_derive_keys(mode, password, salt, derived);
+
+    if (err == 0)
+        err = wzaes_init_keys(ctx, mode, derived);
+
+    if (err == 0)
+        memcpy(pwverify, AES_PWVERIFY(mode, derived), AES_PWVERIFYSIZE);
+
+    memset(derived, 0, sizeof(derived));
+    return err;
+}
+
+/* Fill the keystream buffer with the next AES_KEYSTREAMBLOCKS counter
+   blocks, encrypted with a single call so CommonCrypto can keep the AES
+   units busy */
+static int wzaes_refill(wzaes_ctx* ctx)
+{
+    unsigned char* block = ctx->keystream;
+    unsigned int i, j;
+    size_t moved;
+
+    for (i = 0; i < AES_KEYSTREAMBLOCKS; i++, block += kCCBlockSizeAES128)
+    {
+        for (j = 0; j < kCCBlockSizeAES128 && ++ctx->counter[j] == 0; j++)
+            ;
+        memcpy(block, ctx->counter, kCCBlockSizeAES128);
+    }
+
+    if ((CCCryptorUpdate(ctx->cryptor, ctx->keystream, sizeof(ctx->keystream),
+                         ctx->keystream, sizeof(ctx->keystream), &moved) != kCCSuccess) ||
+        (moved != sizeof(ctx->keystream)))
+    {
+        /* never use a keystream that wasn't fully encrypted */
+        memset(ctx->keystream, 0, sizeof(ctx->keystream));
+        ctx->keystream_pos = sizeof(ctx->keystream);
+        return -1;
+    }
+
+    ctx->keystream_pos = 0;
+    return 0;
+}
+
+static int wzaes_xor(wzaes_ctx* ctx, unsigned char* buf, unsigned long len)
+{
+    while (len > 0)
+    {
+        unsigned long avail, i;
+        const unsigned char* keystream;
+
+        if ((ctx->keystream_pos == sizeof(ctx->keystream)) && (wzaes_refill(ctx) != 0))
+            return -1;
+
+        avail = sizeof(ctx->keystream) - ctx->keystream_pos;
+        if (avail > len)
+            avail = len;
+
+        keystream = ctx->keystream + ctx->keystream_pos;
+        for (i = 0; i < avail; i++)
+            buf[i] ^= keystream[i];
+
+        ctx->keystream_pos += (unsigned int)avail;
+        buf += avail;
+        len -= avail;
+    }
+
+    return 0;
+}
+
+int wzaes_encrypt(wzaes_ctx* ctx, unsigned char* buf, unsigned long len)
+{
+    if (wzaes_xor(ctx, buf, len) != 0)
+        return -1;
+
+    CCHmacUpdate(&ctx->hmac, buf, len);
+    return 0;
+}
+
+int wzaes_decrypt(wzaes_ctx* ctx, unsigned char* buf, unsigned long len)
+{
+    CCHmacUpdate(&ctx->hmac, buf, len);
+    return wzaes_xor(ctx, buf, len);
+}
+
+void wzaes_end(wzaes_ctx* ctx, unsigned char* authcode)
+{
+    unsigned char mac[CC_SHA1_DIGEST_LENGTH];
+
+    CCHmacFinal(&ctx->hmac, mac);
+    if (authcode != NULL)
+        memcpy(authcode, mac, AES_AUTHCODESIZE);
+
+    CCCryptorRelease(ctx->cryptor);
+    ctx->cryptor = NULL;
+    memset(ctx->keystream, 0, sizeof(ctx->keystream));
+}
+
+#endif /* HAVE_AES */
@@ -0,0 +1,115 @@
+/* wzaes.h -- WinZip AES encryption for zip and unzip
+
+   Implements the AE-1 and AE-2 formats described at
+   http://www.winzip.com/aes_info.htm, on top of CommonCrypto:
+
+   - The keys are derived from the password and salt with PBKDF2-HMAC-SHA1
+     (1000 iterations), which also produces a 2-byte password verifier
+   - The data is encrypted with AES in CTR mode, using a little-endian
+     counter that starts at 1
+   - The encrypted data is authenticated with HMAC-SHA1, truncated to
+     10 bytes
+
+   An encrypted entry has compression method 99, and an extra field
+   (0x9901) holding the real compression method. Its data is made up of
+   the salt, the password verifier, the encrypted data, and the
+   authentication code.
+
+   If you don't need AES encryption, or CommonCrypto isn't available,
+   define NOAES.
+*/
+
+#ifndef _WZAES_H
+#define _WZAES_H
+
+#if !defined(HAVE_AES) && !defined(NOAES) && defined(__APPLE__)
+#define HAVE_AES
+#endif
+
+#ifdef HAVE_AES
+
+#include <CommonCrypto/CommonCryptor.h>
+#include <CommonCrypto/CommonHMAC.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AES_METHOD          (99)
+#define AES_EXTRAFIELD_ID   (0x9901)
+#define AES_EXTRAFIELD_SIZE (7)     /* not counting the id and size */
+
+#define AES_VERSION_AE1     (1)     /* CRC is stored */
+#define AES_VERSION_AE2     (2)     /* CRC is not stored, and must be ignored */
+
+#define AES_MODE_128        (1)
+#define AES_MODE_192        (2)
+#define AES_MODE_256        (3)
+
+#define AES_KEYLENGTH(mode)  (8 * ((mode) & 3) + 8)
+#define AES_SALTLENGTH(mode) (4 * ((mode) & 3) + 4)
+#define AES_MAXSALTLENGTH   (16)
+#define AES_PWVERIFYSIZE    (2)
+#define AES_AUTHCODESIZE    (10)
+
+/* The keys derived from the password: the encryption key, the HMAC key,
+   and the password verifier */
+#define AES_DERIVEDKEYSIZE(mode)      (2 * AES_KEYLENGTH(mode) + AES_PWVERIFYSIZE)
+#define AES_MAXDERIVEDKEYSIZE         (2 * 32 + AES_PWVERIFYSIZE)
+#define AES_PWVERIFY(mode, derived)   ((derived) + 2 * AES_KEYLENGTH(mode))
+
+/* Counter blocks encrypted with each call to CommonCrypto */
+#define AES_KEYSTREAMBLOCKS (256)
+
+typedef struct
+{
+    CCCryptorRef cryptor;       /* AES in ECB mode, to encrypt the counter */
+    CCHmacContext hmac;         /* HMAC-SHA1 of the encrypted data */
+    unsigned char counter[kCCBlockSizeAES128];
+    unsigned char keystream[AES_KEYSTREAMBLOCKS * kCCBlockSizeAES128];
+    unsigned int keystream_pos; /* bytes of keystream already used */
+} wzaes_ctx;
+
+/*
+  Derive the keys for the password and salt (AES_SALTLENGTH(mode) bytes),
+  and set up ctx to encrypt or decrypt an entry. The password verifier is
+  written to pwverify (AES_PWVERIFYSIZE bytes).
+  return 0 if there is no problem. Once it has been initialised, ctx must
+  be released with wzaes_end.
+*/
+extern int wzaes_init(wzaes_ctx* ctx, int mode, const char* password,
+                      const unsigned char* salt, unsigned char* pwverify);
+
+/*
+  wzaes_init split in two, so the expensive derivation can be cached by the
+  caller: wzaes_derive_keys writes AES_DERIVEDKEYSIZE(mode) bytes to
+  derived, which wzaes_init_keys uses to set up ctx. The password
+  verifier is found in derived with AES_PWVERIFY.
+  Both return 0 if there is no problem.
+*/
+extern int wzaes_derive_keys(int mode, const char* password,
+                             const unsigned char* salt, unsigned char* derived);
+extern int wzaes_init_keys(wzaes_ctx* ctx, int mode, const unsigned char* derived);
+
+/*
+  Encrypt or decrypt len bytes in place. The keystream is generated for
+  many blocks at a time, so calls can be of any size.
+  return 0 if there is no problem, or -1 if the keystream couldn't be
+  generated, in which case buf must not be used.
+*/
+extern int wzaes_encrypt(wzaes_ctx* ctx, unsigned char* buf, unsigned long len);
+extern int wzaes_decrypt(wzaes_ctx* ctx, unsigned char* buf, unsigned long len);
+
+/*
+  Release ctx, writing the authentication code for the data encrypted or
+  decrypted to authcode (AES_AUTHCODESIZE bytes), unless it's NULL.
+*/
+extern void wzaes_end(wzaes_ctx* ctx, unsigned char* authcode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAVE_AES */
+
+#endif /* _WZAES_H */
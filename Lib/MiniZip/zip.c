@@ -28,6 +28,11 @@
 #include <time.h>
 #include "zlib.h"
 #include "zip.h"
+#include "crc32fast.h"
+
+#ifndef NOCRYPT
+#include "wzaes.h"
+#endif
 
 #ifdef STDC
 #  include <stddef.h>
@@ -157,8 +162,12 @@ typedef struct
     ZPOS64_T totalUncompressedData;
 #ifndef NOCRYPT
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
-    const unsigned long* pcrc_32_tab;
+    const z_crc_t* pcrc_32_tab;
     int crypt_header_size;
+#ifdef HAVE_AES
+    int aes;                   /* 1 if encrypting with WinZip AES */
+    wzaes_ctx aes_ctx;
+#endif
 #endif
 } curfile64_info;
 
@@ -173,6 +182,7 @@ typedef struct
     ZPOS64_T begin_pos;            /* position of the beginning of the zipfile */
     ZPOS64_T add_position_when_writting_offset;
     ZPOS64_T number_entry;
+    int aes_strength;              /* WinZip AES key strength for encrypted files, 0 for PKWARE */
 
 #ifndef NO_ADDFILEINEXISTINGZIP
     char *globalcomment;
@@ -854,6 +864,7 @@ extern zipFile ZEXPORT zipOpen3 (const void *pathname, int append, zipcharpc* gl
 
     ziinit.z_filefunc.zseek32_file = NULL;
     ziinit.z_filefunc.ztell32_file = NULL;
+    ziinit.z_filefunc.zmap64_file = NULL;
     if (pzlib_filefunc64_32_def==NULL)
         fill_fopen64_filefunc(&ziinit.z_filefunc.zfile_func64);
     else
@@ -875,6 +886,7 @@ extern zipFile ZEXPORT zipOpen3 (const void *pathname, int append, zipcharpc* gl
     ziinit.in_opened_file_inzip = 0;
     ziinit.ci.stream_initialised = 0;
     ziinit.number_entry = 0;
+    ziinit.aes_strength = 0;
     ziinit.add_position_when_writting_offset = 0;
     init_linkedlist(&(ziinit.central_dir));
 
@@ -937,6 +949,7 @@ extern zipFile ZEXPORT zipOpen2_64 (const void *pathname, int append, zipcharpc*
         zlib_filefunc64_32_def_fill.zfile_func64 = *pzlib_filefunc_def;
         zlib_filefunc64_32_def_fill.ztell32_file = NULL;
         zlib_filefunc64_32_def_fill.zseek32_file = NULL;
+        zlib_filefunc64_32_def_fill.zmap64_file = NULL;
         return zipOpen3(pathname, append, globalcomment, &zlib_filefunc64_32_def_fill);
     }
     else
@@ -955,28 +968,48 @@ extern zipFile ZEXPORT zipOpen64 (const void* pathname, int append)
     return zipOpen3(pathname,append,NULL,NULL);
 }
 
+#ifdef HAVE_AES
+/* The WinZip AES extra field, which holds the real compression method */
+local void zip64local_putAESExtraField_inmemory OF((const zip64_internal* zi, unsigned char* dest));
+local void zip64local_putAESExtraField_inmemory (const zip64_internal* zi, unsigned char* dest)
+{
+    zip64local_putValue_inmemory(dest, (uLong)AES_EXTRAFIELD_ID, 2);
+    zip64local_putValue_inmemory(dest+2, (uLong)AES_EXTRAFIELD_SIZE, 2);
+    zip64local_putValue_inmemory(dest+4, (uLong)AES_VERSION_AE1, 2);
+    dest[6] = 'A';
+    dest[7] = 'E';
+    dest[8] = (unsigned char)zi->aes_strength;
+    zip64local_putValue_inmemory(dest+9, (uLong)zi->ci.method, 2);
+}
+#endif
+
 int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_extrafield_local, const void* extrafield_local)
 {
   /* write the local header */
   int err;
   uInt size_filename = (uInt)strlen(filename);
   uInt size_extrafield = size_extrafield_local;
+  uLong method = (uLong)zi->ci.method;
+  uLong version = zi->ci.zip64 ? 45 : 20;
+
+#ifdef HAVE_AES
+  if (zi->ci.aes)
+  {
+    method = AES_METHOD;
+    version = 51;
+  }
+#endif
 
   err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)LOCALHEADERMAGIC, 4);
 
   if (err==ZIP_OK)
-  {
-    if(zi->ci.zip64)
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)45,2);/* version needed to extract */
-    else
-      err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)20,2);/* version needed to extract */
-  }
+    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,version,2);/* version needed to extract */
 
   if (err==ZIP_OK)
     err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.flag,2);
 
   if (err==ZIP_OK)
-    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.method,2);
+    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,method,2);
 
   if (err==ZIP_OK)
     err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)zi->ci.dosDate,4);
@@ -1007,6 +1040,11 @@ int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_ex
     size_extrafield += 20;
   }
 
+#ifdef HAVE_AES
+  if (zi->ci.aes)
+    size_extrafield += 4 + AES_EXTRAFIELD_SIZE;
+#endif
+
   if (err==ZIP_OK)
     err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)size_extrafield,2);
 
@@ -1022,6 +1060,16 @@ int Write_LocalFileHeader(zip64_internal* zi, const char* filename, uInt size_ex
       err = ZIP_ERRNO;
   }
 
+#ifdef HAVE_AES
+  if ((err==ZIP_OK) && (zi->ci.aes))
+  {
+    unsigned char aes_extrafield[4 + AES_EXTRAFIELD_SIZE];
+    zip64local_putAESExtraField_inmemory(zi, aes_extrafield);
+    if (ZWRITE64(zi->z_filefunc, zi->filestream, aes_extrafield, sizeof(aes_extrafield)) != sizeof(aes_extrafield))
+      err = ZIP_ERRNO;
+  }
+#endif
+
 
   if ((err==ZIP_OK) && (zi->ci.zip64))
   {
@@ -1063,6 +1111,7 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
     zip64_internal* zi;
     uInt size_filename;
     uInt size_comment;
+    uInt size_extrafield_aes = 0;
     uInt i;
     int err = ZIP_OK;
 
@@ -1074,13 +1123,16 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
     if (file == NULL)
         return ZIP_PARAMERROR;
 
+    if ((method!=0) && (method!=Z_DEFLATED)
 #ifdef HAVE_BZIP2
-    if ((method!=0) && (method!=Z_DEFLATED) && (method!=Z_BZIP2ED))
-      return ZIP_PARAMERROR;
-#else
-    if ((method!=0) && (method!=Z_DEFLATED))
-      return ZIP_PARAMERROR;
+        && (method!=Z_BZIP2ED)
+#endif
+#ifdef HAVE_AES
+        /* entries already encrypted with WinZip AES can be copied raw */
+        && ((method!=AES_METHOD) || (!raw) || (password != NULL))
 #endif
+       )
+      return ZIP_PARAMERROR;
 
     zi = (zip64_internal*)file;
 
@@ -1121,6 +1173,12 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
     if (password != NULL)
       zi->ci.flag |= 1;
 
+#ifdef HAVE_AES
+    zi->ci.aes = (password != NULL) && (zi->aes_strength != 0);
+    if (zi->ci.aes)
+      size_extrafield_aes = 4 + AES_EXTRAFIELD_SIZE;
+#endif
+
     zi->ci.crc32 = 0;
     zi->ci.method = method;
     zi->ci.encrypt = 0;
@@ -1129,24 +1187,26 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
     zi->ci.raw = raw;
     zi->ci.pos_local_header = ZTELL64(zi->z_filefunc,zi->filestream);
 
-    zi->ci.size_centralheader = SIZECENTRALHEADER + size_filename + size_extrafield_global + size_comment;
+    zi->ci.size_centralheader = SIZECENTRALHEADER + size_filename + size_extrafield_global + size_extrafield_aes + size_comment;
     zi->ci.size_centralExtraFree = 32; // Extra space we have reserved in case we need to add ZIP64 extra info data
 
     zi->ci.central_header = (char*)ALLOC((uInt)zi->ci.size_centralheader + zi->ci.size_centralExtraFree);
+    if (zi->ci.central_header == NULL)
+        return ZIP_INTERNALERROR;
 
-    zi->ci.size_centralExtra = size_extrafield_global;
+    zi->ci.size_centralExtra = size_extrafield_global + size_extrafield_aes;
     zip64local_putValue_inmemory(zi->ci.central_header,(uLong)CENTRALHEADERMAGIC,4);
     /* version info */
     zip64local_putValue_inmemory(zi->ci.central_header+4,(uLong)versionMadeBy,2);
-    zip64local_putValue_inmemory(zi->ci.central_header+6,(uLong)20,2);
+    zip64local_putValue_inmemory(zi->ci.central_header+6,(uLong)(size_extrafield_aes ? 51 : 20),2);
     zip64local_putValue_inmemory(zi->ci.central_header+8,(uLong)zi->ci.flag,2);
-    zip64local_putValue_inmemory(zi->ci.central_header+10,(uLong)zi->ci.method,2);
+    zip64local_putValue_inmemory(zi->ci.central_header+10,(uLong)(size_extrafield_aes ? 99 : zi->ci.method),2);
     zip64local_putValue_inmemory(zi->ci.central_header+12,(uLong)zi->ci.dosDate,4);
     zip64local_putValue_inmemory(zi->ci.central_header+16,(uLong)0,4); /*crc*/
     zip64local_putValue_inmemory(zi->ci.central_header+20,(uLong)0,4); /*compr size*/
     zip64local_putValue_inmemory(zi->ci.central_header+24,(uLong)0,4); /*uncompr size*/
     zip64local_putValue_inmemory(zi->ci.central_header+28,(uLong)size_filename,2);
-    zip64local_putValue_inmemory(zi->ci.central_header+30,(uLong)size_extrafield_global,2);
+    zip64local_putValue_inmemory(zi->ci.central_header+30,(uLong)zi->ci.size_centralExtra,2);
     zip64local_putValue_inmemory(zi->ci.central_header+32,(uLong)size_comment,2);
     zip64local_putValue_inmemory(zi->ci.central_header+34,(uLong)0,2); /*disk nm start*/
 
@@ -1172,11 +1232,15 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
         *(zi->ci.central_header+SIZECENTRALHEADER+size_filename+i) =
               *(((const char*)extrafield_global)+i);
 
+#ifdef HAVE_AES
+    if (zi->ci.aes)
+        zip64local_putAESExtraField_inmemory(zi, (unsigned char*)zi->ci.central_header+SIZECENTRALHEADER+size_filename+
+                                                 size_extrafield_global);
+#endif
+
     for (i=0;i<size_comment;i++)
         *(zi->ci.central_header+SIZECENTRALHEADER+size_filename+
-              size_extrafield_global+i) = *(comment+i);
-    if (zi->ci.central_header == NULL)
-        return ZIP_INTERNALERROR;
+              size_extrafield_global+size_extrafield_aes+i) = *(comment+i);
 
     zi->ci.zip64 = zip64;
     zi->ci.totalCompressedData = 0;
@@ -1240,6 +1304,30 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
 
 #    ifndef NOCRYPT
     zi->ci.crypt_header_size = 0;
+#ifdef HAVE_AES
+    if ((err==Z_OK) && (zi->ci.aes))
+    {
+        /* The salt and password verifier come before the encrypted data */
+        unsigned char bufHead[AES_MAXSALTLENGTH + AES_PWVERIFYSIZE];
+        unsigned int sizeSalt = AES_SALTLENGTH(zi->aes_strength);
+        unsigned int sizeHead = sizeSalt + AES_PWVERIFYSIZE;
+
+        arc4random_buf(bufHead, sizeSalt);
+        if (wzaes_init(&zi->ci.aes_ctx, zi->aes_strength, password, bufHead, bufHead + sizeSalt) != 0)
+            err = ZIP_INTERNALERROR;
+        else
+        {
+            zi->ci.encrypt = 1;
+            zi->ci.crypt_header_size = (int)sizeHead;
+
+            if (ZWRITE64(zi->z_filefunc,zi->filestream,bufHead,sizeHead) != sizeHead)
+                err = ZIP_ERRNO;
+            if (err != ZIP_OK)
+                wzaes_end(&zi->ci.aes_ctx, NULL);
+        }
+    }
+    else
+#endif
     if ((err==Z_OK) && (password != NULL))
     {
         unsigned char bufHead[RAND_HEAD_LEN];
@@ -1261,6 +1349,25 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 (zipFile file, const char* filename,
     return err;
 }
 
+extern int ZEXPORT zipSetAESEncryption (zipFile file, int strength)
+{
+    zip64_internal* zi;
+    if (file == NULL)
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+
+#ifdef HAVE_AES
+    if ((strength < 0) || (strength > AES_MODE_256))
+        return ZIP_PARAMERROR;
+#else
+    if (strength != 0)
+        return ZIP_PARAMERROR;
+#endif
+
+    zi->aes_strength = strength;
+    return ZIP_OK;
+}
+
 extern int ZEXPORT zipOpenNewFileInZip4 (zipFile file, const char* filename, const zip_fileinfo* zipfi,
                                          const void* extrafield_local, uInt size_extrafield_local,
                                          const void* extrafield_global, uInt size_extrafield_global,
@@ -1366,10 +1473,16 @@ local int zip64FlushWriteBuffer(zip64_internal* zi)
     if (zi->ci.encrypt != 0)
     {
 #ifndef NOCRYPT
-        uInt i;
-        int t;
-        for (i=0;i<zi->ci.pos_in_buffered_data;i++)
-            zi->ci.buffered_data[i] = zencode(zi->ci.keys, zi->ci.pcrc_32_tab, zi->ci.buffered_data[i],t);
+#ifdef HAVE_AES
+        if (zi->ci.aes)
+        {
+            /* callers only check for ZIP_ERRNO, and the buffer can't be written */
+            if (wzaes_encrypt(&zi->ci.aes_ctx, zi->ci.buffered_data, zi->ci.pos_in_buffered_data) != 0)
+                return ZIP_ERRNO;
+        }
+        else
+#endif
+        zencode_buffer(zi->ci.keys, zi->ci.pcrc_32_tab, zi->ci.buffered_data, zi->ci.pos_in_buffered_data);
 #endif
     }
 
@@ -1410,7 +1523,7 @@ extern int ZEXPORT zipWriteInFileInZip (zipFile file,const void* buf,unsigned in
     if (zi->in_opened_file_inzip == 0)
         return ZIP_PARAMERROR;
 
-    zi->ci.crc32 = crc32(zi->ci.crc32,buf,(uInt)len);
+    zi->ci.crc32 = crc32_fast(zi->ci.crc32,buf,(uInt)len);
 
 #ifdef HAVE_BZIP2
     if(zi->ci.method == Z_BZIP2ED && (!zi->ci.raw))
@@ -1480,15 +1593,13 @@ extern int ZEXPORT zipWriteInFileInZip (zipFile file,const void* buf,unsigned in
           }
           else
           {
-              uInt copy_this,i;
+              uInt copy_this;
               if (zi->ci.stream.avail_in < zi->ci.stream.avail_out)
                   copy_this = zi->ci.stream.avail_in;
               else
                   copy_this = zi->ci.stream.avail_out;
 
-              for (i = 0; i < copy_this; i++)
-                  *(((char*)zi->ci.stream.next_out)+i) =
-                      *(((const char*)zi->ci.stream.next_in)+i);
+              memcpy(zi->ci.stream.next_out, zi->ci.stream.next_in, copy_this);
               {
                   zi->ci.stream.avail_in -= copy_this;
                   zi->ci.stream.avail_out-= copy_this;
@@ -1579,6 +1690,21 @@ extern int ZEXPORT zipCloseFileInZipRaw64 (zipFile file, ZPOS64_T uncompressed_s
             err = ZIP_ERRNO;
                 }
 
+#ifdef HAVE_AES
+    /* The authentication code follows the encrypted data */
+    if (zi->ci.aes)
+    {
+        unsigned char authcode[AES_AUTHCODESIZE];
+        wzaes_end(&zi->ci.aes_ctx, authcode);
+        zi->ci.aes = 0;
+
+        if ((err==ZIP_OK) &&
+            (ZWRITE64(zi->z_filefunc,zi->filestream,authcode,AES_AUTHCODESIZE) != AES_AUTHCODESIZE))
+            err = ZIP_ERRNO;
+        zi->ci.crypt_header_size += AES_AUTHCODESIZE;
+    }
+#endif
+
     if ((zi->ci.method == Z_DEFLATED) && (!zi->ci.raw))
     {
         int tmp_err = deflateEnd(&zi->ci.stream);
@@ -1877,6 +2003,11 @@ int Write_GlobalComment(zip64_internal* zi, const char* global_comment)
 }
 
 extern int ZEXPORT zipClose (zipFile file, const char* global_comment)
+{
+    return zipClose2(file, global_comment, NULL);
+}
+
+extern int ZEXPORT zipClose2 (zipFile file, const char* global_comment, ZPOS64_T* zipfile_size)
 {
     zip64_internal* zi;
     int err = 0;
@@ -1933,6 +2064,9 @@ extern int ZEXPORT zipClose (zipFile file, const char* global_comment)
     if(err == ZIP_OK)
       err = Write_GlobalComment(zi, global_comment);
 
+    if (zipfile_size != NULL)
+      *zipfile_size = ZTELL64(zi->z_filefunc,zi->filestream);
+
     if (ZCLOSE64(zi->z_filefunc,zi->filestream) != 0)
         if (err == ZIP_OK)
             err = ZIP_ERRNO;
@@ -1945,6 +2079,95 @@ extern int ZEXPORT zipClose (zipFile file, const char* global_comment)
     return err;
 }
 
+extern int ZEXPORT zipRemoveCentralDirEntries (zipFile file, const ZPOS64_T* entries, ZPOS64_T count)
+{
+    zip64_internal* zi;
+    linkedlist_datablock_internal* ldi;
+    linkedlist_data new_central_dir;
+    unsigned char* central_dir;
+    uLong size_central_dir = 0;
+    uLong pos = 0;
+    ZPOS64_T entry = 0;
+    ZPOS64_T removed = 0;
+    int err = ZIP_OK;
+
+    if (file == NULL)
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+
+    if (zi->in_opened_file_inzip == 1)
+        return ZIP_PARAMERROR;
+
+    for (entry = 0; entry < count; entry++)
+        if ((entries[entry] >= zi->number_entry) || ((entry > 0) && (entries[entry] <= entries[entry-1])))
+            return ZIP_PARAMERROR;
+
+    if (count == 0)
+        return ZIP_OK;
+
+    /* Records can span datablocks, so flatten the central directory before walking it */
+    for (ldi = zi->central_dir.first_block; ldi != NULL; ldi = ldi->next_datablock)
+        size_central_dir += ldi->filled_in_this_block;
+
+    central_dir = (unsigned char*)ALLOC(size_central_dir);
+    if (central_dir == NULL)
+        return ZIP_INTERNALERROR;
+
+    for (ldi = zi->central_dir.first_block; ldi != NULL; ldi = ldi->next_datablock)
+    {
+        memcpy(central_dir + pos, ldi->data, ldi->filled_in_this_block);
+        pos += ldi->filled_in_this_block;
+    }
+
+    init_linkedlist(&new_central_dir);
+    pos = 0;
+
+    for (entry = 0; (entry < zi->number_entry) && (err == ZIP_OK); entry++)
+    {
+        const unsigned char* header = central_dir + pos;
+        uLong size_record;
+
+        if ((pos + SIZECENTRALHEADER > size_central_dir) ||
+            ((header[0] | (header[1] << 8) | (header[2] << 16) | ((uLong)header[3] << 24)) != CENTRALHEADERMAGIC))
+        {
+            err = ZIP_BADZIPFILE;
+            break;
+        }
+
+        size_record = SIZECENTRALHEADER +
+                      (header[28] | (header[29] << 8)) +   /* filename length */
+                      (header[30] | (header[31] << 8)) +   /* extra field length */
+                      (header[32] | (header[33] << 8));    /* file comment length */
+
+        if (pos + size_record > size_central_dir)
+        {
+            err = ZIP_BADZIPFILE;
+            break;
+        }
+
+        if ((removed < count) && (entries[removed] == entry))
+            removed++;
+        else
+            err = add_data_in_datablock(&new_central_dir, header, size_record);
+
+        pos += size_record;
+    }
+
+    TRYFREE(central_dir);
+
+    if (err != ZIP_OK)
+    {
+        free_linkedlist(&new_central_dir);
+        return err;
+    }
+
+    free_linkedlist(&zi->central_dir);
+    zi->central_dir = new_central_dir;
+    zi->number_entry -= removed;
+
+    return ZIP_OK;
+}
+
 extern int ZEXPORT zipRemoveExtraInfoBlock (char* pData, int* dataLen, short sHeader)
 {
   char* p = pData;
@@ -304,6 +304,15 @@ extern int ZEXPORT zipOpenNewFileInZip4_64 OF((zipFile file,
  */
 
 
+extern int ZEXPORT zipSetAESEncryption OF((zipFile file, int strength));
+/*
+  Choose how files opened from now on with a password are encrypted:
+    strength : 0 for Traditional PKWARE Encryption (the default), or the
+               WinZip AES key strength (1 for 128 bits, 2 for 192, 3 for 256)
+  return ZIP_PARAMERROR if AES encryption isn't available
+ */
+
+
 extern int ZEXPORT zipWriteInFileInZip OF((zipFile file,
                        const void* buf,
                        unsigned len));
@@ -336,6 +345,29 @@ extern int ZEXPORT zipClose OF((zipFile file,
   Close the zipfile
 */
 
+extern int ZEXPORT zipClose2 OF((zipFile file,
+                const char* global_comment,
+                ZPOS64_T* zipfile_size));
+/*
+  Close the zipfile, like zipClose, and set zipfile_size to the position where
+    writing ended. If entries were removed with zipRemoveCentralDirEntries, that
+    can be short of the end of the file, which should then be truncated to it
+*/
+
+extern int ZEXPORT zipRemoveCentralDirEntries OF((zipFile file,
+                                                  const ZPOS64_T* entries,
+                                                  ZPOS64_T count));
+/*
+  Remove entries from the central directory that will be written when the zipfile
+    is closed, such as entries read from an existing zipfile opened with
+    APPEND_STATUS_ADDINZIP. entries holds the zero-based positions of the entries
+    to remove, in ascending order. The data of removed entries stays in the
+    zipfile, but is no longer referenced by it.
+  return ZIP_OK if all the entries were removed, ZIP_PARAMERROR if a file in the
+    zipfile is open or a position is out of range or out of order, or
+    ZIP_BADZIPFILE if the central directory is corrupt
+*/
+
 
 extern int ZEXPORT zipRemoveExtraInfoBlock OF((char* pData, int* dataLen, short sHeader));
 /*
@@ -8,6 +8,7 @@
 #import <CoreGraphics/CoreGraphics.h>
 
 #import "UZKFileInfo.h"
+#import "UZKWriteEntry.h"
 
 /**
  *  Defines the various error codes that the listing and extraction methods return.
@@ -119,6 +120,28 @@ typedef NS_ENUM(NSInteger, UZKErrorCode) {
      *  User cancelled the operation
      */
     UZKErrorCodeUserCancelled = 116,
+    
+    /**
+     *  The journal left behind by an interrupted in-place deletion is damaged, or doesn't belong to the
+     *  archive, so the deletion can't be finished. See -discardDeletionJournal:
+     */
+    UZKErrorCodeDeletionJournalDamaged = 117,
+};
+
+/**
+ *  Defines how files written with a password are encrypted
+ */
+typedef NS_ENUM(NSInteger, UZKEncryptionMethod) {
+    
+    /**
+     *  Traditional PKWARE encryption, which any unzip tool can read, but is weak
+     */
+    UZKEncryptionMethodPKWARE = 0,
+    
+    /**
+     *  WinZip AES encryption, with a 256-bit key. Read by most current tools, though not Info-ZIP's unzip
+     */
+    UZKEncryptionMethodAES256 = 3,
 };
 
 
@@ -177,6 +200,104 @@ extern NSString *UZKErrorDomain;
  */
 @property(nullable, strong) NSProgress *progress;
 
+/**
+ *  When YES, the archive is memory-mapped while it's open for reading, instead of being read
+ *  through buffered file I/O. Compressed data is then decompressed straight out of the mapping,
+ *  without being copied into an intermediate buffer first. Defaults to NO.
+ *
+ *  Only enable this for archives that won't be truncated or rewritten by another process while
+ *  they're being read, since accessing a mapping past the end of its file crashes the process
+ */
+@property(assign) BOOL useMemoryMappedIO;
+
+/**
+ *  The maximum number of files -extractFilesTo:overwrite:error: extracts at the same time. Each
+ *  concurrent extraction reads the archive through its own file handle, and the largest files are
+ *  started first. Defaults to 1, which extracts files one at a time, and 0 uses one per active
+ *  processor core.
+ *
+ *  When extracting in parallel, the deprecated progress block may be called from any thread, though
+ *  never from more than one at a time
+ */
+@property(assign) NSUInteger maxConcurrentExtractions;
+
+/**
+ *  The maximum number of threads used to compress a single file written with -writeData: or
+ *  -writeIntoBuffer:. Data is split into 128 KB blocks that are compressed in parallel, and joined into
+ *  one standard Deflate stream, which is slightly larger than if it were compressed on one thread.
+ *  Defaults to 1, which compresses each file on the calling thread, and 0 uses one per active processor
+ *  core. Has no effect on files written with UZKCompressionMethodNone, or on data smaller than one block
+ */
+@property(assign) NSUInteger maxConcurrentCompressions;
+
+/**
+ *  The size, in bytes, of the buffer compressed data is read into while extracting files. Each time
+ *  the buffer runs out, the next chunk of the file is read from the archive, so larger sizes mean
+ *  fewer, larger reads, which helps most on network file systems. Sizes of 1–4 MB work well for
+ *  large sequential reads. Defaults to 0, which uses MiniZip's default of 16 KB. Takes effect the
+ *  next time a file in the archive is opened
+ */
+@property(assign) NSUInteger readBufferSize;
+
+/**
+ *  When YES, read operations on this archive object can run on several threads at the same time,
+ *  instead of one after another. Each thread reads through its own file handle, and they all share
+ *  the same parsed copy of the central directory. Write operations still have exclusive access, and
+ *  wait for any reads in progress to finish before they start. Defaults to NO.
+ *
+ *  Starting a write operation from inside the block passed to a read operation on the same thread
+ *  fails with a UZKErrorCodeMixedModeAccess error
+ */
+@property(assign) BOOL allowsConcurrentReads;
+
+/**
+ *  How long, in seconds, the archive is kept open for reading after a read operation completes, so
+ *  the next one can skip opening it and locating its central directory again. A kept handle is only
+ *  reused if the archive's size and modification date haven't changed since it was opened, and all
+ *  kept handles are closed before the archive is written to. Defaults to 0, which closes the archive
+ *  after every operation.
+ *
+ *  When allowsConcurrentReads is YES, idle handles are always kept, and a value of 0 keeps them open
+ *  until the next write operation
+ */
+@property(assign) NSTimeInterval idleHandleTimeout;
+
+/**
+ *  The maximum number of idle read handles kept open, as described by idleHandleTimeout. Defaults to
+ *  0, which keeps up to one per active processor core
+ */
+@property(assign) NSUInteger maxIdleHandles;
+
+/**
+ *  If YES, writing a file with overwrite:YES appends the new version and drops the old one from the
+ *  central directory, instead of copying the rest of the archive to delete it first. That makes
+ *  updating a file take time proportional to its size and the size of the central directory, rather
+ *  than the whole archive, but the old data stays in the archive as unused space until it's reclaimed
+ *  with -compactArchive:. Defaults to NO
+ */
+@property(assign) BOOL overwritesByAppending;
+
+/**
+ *  If YES, deleting files and compacting the archive slide the remaining files down over the freed
+ *  space within the archive, instead of writing a new copy of it and replacing the original. That
+ *  needs no free disk space beyond a journal kept beside the archive while it works, about the size
+ *  of the central directory plus up to 4 MB. If there isn't room for it, the deletion fails before
+ *  the archive is changed. If the process is interrupted, the next operation on the archive uses
+ *  the journal to finish the job before doing anything else. If the journal can't be used, every
+ *  operation fails with UZKErrorCodeDeletionJournalDamaged until it's removed with
+ *  -discardDeletionJournal:. Defaults to NO
+ *
+ *  Data returned by -extractMappedDataFromFile: before an in-place deletion must not be used after it
+ */
+@property(assign) BOOL deletesInPlace;
+
+/**
+ *  How files written with a password are encrypted. Defaults to UZKEncryptionMethodPKWARE. Files encrypted
+ *  either way can always be read, and AES-encrypted files are checked against their authentication code
+ *  when they're extracted, as well as their CRC
+ */
+@property(assign) UZKEncryptionMethod encryptionMethod;
+
 
 /**
  *  DEPRECATED: Creates and returns an archive at the given path
@@ -393,6 +514,64 @@ extern NSString *UZKErrorDomain;
                                 progress:(nullable void (^)(CGFloat percentDecompressed))progress
                                    error:(NSError **)error __deprecated_msg("Use -extractDataFromFile:error: instead, and if using the progress block, replace with NSProgress as described in the README");
 
+/**
+ *  Unarchive a single file from the archive into memory without copying it, if possible. Files stored
+ *  without compression or encryption are returned as an NSData object that points straight into a
+ *  read-only memory mapping of the archive, so no bytes are read until they're accessed. Any other file
+ *  is extracted the same way as with -extractDataFromFile:error:
+ *
+ *  The returned data keeps the mapping alive, even after the archive object is released. Only use this
+ *  for archives that won't be truncated or rewritten by another process while the data is in use, since
+ *  accessing a mapping past the end of its file crashes the process
+ *
+ *  @param filePath  The path of the file within the archive to be expanded
+ *  @param verifyCRC If YES, the CRC of a mapped file is checked before it's returned, which reads the
+ *                   whole file from disk. If NO, the file is returned without being checked
+ *  @param error     Contains an NSError object when there was an error reading the archive
+ *
+ *  @return An NSData object containing the bytes of the file, or nil if an error was encountered
+ */
+- (nullable NSData *)extractMappedDataFromFile:(NSString *)filePath
+                                     verifyCRC:(BOOL)verifyCRC
+                                         error:(NSError **)error;
+
+/**
+ *  Unarchive several files from the archive into memory. The files are read in the order they're stored
+ *  in the archive, in a single pass through it, instead of the order they're listed in. Supports NSProgress
+ *  for progress reporting, which also allows cancellation in the middle of extraction
+ *
+ *  @param filePaths The paths of the files within the archive to be expanded
+ *  @param error     Contains an NSError object when there was an error reading the archive, or when any of
+ *                   the files couldn't be found in it
+ *
+ *  @return The bytes of each file, keyed by the filename property of its UZKFileInfo, or nil if an error
+ *          was encountered
+ */
+- (nullable NSDictionary<NSString*, NSData*> *)extractDataFromFiles:(NSArray<NSString*> *)filePaths
+                                                              error:(NSError **)error;
+
+/**
+ *  Unarchive several files from the archive into memory one at a time, allowing you to perform an action
+ *  on each one's data, and release it before the next one is read. The files are read in the order they're
+ *  stored in the archive, in a single pass through it, instead of the order they're listed in. Supports
+ *  NSProgress for progress reporting, which also allows cancellation in the middle of extraction
+ *
+ *  @param filePaths The paths of the files within the archive to be expanded. Each file is only read once,
+ *                   even if it's listed more than once
+ *  @param error     Contains an NSError object when there was an error reading the archive, or when any of
+ *                   the files couldn't be found in it. Nothing is read in that case
+ *  @param action    The action to perform using the data
+ *
+ *       - *fileInfo* The metadata of the file within the archive
+ *       - *fileData* The full data of the file in the archive
+ *       - *stop*     Set to YES to stop reading the archive
+ *
+ *  @return YES if no errors were encountered, NO otherwise
+ */
+- (BOOL)extractDataFromFiles:(NSArray<NSString*> *)filePaths
+                       error:(NSError **)error
+                      action:(void(^)(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop))action;
+
 /**
  *  Loops through each file in the archive into memory, allowing you to perform an action
  *  using its info. Supports NSProgress for progress reporting, which also
@@ -445,13 +624,39 @@ extern NSString *UZKErrorDomain;
                               error:(NSError **)error
                              action:(void(^)(NSData *dataChunk, CGFloat percentDecompressed))action;
 
+/**
+ *  Unarchive a single file from the archive, one chunk at a time, reusing a single buffer for every chunk.
+ *  Each chunk is passed to the action block as a pointer into that buffer, rather than as a new NSData object,
+ *  so no memory is allocated or copied per chunk. Supports NSProgress for progress reporting, which also allows
+ *  cancellation in the middle of extraction
+ *
+ *  @param filePath   The path of the file within the archive to be expanded
+ *  @param chunkSize  The size of the buffer to decompress into, in bytes. Pass 0 for the default of 256 KB.
+ *                    Sizes over INT_MAX are capped at INT_MAX
+ *  @param error      Contains an NSError object when there was an error reading the archive
+ *  @param action     The block to run for each chunk of data, each of size <= chunkSize
+ *
+ *       - *bytes*               The data read from the archived file. Only valid until the block returns, so
+ *                               copy any bytes that need to outlive it
+ *       - *length*              The number of bytes read
+ *       - *percentDecompressed* The percentage of the file that has been decompressed
+ *
+ *  @return YES if all data was read successfully, NO if an error was encountered
+ */
+- (BOOL)extractBufferedDataFromFile:(NSString *)filePath
+                          chunkSize:(NSUInteger)chunkSize
+                              error:(NSError **)error
+                        bytesAction:(void(^)(const void *bytes, NSUInteger length, CGFloat percentDecompressed))action;
+
 /**
  *  YES if archive protected with a password, NO otherwise
  */
 - (BOOL)isPasswordProtected;
 
 /**
- *  Tests whether the provided password unlocks the archive
+ *  Tests whether the provided password unlocks the archive. The password is checked against the verifier
+ *  of the smallest encrypted file, without reading its data. PKWARE-encrypted files only have a one-byte
+ *  verifier, which 1 in 256 wrong passwords match, so if it matches, that file is decrypted to make sure
  *
  *  @return YES if correct password or archive is not password protected, NO if password is wrong
  */
@@ -459,7 +664,8 @@ extern NSString *UZKErrorDomain;
 
 /**
  Extract each file in the archive, checking whether the data matches the CRC checksum
- stored at the time it was written
+ stored at the time it was written. WinZip AES (AE-2) entries don't store a CRC, and
+ are checked against their authentication code instead
  
  @return YES if the data is all correct, false if any check failed
  */
@@ -467,7 +673,8 @@ extern NSString *UZKErrorDomain;
 
 /**
  Extract a particular file, to determine if its data matches the CRC
- checksum stored at the time it written
+ checksum stored at the time it written (or for AE-2 entries, their
+ authentication code)
  
  @param filePath The file in the archive to check
  
@@ -934,6 +1141,28 @@ compressionMethod:(UZKCompressionMethod)method
                   error:(NSError **)error
                   block:(BOOL(^)(BOOL(^writeData)(const void *bytes, unsigned int length), NSError **actionError))action;
 
+/**
+ *  Writes many files to the archive in one operation. Entries are loaded and compressed on up to
+ *  maxConcurrentCompressions threads at once, and written into the archive in the order given, so
+ *  set that property to take advantage of more than one core. An entry isn't started if its data, on
+ *  top of that of the entries waiting to be written, would take more than 64 MB of memory (entries
+ *  from a producer block count only once their data is produced), unless it's the next one to be
+ *  written. Compressed data larger than 16 MB is spilled to a temporary file until its turn to be
+ *  written. Uses the archive's password, if any.
+ *  Reports progress in number of entries written, and can be cancelled between entries
+ *
+ *  @param entries   The files to write, along with their sources
+ *  @param overwrite If YES, delete any existing files with the same paths before writing. If NO, append
+ *                   the data into the archive without removing them first
+ *  @param error     Contains an NSError object when there was an error writing to the archive, or
+ *                   loading an entry's data
+ *
+ *  @return YES if successful, NO on error. The entries written before an error remain in the archive
+ */
+- (BOOL)writeEntries:(NSArray<UZKWriteEntry*> *)entries
+           overwrite:(BOOL)overwrite
+               error:(NSError **)error;
+
 /**
  *  Removes the given file from the archive
  *
@@ -944,6 +1173,53 @@ compressionMethod:(UZKCompressionMethod)method
  */
 - (BOOL)deleteFile:(NSString *)filePath error:(NSError **)error;
 
+/**
+ *  Removes the given files from the archive, rewriting it only once. Any duplicate entries with
+ *  the given names are all removed
+ *
+ *  @param filePaths The files in the archive you wish to delete
+ *  @param error     Contains an NSError object when there was an error writing to the archive
+ *
+ *  @return YES if the files were successfully deleted, NO otherwise
+ */
+- (BOOL)deleteFiles:(NSArray<NSString*> *)filePaths error:(NSError **)error;
+
+/**
+ *  Removes every file the predicate matches from the archive, rewriting it only once
+ *
+ *  @param predicate Called with each file in the archive, in order. Return YES to delete the file
+ *
+ *       - *fileInfo* The metadata of the file
+ *
+ *  @param error     Contains an NSError object when there was an error writing to the archive
+ *
+ *  @return YES if the files were successfully deleted, NO otherwise
+ */
+- (BOOL)deleteFilesPassingTest:(BOOL(^)(UZKFileInfo *fileInfo))predicate error:(NSError **)error;
+
+/**
+ *  Rewrites the archive with only the files listed in its central directory, reclaiming the space
+ *  left behind by files that were overwritten while overwritesByAppending was YES. Like deleting a
+ *  file, this copies the whole archive, unless deletesInPlace is YES
+ *
+ *  @param error Contains an NSError object when there was an error writing to the archive
+ *
+ *  @return YES if the archive was successfully compacted, NO otherwise
+ */
+- (BOOL)compactArchive:(NSError **)error;
+
+/**
+ *  Deletes the journal left behind by an interrupted in-place deletion that can't be finished, because
+ *  the journal is damaged or doesn't belong to the archive (UZKErrorCodeDeletionJournalDamaged). The
+ *  archive is left the way the interruption left it, so files that were being moved may be corrupt. Use
+ *  -checkDataIntegrity to find out
+ *
+ *  @param error Contains an NSError object when the journal couldn't be deleted
+ *
+ *  @return YES if the journal was deleted, or there wasn't one, NO otherwise
+ */
+- (BOOL)discardDeletionJournal:(NSError **)error;
+
 
 @end
 NS_ASSUME_NONNULL_END
@@ -6,10 +6,21 @@
 
 #import "UZKArchive.h"
 
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+#import <CommonCrypto/CommonDigest.h>
+
 #import "zip.h"
+#import "wzaes.h"
+#import "crc32fast.h"
 
 #import "UZKFileInfo.h"
 #import "UZKFileInfo_Private.h"
+#import "UZKCentralDirectoryIndex.h"
+#import "UZKInPlaceCompactor.h"
+#import "UZKParallelDeflater.h"
+#import "UZKWriteEntry_Private.h"
 #import "UnzipKitMacros.h"
 #import "NSURL+UnzipKitExtensions.h"
 
@@ -28,6 +39,12 @@ typedef NS_ENUM(NSUInteger, UZKFileMode) {
 
 static NSBundle *_resources = nil;
 
+static const NSUInteger UZKParallelDeflateBlockSize = 128 * 1024;
+static const NSUInteger UZKWriteEntrySpillThreshold = 16 * 1024 * 1024;
+static const NSUInteger UZKWriteEntryMemoryBudget = 64 * 1024 * 1024;
+static const NSUInteger UZKRawCopyBufferSize = 1024 * 1024;
+static const NSUInteger UZKDerivedKeyCacheLimit = 256;
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wundef"
 #if UNIFIED_LOGGING_SUPPORTED
@@ -37,6 +54,47 @@ BOOL unzipkitIsAtLeast10_13SDK;
 #pragma clang diagnostic pop
 
 
+/**
+ *  A read handle, along with the central directory it was opened against. Used by threads reading
+ *  while concurrent reads are allowed, and kept in the idle pool between operations
+ */
+@interface UZKReadContext : NSObject
+
+@property (assign) unzFile handle;
+@property (strong) UZKCentralDirectoryIndex *centralDirectory;
+@property (assign) NSTimeInterval idleSince;
+
+@end
+
+@implementation UZKReadContext
+@end
+
+
+/**
+ *  An entry being written by -writeEntries:overwrite:error:, along with its compressed data once the
+ *  background work is done
+ */
+@interface UZKCompressedEntry : NSObject
+
+@property (strong) UZKWriteEntry *entry;
+@property (strong) dispatch_group_t group;
+
+@property (strong) NSData *data;
+@property (assign) uLong crc;
+@property (assign) unsigned long long uncompressedSize;
+@property (strong) NSError *loadError;
+@property (assign) int status;
+
+/// The bytes of this entry's data held in memory. Starts as its expected length when it's dispatched, and
+/// is updated from the background as it's loaded and compressed
+@property (assign) unsigned long long residentBytes;
+
+@end
+
+@implementation UZKCompressedEntry
+@end
+
+
 @interface UZKArchive ()
 
 - (instancetype)init NS_UNAVAILABLE;
@@ -54,19 +112,93 @@ NS_DESIGNATED_INITIALIZER
 
 @property (assign) UZKFileMode mode;
 @property (assign) zipFile zipFile;
-@property (assign) unzFile unzFile;
-@property (strong) NSDictionary *archiveContents;
+@property (nonatomic, assign) unzFile unzFile;
+@property (nonatomic, strong) UZKCentralDirectoryIndex *centralDirectory;
 
 @property (strong) NSObject *threadLock;
 
+@property (strong) NSString *readContextKey;
+@property (strong) NSCondition *readersCondition;
+@property (assign) NSUInteger activeReaders;
+@property (strong) NSMutableArray<UZKReadContext*> *idleReadContexts;
+
 @property (assign) BOOL commentRetrieved;
 
+@property (strong) NSCache<NSData*, NSData*> *derivedKeyCache;
+
++ (NSString *)figureOutCString:(const char *)filenameBytes;
+
 @end
 
 
+static int UZKAddCentralDirectoryEntryToIndex(const unz_central_dir_entry64 *entry, void *context)
+{
+    @autoreleasepool {
+        UZKCentralDirectoryIndex *index = (__bridge UZKCentralDirectoryIndex *)context;
+        
+        char filename_inzip[FILE_IN_ZIP_MAX_NAME_LENGTH];
+        size_t filenameLength = MIN((size_t)entry->file_info.size_filename, sizeof(filename_inzip) - 1);
+        memcpy(filename_inzip, entry->filename, filenameLength);
+        filename_inzip[filenameLength] = '\0';
+        
+        NSString *filename = [UZKArchive figureOutCString:filename_inzip];
+        if (filename) {
+            [index addEntry:&entry->file_info
+                   filename:filename
+                   position:entry->file_pos
+          localHeaderOffset:entry->offset_curfile];
+        }
+    }
+    
+    return 0;
+}
+
+#ifdef HAVE_AES
+/**
+ *  Derives the keys for an AES-encrypted file, reusing them if the same password and salt were seen before.
+ *  Each file has its own salt, but reopening a file (to validate the password, then extract it, or to
+ *  extract it again) no longer repeats the slow derivation. The cache is keyed on a hash of the salt and
+ *  password, so the password itself isn't kept in it
+ */
+static int UZKDeriveAESKeys(int strength, const char *password, const unsigned char *salt,
+                            unsigned char *derived, void *opaque)
+{
+    @autoreleasepool {
+        NSCache<NSData*, NSData*> *cache = (__bridge NSCache *)opaque;
+        
+        uint8_t strengthByte = (uint8_t)strength;
+        NSMutableData *cacheKey = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+        
+        CC_SHA256_CTX hash;
+        CC_SHA256_Init(&hash);
+        CC_SHA256_Update(&hash, &strengthByte, sizeof(strengthByte));
+        CC_SHA256_Update(&hash, salt, AES_SALTLENGTH(strength));
+        CC_SHA256_Update(&hash, password, (CC_LONG)strlen(password));
+        CC_SHA256_Final(cacheKey.mutableBytes, &hash);
+        
+        NSData *keys = [cache objectForKey:cacheKey];
+        if (!keys) {
+            NSMutableData *newKeys = [NSMutableData dataWithLength:AES_DERIVEDKEYSIZE(strength)];
+            if (wzaes_derive_keys(strength, password, salt, newKeys.mutableBytes) != 0) {
+                return -1;
+            }
+            
+            [cache setObject:newKeys forKey:cacheKey];
+            keys = newKeys;
+        }
+        
+        memcpy(derived, keys.bytes, AES_DERIVEDKEYSIZE(strength));
+    }
+    
+    return 0;
+}
+#endif
+
+
 @implementation UZKArchive
 
 @synthesize comment = _comment;
+@synthesize password = _password;
 
 
 #pragma mark - Deprecated Convenience Methods
@@ -178,12 +310,28 @@ NS_DESIGNATED_INITIALIZER
         _password = password;
         _threadLock = [[NSObject alloc] init];
         
+        _readContextKey = [NSString stringWithFormat:@"UZKArchiveReadContext-%p", (void *)self];
+        _readersCondition = [[NSCondition alloc] init];
+        _activeReaders = 0;
+        _idleReadContexts = [NSMutableArray array];
+        
         _commentRetrieved = NO;
+        _derivedKeyCache = [[NSCache alloc] init];
+        _derivedKeyCache.countLimit = UZKDerivedKeyCacheLimit;
+        _maxConcurrentExtractions = 1;
+        _maxConcurrentCompressions = 1;
     }
     
     return self;
 }
 
+- (void)dealloc
+{
+    for (UZKReadContext *context in self.idleReadContexts) {
+        unzClose(context.handle);
+    }
+}
+
 
 
 #pragma mark - Properties
@@ -248,6 +396,26 @@ NS_DESIGNATED_INITIALIZER
     return url.path;
 }
 
+- (NSString *)password
+{
+    @synchronized(self) {
+        return _password;
+    }
+}
+
+- (void)setPassword:(NSString *)password
+{
+    @synchronized(self) {
+        // Keys derived from the old password are no use anymore
+        if (_password && ![_password isEqualToString:password]) {
+            UZKLogDebug("Password changed. Clearing derived AES keys");
+            [self.derivedKeyCache removeAllObjects];
+        }
+        
+        _password = password;
+    }
+}
+
 - (NSString *)comment
 {
     UZKCreateActivity("Read Archive Comment");
@@ -280,6 +448,32 @@ NS_DESIGNATED_INITIALIZER
     }
 }
 
+- (unzFile)unzFile
+{
+    UZKReadContext *context = self.currentReadContext;
+    if (context) {
+        return context.handle;
+    }
+    
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+    return _unzFile;
+#pragma clang diagnostic pop
+}
+
+- (UZKCentralDirectoryIndex *)centralDirectory
+{
+    UZKReadContext *context = self.currentReadContext;
+    if (context) {
+        return context.centralDirectory;
+    }
+    
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+    return _centralDirectory;
+#pragma clang diagnostic pop
+}
+
 
 
 #pragma mark - Zip file detection
@@ -395,63 +589,8 @@ NS_DESIGNATED_INITIALIZER
     BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
         UZKCreateActivity("Finding File Info Items");
         
-        UZKLogInfo("Getting global info...");
-        unzGoToNextFile(welf.unzFile);
-        
-        unz_global_info gi;
-        int err = unzGetGlobalInfo(welf.unzFile, &gi);
-        if (err != UNZ_OK) {
-            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting global info (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                err];
-            UZKLogError("UZKErrorCodeArchiveNotFound: %{public}@", detail);
-            [welf assignError:innerError code:UZKErrorCodeArchiveNotFound
-                       detail:detail];
-            return;
-        }
-        
-        NSUInteger fileCount = gi.number_entry;
-        UZKLogDebug("fileCount: %lu", (unsigned long)fileCount);
-
-        UZKLogInfo("Going to first file...");
-        err = unzGoToFirstFile(welf.unzFile);
-        
-        if (err != UNZ_OK) {
-            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error going to first file in archive (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                err];
-            UZKLogError("UZKErrorCodeFileNavigationError: %{public}@", detail);
-            [welf assignError:innerError code:UZKErrorCodeFileNavigationError
-                       detail:detail];
-            return;
-        }
-        
-        for (NSUInteger i = 0; i < fileCount; i++) {
-            UZKLogDebug("Iterating through file info (iteration #%lu)", (unsigned long)i+1);
-            UZKFileInfo *info = [welf currentFileInZipInfo:innerError];
-            
-            if (info) {
-                UZKLogDebug("Info found: %{public}@", info.filename);
-                [zipInfos addObject:info];
-            } else {
-                UZKLogDebug("Info not found");
-                return;
-            }
-            
-            UZKLogDebug("Going to next file...");
-            err = unzGoToNextFile(welf.unzFile);
-            if (err == UNZ_END_OF_LIST_OF_FILE) {
-                UZKLogInfo("End of file found");
-                return;
-            }
-            
-            if (err != UNZ_OK) {
-                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error navigating to next file (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                    err];
-                UZKLogError("UZKErrorCodeFileNavigationError: %{public}@", detail);
-                [welf assignError:innerError code:UZKErrorCodeFileNavigationError
-                           detail:detail];
-                return;
-            }
-        }
+        UZKLogDebug("Reading file info from central directory index");
+        [zipInfos addObjectsFromArray:welf.centralDirectory.allFileInfo];
     } inMode:UZKFileModeUnzip error:&unzipError];
     
     if (!success) {
@@ -508,6 +647,18 @@ NS_DESIGNATED_INITIALIZER
     NSProgress *progress = [self beginProgressOperation:totalSize.longLongValue];
     progress.kind = NSProgressKindFile;
 
+    NSUInteger concurrency = self.maxConcurrentExtractions ?: [NSProcessInfo processInfo].activeProcessorCount;
+    if (concurrency > 1 && fileInfo.count > 1) {
+        UZKLogInfo("Extracting up to %lu files at a time", (unsigned long)concurrency);
+        return [self extractFilesInParallelTo:destinationDirectory
+                                    overwrite:overwrite
+                                  concurrency:concurrency
+                                    totalSize:totalSize.doubleValue
+                                     progress:progress
+                                progressBlock:progressBlock
+                                        error:error];
+    }
+    
     __weak UZKArchive *welf = self;
     NSError *extractError = nil;
     
@@ -612,12 +763,15 @@ NS_DESIGNATED_INITIALIZER
                     
                     UZKLogDebug("Extracting buffered data");
                     BOOL extractSuccess = [welf extractBufferedDataFromFile:info.filename
+                                                              chunkSize:0
                                                                   error:&strongError
-                                                                 action:
-                                    ^(NSData *dataChunk, CGFloat percentDecompressed) {
-                                        UZKLogDebug("Writing data chunk of size %lu (%lld total so far)", (unsigned long)dataChunk.length, bytesDecompressed);
-                                        bytesDecompressed += dataChunk.length;
-                                        [deflatedFileHandle writeData:dataChunk];
+                                                            bytesAction:
+                                    ^(const void *bytes, NSUInteger length, CGFloat percentDecompressed) {
+                                        UZKLogDebug("Writing data chunk of size %lu (%lld total so far)", (unsigned long)length, bytesDecompressed);
+                                        bytesDecompressed += length;
+                                        [deflatedFileHandle writeData:[NSData dataWithBytesNoCopy:(void *)(uintptr_t)bytes
+                                                                                           length:length
+                                                                                     freeWhenDone:NO]];
                                         if (progressBlock) {
                                             progressBlock(info, (double)bytesDecompressed / totalSize.doubleValue);
                                         }
@@ -696,30 +850,60 @@ NS_DESIGNATED_INITIALIZER
 {
     UZKCreateActivity("Extracting Data from File");
     
-    NSMutableData *result = [NSMutableData data];
+    NSProgress *progress = [self beginProgressOperation:0];
+    
+    __weak UZKArchive *welf = self;
+    __block NSMutableData *result = nil;
     
-    UZKLogInfo("Extracting buffered data from file %{public}@", filePath);
+    UZKLogInfo("Extracting data from file %{public}@", filePath);
     
     NSError *extractError = nil;
-    BOOL success = [self extractBufferedDataFromFile:filePath
-                                               error:&extractError
-                                              action:^(NSData *dataChunk, CGFloat percentDecompressed) {
-                                                  UZKLogDebug("Appending data chunk of size %lu (%.3f%% complete)", (unsigned long)dataChunk.length, (double)percentDecompressed * 100);
-
-                                                  if (progressBlock) {
-                                                      progressBlock(percentDecompressed);
-                                                  }
-                                                  
-                                                  [result appendData:dataChunk];
-                                              }];
+    BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
+        if (![welf locateFileInZip:filePath error:innerError]) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to locate '%@' in archive during data extraction", @"UnzipKit", _resources, @"Detailed error string"),
+                                filePath];
+            UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
+            [welf assignError:innerError code:UZKErrorCodeFileNotFoundInArchive
+                       detail:detail];
+            return;
+        }
+        
+        UZKLogInfo("Getting file info");
+        unz_file_info64 file_info;
+        int err = unzGetCurrentFileInfo64(welf.unzFile, &file_info, NULL, 0, NULL, 0, NULL, 0);
+        if (err != UNZ_OK) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting current file info (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                err];
+            UZKLogError("UZKErrorCodeFileRead: %{public}@", detail);
+            [welf assignError:innerError code:UZKErrorCodeFileRead
+                       detail:detail];
+            return;
+        }
+        
+        progress.totalUnitCount = (int64_t)file_info.uncompressed_size;
+        
+        result = [welf readCurrentFile:filePath
+                              fileInfo:&file_info
+                              progress:progress
+                         progressBlock:progressBlock
+                                 error:innerError];
+    } inMode:UZKFileModeUnzip error:&extractError];
     
     if (progressBlock) {
         UZKLogDebug("Declaring extraction progress as completed");
         progressBlock(1.0);
     }
     
+    if (progress.isCancelled) {
+        UZKLogError("User cancelled data extraction");
+        NSString *detail = NSLocalizedStringFromTableInBundle(@"User cancelled data read", @"UnzipKit", _resources, @"Detailed error string");
+        [self assignError:error code:UZKErrorCodeUserCancelled
+                   detail:detail];
+        return nil;
+    }
+    
     if (success) {
-        return [NSData dataWithData:result];
+        return result;
     }
 
     UZKLogError("Error extracting file (%ld): %{public}@", (long)extractError.code, extractError.localizedDescription);
@@ -731,123 +915,389 @@ NS_DESIGNATED_INITIALIZER
     return nil;
 }
 
-- (BOOL)performOnFilesInArchive:(void (^)(UZKFileInfo *, BOOL *))action
-                          error:(NSError * __autoreleasing*)error
+- (nullable NSData *)extractMappedDataFromFile:(NSString *)filePath
+                                     verifyCRC:(BOOL)verifyCRC
+                                         error:(NSError * __autoreleasing*)error
 {
-    UZKCreateActivity("Performing Action on Each File");
-    
-    UZKLogInfo("Listing file info");
-    
-    NSError *listError = nil;
-    NSArray *fileInfo = [self listFileInfo:&listError];
-    
-    if (listError || !fileInfo) {
-        UZKLogError("Failed to list the files in the archive: %{public}@", listError);
-        
-        if (error) {
-            *error = listError;
-        }
-        
-        return NO;
-    }
+    UZKCreateActivity("Extracting Mapped Data from File");
     
-    NSProgress *progress = [self beginProgressOperation:fileInfo.count];
+    UZKLogInfo("Extracting mapped data from file %{public}@", filePath);
     
-    UZKLogInfo("Sorting file info by name/path");
-
-    NSArray *sortedFileInfo = [fileInfo sortedArrayUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"filename" ascending:YES]]];
+    __weak UZKArchive *welf = self;
+    __block NSData *result = nil;
+    __block BOOL isMappable = NO;
     
     BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
-        UZKCreateActivity("Iterating Each File Info");
-        
-        BOOL stop = NO;
-
-        for (UZKFileInfo *info in sortedFileInfo) {
-            if (progress.isCancelled) {
-                UZKLogInfo("File info iteration was cancelled");
-                break;
-            }
-            UZKLogDebug("Performing action on %{public}@", info.filename);
-            action(info, &stop);
-            progress.completedUnitCount += 1;
-
-            if (stop) {
-                UZKLogInfo("Action dictated an early stop");
-                progress.completedUnitCount = progress.totalUnitCount;
-                break;
-            }
+        if (![welf locateFileInZip:filePath error:innerError]) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to locate '%@' in archive during mapped read", @"UnzipKit", _resources, @"Detailed error string"),
+                                filePath];
+            UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
+            [welf assignError:innerError code:UZKErrorCodeFileNotFoundInArchive
+                       detail:detail];
+            return;
         }
-    } inMode:UZKFileModeUnzip error:error];
-    
-    if (progress.isCancelled) {
-        NSString *detail = NSLocalizedStringFromTableInBundle(@"User cancelled operation", @"UnzipKit", _resources, @"Detailed error string");
-        UZKLogError("UZKErrorCodeUserCancelled: %{public}@", detail);
-        [self assignError:error code:UZKErrorCodeUserCancelled
-                   detail:detail];
-        return NO;
-    }
-    
-    return success;
-}
-
-- (BOOL)performOnDataInArchive:(void (^)(UZKFileInfo *, NSData *, BOOL *))action
-                         error:(NSError * __autoreleasing*)error
-{
-    UZKCreateActivity("Performing Action on Each File's Data");
-    
-    __weak UZKArchive *welf = self;
-
-    return [self performOnFilesInArchive:^(UZKFileInfo *fileInfo, BOOL *stop) {
-        UZKLogInfo("Locating file %{public}@", fileInfo.filename);
         
-        if (![welf locateFileInZip:fileInfo.filename error:error]) {
-            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to locate '%@' in archive during-perform on-data operation", @"UnzipKit", _resources, @"Detailed error string"),
-                                fileInfo.filename];
-            UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
-            [welf assignError:error code:UZKErrorCodeFileNotFoundInArchive
+        UZKLogDebug("Getting file info");
+        unz_file_info64 file_info;
+        int err = unzGetCurrentFileInfo64(welf.unzFile, &file_info, NULL, 0, NULL, 0, NULL, 0);
+        if (err != UNZ_OK) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting current file info (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                err];
+            UZKLogError("UZKErrorCodeFileRead: %{public}@", detail);
+            [welf assignError:innerError code:UZKErrorCodeFileRead
                        detail:detail];
             return;
         }
         
-        UZKLogInfo("Reading file from archive");
+        BOOL isEncrypted = (file_info.flag & 1) != 0;
+        if (file_info.compression_method != 0
+            || isEncrypted
+            || file_info.compressed_size != file_info.uncompressed_size)
+        {
+            UZKLogInfo("File is compressed or encrypted, so its data can't be mapped");
+            return;
+        }
         
-        NSData *fileData = [welf readFile:fileInfo.filename
-                                   length:fileInfo.uncompressedSize
-                                    error:error];
+        isMappable = YES;
         
-        if (!fileData) {
-            UZKLogError("Error reading file %{public}@ in archive", fileInfo.filename);
+        NSData *mapping = [welf archiveMapping:innerError];
+        if (!mapping) {
             return;
         }
         
-        UZKLogInfo("Performing action on file data");
-        action(fileInfo, fileData, stop);
-    } error:error];
-}
-
-- (BOOL)extractBufferedDataFromFile:(NSString *)filePath
-                              error:(NSError * __autoreleasing*)error
-                             action:(void (^)(NSData *, CGFloat))action
-{
-    UZKCreateActivity("Extracting Data into Buffer");
-    
-    NSProgress *progress = [self beginProgressOperation:0];
-    
-    __weak UZKArchive *welf = self;
-    NSUInteger bufferSize = 1024 * 256; // 256 kb, arbitrary
-    
-    BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
-        if (![welf locateFileInZip:filePath error:innerError]) {
-            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to locate '%@' in archive during buffered read", @"UnzipKit", _resources, @"Detailed error string"),
-                                filePath];
-            UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
-            [welf assignError:innerError code:UZKErrorCodeFileNotFoundInArchive
+        UZKLogDebug("Opening file to find the offset of its data");
+        err = unzOpenCurrentFile(welf.unzFile);
+        if (err != UNZ_OK) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening archive (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                err];
+            UZKLogError("%{public}@", detail);
+            [welf assignError:innerError code:err
                        detail:detail];
             return;
         }
         
-        UZKLogInfo("Getting file info");
-        UZKFileInfo *info = [welf currentFileInZipInfo:innerError];
+        ZPOS64_T dataOffset = unzGetCurrentFileZStreamPos64(welf.unzFile);
+        unzCloseCurrentFile(welf.unzFile);
+        
+        if (dataOffset > mapping.length || file_info.uncompressed_size > mapping.length - dataOffset) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"The data of '%@' extends past the end of the archive", @"UnzipKit", _resources, @"Detailed error string"),
+                                filePath];
+            UZKLogError("UZKErrorCodeBadZipFile: %{public}@", detail);
+            [welf assignError:innerError code:UZKErrorCodeBadZipFile
+                       detail:detail];
+            return;
+        }
+        
+        const Bytef *bytes = (const Bytef *)mapping.bytes + dataOffset;
+        NSUInteger length = (NSUInteger)file_info.uncompressed_size;
+        
+        if (verifyCRC) {
+            UZKLogDebug("Verifying CRC of mapped data");
+            uLong crc = crc32_fast(0, bytes, length);
+            
+            if (crc != file_info.crc) {
+                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"The CRC of '%@' doesn't match the one recorded in the archive", @"UnzipKit", _resources, @"Detailed error string"),
+                                    filePath];
+                UZKLogError("UZKErrorCodeCRCError: %{public}@", detail);
+                [welf assignError:innerError code:UZKErrorCodeCRCError
+                           detail:detail];
+                return;
+            }
+        }
+        
+        UZKLogDebug("Returning %{iec-bytes}lu (%lu bytes) of mapped data", (unsigned long)length, (unsigned long)length);
+        
+        // The deallocator holds onto the mapping, so it outlives the archive for as long as the slice does
+        result = [[NSData alloc] initWithBytesNoCopy:(void *)(uintptr_t)bytes
+                                              length:length
+                                         deallocator:^(void *sliceBytes, NSUInteger sliceLength) {
+                                             (void)sliceBytes;
+                                             (void)sliceLength;
+                                             (void)mapping;
+                                         }];
+    } inMode:UZKFileModeUnzip error:error];
+    
+    if (!success) {
+        return nil;
+    }
+    
+    if (!isMappable) {
+        UZKLogInfo("Extracting %{public}@ without mapping it", filePath);
+        return [self extractDataFromFile:filePath
+                                   error:error];
+    }
+    
+    return result;
+}
+
+- (nullable NSDictionary<NSString*, NSData*> *)extractDataFromFiles:(NSArray<NSString*> *)filePaths
+                                                              error:(NSError * __autoreleasing*)error
+{
+    NSMutableDictionary<NSString*, NSData*> *result = [NSMutableDictionary dictionaryWithCapacity:filePaths.count];
+    
+    BOOL success = [self extractDataFromFiles:filePaths
+                                        error:error
+                                       action:^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+                                           result[fileInfo.filename] = fileData;
+                                       }];
+    
+    return success ? [result copy] : nil;
+}
+
+- (BOOL)extractDataFromFiles:(NSArray<NSString*> *)filePaths
+                       error:(NSError * __autoreleasing*)error
+                      action:(void (^)(UZKFileInfo *, NSData *, BOOL *))action
+{
+    UZKCreateActivity("Extracting Data from Files");
+    
+    NSProgress *progress = [self beginProgressOperation:0];
+    
+    __weak UZKArchive *welf = self;
+    
+    UZKLogInfo("Extracting data from %lu files", (unsigned long)filePaths.count);
+    
+    NSError *extractError = nil;
+    BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
+        UZKCentralDirectoryIndex *index = welf.centralDirectory;
+        NSMutableIndexSet *entries = [NSMutableIndexSet indexSet];
+        
+        UZKLogDebug("Looking up file positions");
+        for (NSString *filePath in filePaths) {
+            NSUInteger entry = [index indexOfFilename:filePath];
+            
+            if (entry == NSNotFound) {
+                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to locate '%@' in archive during data extraction", @"UnzipKit", _resources, @"Detailed error string"),
+                                    filePath];
+                UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
+                [welf assignError:innerError code:UZKErrorCodeFileNotFoundInArchive
+                           detail:detail];
+                return;
+            }
+            
+            [entries addIndex:entry];
+        }
+        
+        NSMutableArray<NSNumber*> *readOrder = [NSMutableArray arrayWithCapacity:entries.count];
+        __block unsigned long long totalSize = 0;
+        
+        [entries enumerateIndexesUsingBlock:^(NSUInteger entry, BOOL *stop) {
+            [readOrder addObject:@(entry)];
+            totalSize += [index headerAtIndex:entry]->uncompressed_size;
+        }];
+        
+        // Reading the files in the order they're stored turns seeks back and forth into one forward pass
+        UZKLogDebug("Sorting %lu files by their position in the archive", (unsigned long)readOrder.count);
+        [readOrder sortUsingComparator:^NSComparisonResult(NSNumber *entryA, NSNumber *entryB) {
+            ZPOS64_T offsetA = [index localHeaderOffsetAtIndex:entryA.unsignedIntegerValue];
+            ZPOS64_T offsetB = [index localHeaderOffsetAtIndex:entryB.unsignedIntegerValue];
+            
+            if (offsetA == offsetB) {
+                return NSOrderedSame;
+            }
+            
+            return offsetA < offsetB ? NSOrderedAscending : NSOrderedDescending;
+        }];
+        
+        progress.totalUnitCount = (int64_t)totalSize;
+        
+        for (NSNumber *entryNumber in readOrder) {
+            if (progress.isCancelled) {
+                UZKLogInfo("Data extraction cancelled");
+                return;
+            }
+            
+            NSUInteger entry = entryNumber.unsignedIntegerValue;
+            NSString *filename = [index filenameAtIndex:entry];
+            const unz_file_info64 *header = [index headerAtIndex:entry];
+            unz64_file_pos position = [index positionAtIndex:entry];
+            
+            UZKLogDebug("Going to file %{public}@", filename);
+            int err = unzGoToCentralDirEntry64(welf.unzFile, header, &position, [index localHeaderOffsetAtIndex:entry]);
+            if (err != UNZ_OK) {
+                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error seeking to file position (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                    err];
+                UZKLogError("%{public}@", detail);
+                [welf assignError:innerError code:err
+                           detail:detail];
+                return;
+            }
+            
+            NSData *fileData = [welf readCurrentFile:filename
+                                            fileInfo:header
+                                            progress:progress
+                                       progressBlock:nil
+                                               error:innerError];
+            if (!fileData) {
+                UZKLogError("Error reading file %{public}@ in archive", filename);
+                return;
+            }
+            
+            BOOL stop = NO;
+            
+            UZKLogDebug("Performing action on file data");
+            action([index fileInfoAtIndex:entry], fileData, &stop);
+            
+            if (stop) {
+                UZKLogInfo("Action dictated an early stop");
+                progress.completedUnitCount = progress.totalUnitCount;
+                return;
+            }
+        }
+    } inMode:UZKFileModeUnzip error:&extractError];
+    
+    if (progress.isCancelled) {
+        UZKLogError("User cancelled data extraction");
+        NSString *detail = NSLocalizedStringFromTableInBundle(@"User cancelled data read", @"UnzipKit", _resources, @"Detailed error string");
+        return [self assignError:error code:UZKErrorCodeUserCancelled
+                          detail:detail];
+    }
+    
+    if (!success) {
+        UZKLogError("Error extracting files (%ld): %{public}@", (long)extractError.code, extractError.localizedDescription);
+        
+        if (error) {
+            *error = extractError;
+        }
+    }
+    
+    return success;
+}
+
+- (BOOL)performOnFilesInArchive:(void (^)(UZKFileInfo *, BOOL *))action
+                          error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Performing Action on Each File");
+    
+    UZKLogInfo("Listing file info");
+    
+    NSError *listError = nil;
+    NSArray *fileInfo = [self listFileInfo:&listError];
+    
+    if (listError || !fileInfo) {
+        UZKLogError("Failed to list the files in the archive: %{public}@", listError);
+        
+        if (error) {
+            *error = listError;
+        }
+        
+        return NO;
+    }
+    
+    NSProgress *progress = [self beginProgressOperation:fileInfo.count];
+    
+    UZKLogInfo("Sorting file info by name/path");
+
+    NSArray *sortedFileInfo = [fileInfo sortedArrayUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"filename" ascending:YES]]];
+    
+    BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
+        UZKCreateActivity("Iterating Each File Info");
+        
+        BOOL stop = NO;
+
+        for (UZKFileInfo *info in sortedFileInfo) {
+            if (progress.isCancelled) {
+                UZKLogInfo("File info iteration was cancelled");
+                break;
+            }
+            UZKLogDebug("Performing action on %{public}@", info.filename);
+            action(info, &stop);
+            progress.completedUnitCount += 1;
+
+            if (stop) {
+                UZKLogInfo("Action dictated an early stop");
+                progress.completedUnitCount = progress.totalUnitCount;
+                break;
+            }
+        }
+    } inMode:UZKFileModeUnzip error:error];
+    
+    if (progress.isCancelled) {
+        NSString *detail = NSLocalizedStringFromTableInBundle(@"User cancelled operation", @"UnzipKit", _resources, @"Detailed error string");
+        UZKLogError("UZKErrorCodeUserCancelled: %{public}@", detail);
+        [self assignError:error code:UZKErrorCodeUserCancelled
+                   detail:detail];
+        return NO;
+    }
+    
+    return success;
+}
+
+- (BOOL)performOnDataInArchive:(void (^)(UZKFileInfo *, NSData *, BOOL *))action
+                         error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Performing Action on Each File's Data");
+    
+    __weak UZKArchive *welf = self;
+
+    return [self performOnFilesInArchive:^(UZKFileInfo *fileInfo, BOOL *stop) {
+        UZKLogInfo("Locating file %{public}@", fileInfo.filename);
+        
+        if (![welf locateFileInZip:fileInfo.filename error:error]) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to locate '%@' in archive during-perform on-data operation", @"UnzipKit", _resources, @"Detailed error string"),
+                                fileInfo.filename];
+            UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
+            [welf assignError:error code:UZKErrorCodeFileNotFoundInArchive
+                       detail:detail];
+            return;
+        }
+        
+        UZKLogInfo("Reading file from archive");
+        
+        NSData *fileData = [welf readFile:fileInfo.filename
+                                   length:fileInfo.uncompressedSize
+                                    error:error];
+        
+        if (!fileData) {
+            UZKLogError("Error reading file %{public}@ in archive", fileInfo.filename);
+            return;
+        }
+        
+        UZKLogInfo("Performing action on file data");
+        action(fileInfo, fileData, stop);
+    } error:error];
+}
+
+- (BOOL)extractBufferedDataFromFile:(NSString *)filePath
+                              error:(NSError * __autoreleasing*)error
+                             action:(void (^)(NSData *, CGFloat))action
+{
+    return [self extractBufferedDataFromFile:filePath
+                                   chunkSize:0
+                                       error:error
+                                 bytesAction:^(const void *bytes, NSUInteger length, CGFloat percentDecompressed) {
+                                     if (action) {
+                                         action([NSData dataWithBytes:bytes length:length], percentDecompressed);
+                                     }
+                                 }];
+}
+
+- (BOOL)extractBufferedDataFromFile:(NSString *)filePath
+                          chunkSize:(NSUInteger)chunkSize
+                              error:(NSError * __autoreleasing*)error
+                        bytesAction:(void (^)(const void *, NSUInteger, CGFloat))action
+{
+    UZKCreateActivity("Extracting Data into Buffer");
+    
+    NSProgress *progress = [self beginProgressOperation:0];
+    
+    __weak UZKArchive *welf = self;
+    
+    // The default, when the caller doesn't choose a size, is arbitrary. Since unzReadCurrentFile returns
+    // the number of bytes it read as an int, no chunk can be larger than INT_MAX
+    NSUInteger bufferSize = MIN(chunkSize ?: 1024 * 256, (NSUInteger)INT_MAX);
+    
+    BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
+        if (![welf locateFileInZip:filePath error:innerError]) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to locate '%@' in archive during buffered read", @"UnzipKit", _resources, @"Detailed error string"),
+                                filePath];
+            UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
+            [welf assignError:innerError code:UZKErrorCodeFileNotFoundInArchive
+                       detail:detail];
+            return;
+        }
+        
+        UZKLogInfo("Getting file info");
+        UZKFileInfo *info = [welf currentFileInZipInfo:innerError];
         
         if (!info) {
             UZKLogError("Failed to get info of file %{public}@ in archive", filePath);
@@ -866,6 +1316,9 @@ NS_DESIGNATED_INITIALIZER
         
         NSError *strongInnerError = nil;
         
+        UZKLogDebug("Allocating %{iec-bytes}lu (%lu bytes) read buffer", (unsigned long)bufferSize, (unsigned long)bufferSize);
+        NSMutableData *buffer = [NSMutableData dataWithLength:bufferSize];
+        
         for (;;)
         {
             if (progress.isCancelled) {
@@ -875,8 +1328,7 @@ NS_DESIGNATED_INITIALIZER
             
             @autoreleasepool {
                 UZKLogDebug("Reading file data");
-                NSMutableData *data = [NSMutableData dataWithLength:bufferSize];
-                int bytesRead = unzReadCurrentFile(welf.unzFile, data.mutableBytes, (unsigned)bufferSize);
+                int bytesRead = unzReadCurrentFile(welf.unzFile, buffer.mutableBytes, (unsigned)bufferSize);
                 
                 if (bytesRead < 0) {
                     NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to read file %@ in zip", @"UnzipKit", _resources, @"Detailed error string"),
@@ -893,12 +1345,11 @@ NS_DESIGNATED_INITIALIZER
                 
                 UZKLogDebug("bytesRead: %{iec-bytes}d (%d bytes)", bytesRead, bytesRead);
 
-                data.length = bytesRead;
                 bytesDecompressed += bytesRead;
                 
                 if (action) {
                     UZKLogDebug("Performing action on chunk of data");
-                    action([data copy], bytesDecompressed / (CGFloat)info.uncompressedSize);
+                    action(buffer.bytes, (NSUInteger)bytesRead, bytesDecompressed / (CGFloat)info.uncompressedSize);
                 }
                 
                 progress.completedUnitCount = bytesDecompressed;
@@ -965,33 +1416,66 @@ NS_DESIGNATED_INITIALIZER
 {
     UZKCreateActivity("Validating Password");
     
-    if (!self.isPasswordProtected) {
-        UZKLogInfo("Archive is not password protected. There is no password to validate");
-        return YES;
-    }
-    
     NSError *error = nil;
-    NSArray *fileInfos = [self listFileInfo:&error];
+    NSArray<UZKFileInfo*> *fileInfos = [self listFileInfo:&error];
     
     if (error) {
         UZKLogError("Error checking whether file is password protected: %{public}@", error);
         return NO;
     }
     
-    if (!fileInfos || fileInfos.count == 0) {
-        UZKLogInfo("There are no files in the archive");
+    UZKFileInfo *smallest = nil;
+    for (UZKFileInfo *fileInfo in fileInfos) {
+        if (fileInfo.isEncryptedWithPassword
+            && (!smallest || fileInfo.uncompressedSize < smallest.uncompressedSize))
+        {
+            smallest = fileInfo;
+        }
+    }
+    
+    if (!smallest) {
+        UZKLogInfo("Archive is not password protected. There is no password to validate");
+        return YES;
+    }
+    
+    const char *passwordStr = [self.password cStringUsingEncoding:NSISOLatin1StringEncoding];
+    if (!passwordStr) {
+        UZKLogInfo("No password to validate");
+        return NO;
+    }
+    
+    UZKLogDebug("Checking password verifier of smallest encrypted file in archive: %{public}@", smallest.filename);
+    
+    __weak UZKArchive *welf = self;
+    __block int checkResult = UNZ_OK;
+    __block BOOL isAES = NO;
+    
+    BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
+        if (![welf locateFileInZip:smallest.filename error:innerError]) {
+            return;
+        }
+        
+        unz_file_info64 file_info;
+        checkResult = unzGetCurrentFileInfo64(welf.unzFile, &file_info, NULL, 0, NULL, 0, NULL, 0);
+        if (checkResult == UNZ_OK) {
+#ifdef HAVE_AES
+            isAES = file_info.compression_method == AES_METHOD;
+#endif
+            checkResult = unzCheckCurrentFilePassword(welf.unzFile, passwordStr);
+        }
+    } inMode:UZKFileModeUnzip error:&error];
+    
+    if (!success || checkResult != UNZ_OK) {
+        UZKLogInfo("Password check failed (%d): %{public}@", checkResult, error);
         return NO;
     }
     
-    UZKFileInfo *smallest = [fileInfos sortedArrayUsingComparator:^NSComparisonResult(UZKFileInfo *file1, UZKFileInfo *file2) {
-        if (file1.uncompressedSize < file2.uncompressedSize)
-            return NSOrderedAscending;
-        if (file1.uncompressedSize > file2.uncompressedSize)
-            return NSOrderedDescending;
-        return NSOrderedSame;
-    }].firstObject;
-
-    UZKLogDebug("Decrypting smallest file in archive: %{public}@", smallest.filename);
+    if (isAES) {
+        return YES;
+    }
+    
+    // The PKWARE verifier is a single byte, which 1 in 256 wrong passwords match, so confirm by decrypting
+    UZKLogDebug("Decrypting %{public}@ to confirm password", smallest.filename);
     
     NSData *smallestData = [self extractData:(UZKFileInfo* _Nonnull)smallest
                                        error:&error];
@@ -1018,6 +1502,8 @@ NS_DESIGNATED_INITIALIZER
     NSError *performOnDataError = nil;
     __block BOOL dataIsValid = NO;
     
+    __weak UZKArchive *welf = self;
+    
     BOOL success = [self performOnDataInArchive:
      ^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
          // Only set this once we've reached this point, validating the archive's structures
@@ -1028,12 +1514,28 @@ NS_DESIGNATED_INITIALIZER
              return;
          }
          
-         uLong extractedCRC = crc32(0, fileData.bytes, (uInt)fileData.length);
-
-         if (extractedCRC != fileInfo.CRC) {
-             UZKLogError("CRC mismatch in '%{public}@': expected %010lu, found %010lu",
-                         fileInfo.filename, (unsigned long)fileInfo.CRC, extractedCRC)
-             dataIsValid = NO;
+         // AE-2 entries record a CRC of 0, so they're checked against their authentication code
+         // instead, which happens when the file is closed after reading all of it
+         BOOL isAE2 = NO;
+#ifdef HAVE_AES
+         isAE2 = unzGetCurrentFileAESVersion(welf.unzFile) == AES_VERSION_AE2;
+#endif
+         
+         if (isAE2) {
+             int err = unzCloseCurrentFile(welf.unzFile);
+             
+             if (err != UNZ_OK) {
+                 UZKLogError("Authentication code mismatch in '%{public}@' (code %d)", fileInfo.filename, err);
+                 dataIsValid = NO;
+             }
+         } else {
+             uLong extractedCRC = crc32_fast(0, fileData.bytes, fileData.length);
+             
+             if (extractedCRC != fileInfo.CRC) {
+                 UZKLogError("CRC mismatch in '%{public}@': expected %010lu, found %010lu",
+                             fileInfo.filename, (unsigned long)fileInfo.CRC, extractedCRC)
+                 dataIsValid = NO;
+             }
          }
          
          if (!dataIsValid || filePath) {
@@ -1238,16 +1740,48 @@ compressionMethod:(UZKCompressionMethod)method
     }
     
     __weak UZKArchive *welf = self;
-    uLong calculatedCRC = crc32(0, data.bytes, (uInt)data.length);
+    uLong calculatedCRC = crc32_fast(0, data.bytes, data.length);
     UZKLogDebug("Calculated CRC: %010lu", calculatedCRC);
     
+    UZKParallelDeflater *deflater = [self parallelDeflaterForCompressionMethod:method
+                                                                    dataLength:data.length];
+    
     BOOL success = [self performWriteAction:^int(uLong *crc, NSError * __autoreleasing*innerError) {
         UZKCreateActivity("Performing File Write");
         
         NSAssert(crc, @"No CRC reference passed", nil);
         *crc = calculatedCRC;
         
-        UZKLogInfo("Iterating through all data, in %lu chunks", (unsigned long)bufferSize);
+        if (deflater) {
+            UZKLogInfo("Compressing data in parallel, in %lu byte blocks", (unsigned long)UZKParallelDeflateBlockSize);
+            
+            for (NSUInteger i = 0; i < data.length; i += UZKParallelDeflateBlockSize) {
+                NSUInteger size = MIN(UZKParallelDeflateBlockSize, data.length - i);
+                int err = [deflater appendBytes:(const char *)bytes + i length:size];
+                
+                if (err != Z_OK) {
+                    UZKLogError("Error compressing data: %d", err);
+                    return err;
+                }
+                
+                progress.completedUnitCount += size;
+                
+                if (progressBlock) {
+                    double percentComplete = i / (double)data.length;
+                    UZKLogDebug("Calling progress block at %.3f%%", percentComplete * 100);
+                    progressBlock(percentComplete);
+                }
+            }
+            
+            int err = [deflater finish];
+            if (err != Z_OK) {
+                UZKLogError("Error finishing compressed data: %d", err);
+            }
+            
+            return err;
+        }
+        
+        UZKLogInfo("Iterating through all data, in %lu chunks", (unsigned long)bufferSize);
         
         for (NSUInteger i = 0; i <= data.length; i += bufferSize) {
             UZKLogDebug("Writing chunk starting at byte %lu", (unsigned long)i);
@@ -1279,6 +1813,7 @@ compressionMethod:(UZKCompressionMethod)method
                                    password:password
                                   overwrite:overwrite
                                         CRC:calculatedCRC
+                                   deflater:deflater
                                       error:error];
     
     return success;
@@ -1411,6 +1946,8 @@ compressionMethod:(UZKCompressionMethod)method
              "unless a CRC is provided up front for inclusion in the header", nil);
     
     __weak UZKArchive *welf = self;
+    
+    UZKParallelDeflater *deflater = action ? [self parallelDeflaterForCompressionMethod:method dataLength:ULLONG_MAX] : nil;
 
     BOOL success = [self performWriteAction:^int(uLong *crc, NSError * __autoreleasing*innerError) {
         UZKCreateActivity("Performing File Write");
@@ -1424,19 +1961,34 @@ compressionMethod:(UZKCompressionMethod)method
         
         BOOL result = action(^BOOL(const void *bytes, unsigned int length) {
             UZKLogInfo("Writing %{iec-bytes}u (%u bytes) into archive from buffer", length, length);
-            int writeErr = zipWriteInFileInZip(self.zipFile, bytes, length);
+            int writeErr = (deflater
+                            ? [deflater appendBytes:bytes length:length]
+                            : zipWriteInFileInZip(self.zipFile, bytes, length));
             if (writeErr != ZIP_OK) {
                 UZKLogError("Error writing data from buffer: %d", writeErr);
                 return NO;
             }
             
-            uLong oldCRC = *crc;
-            *crc = crc32(oldCRC, bytes, (uInt)length);
-            UZKLogDebug("Calculated new CRC: %010lu from old CRC: %010lu", *crc, oldCRC);
+            // The deflater computes the CRC of each block as it compresses it, in parallel
+            if (!deflater) {
+                uLong oldCRC = *crc;
+                *crc = crc32_fast(oldCRC, bytes, length);
+                UZKLogDebug("Calculated new CRC: %010lu from old CRC: %010lu", *crc, oldCRC);
+            }
             
             return YES;
         }, innerError);
         
+        if (deflater) {
+            int finishErr = [deflater finish];
+            if (finishErr != Z_OK) {
+                UZKLogError("Error finishing compressed data from buffer: %d", finishErr);
+                return finishErr;
+            }
+            
+            *crc = deflater.crc;
+        }
+        
         if (preCRC != 0 && *crc != preCRC) {
             uLong calculatedCRC = *crc;
             NSString *preCRCStr = [NSString stringWithFormat:@"%010lu", preCRC];
@@ -1458,23 +2010,209 @@ compressionMethod:(UZKCompressionMethod)method
                                    password:password
                                   overwrite:overwrite
                                         CRC:preCRC
+                                   deflater:deflater
                                       error:error];
     
     return success;
 }
 
+- (BOOL)writeEntries:(NSArray<UZKWriteEntry*> *)entries
+           overwrite:(BOOL)overwrite
+               error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Writing Entries");
+    
+    UZKLogInfo("Writing %lu entries to archive, overwrite: %{public}@", (unsigned long)entries.count, overwrite ? @"YES" : @"NO");
+    
+    NSProgress *progress = [self beginProgressOperation:entries.count];
+    
+    if (overwrite && ![self deleteExistingFilesForEntries:entries error:error]) {
+        UZKLogError("Failed to delete existing files before writing new entries");
+        return NO;
+    }
+    
+    NSUInteger concurrency = self.maxConcurrentCompressions ?: [NSProcessInfo processInfo].activeProcessorCount;
+    UZKLogDebug("Compressing up to %lu entries at once", (unsigned long)concurrency);
+    
+    const char *passwordStr = NULL;
+    if (self.password) {
+        UZKLogDebug("Converting password to NSISOLatin1StringEncoding");
+        passwordStr = [self.password cStringUsingEncoding:NSISOLatin1StringEncoding];
+    }
+    
+    NSMutableArray<UZKCompressedEntry*> *entriesInFlight = [NSMutableArray arrayWithCapacity:concurrency];
+    __block NSUInteger nextEntryIndex = 0;
+    
+    __weak UZKArchive *welf = self;
+    
+    BOOL success = [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
+        UZKCreateActivity("Performing Entry Writes");
+        
+        for (NSUInteger i = 0; i < entries.count; i++) {
+            if (progress.isCancelled) {
+                UZKLogInfo("Progress cancellation requested. Stopping after %lu entries", (unsigned long)i);
+                return;
+            }
+            
+            // Keep the pipeline full, so the next entries compress while this one is written, but don't
+            // start one whose data would take the entries ahead of the writer over the memory budget
+            while (nextEntryIndex < entries.count && entriesInFlight.count < concurrency) {
+                UZKWriteEntry *entry = entries[nextEntryIndex];
+                unsigned long long expectedLength = entry.expectedLength;
+                
+                if (entriesInFlight.count > 0
+                    && [UZKArchive residentBytesOfEntries:entriesInFlight] + expectedLength > UZKWriteEntryMemoryBudget)
+                {
+                    UZKLogDebug("Waiting for memory before compressing %{public}@ (%{iec-bytes}llu)", entry.filePath, expectedLength);
+                    break;
+                }
+                
+                UZKCompressedEntry *compressed = [[UZKCompressedEntry alloc] init];
+                compressed.entry = entry;
+                compressed.group = dispatch_group_create();
+                
+                // Reserve the entry's share of the budget now, since compressEntry: only learns its actual
+                // size once the data is loaded
+                compressed.residentBytes = expectedLength;
+                nextEntryIndex++;
+                
+                dispatch_group_async(compressed.group, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                    @autoreleasepool {
+                        [UZKArchive compressEntry:compressed];
+                    }
+                });
+                
+                [entriesInFlight addObject:compressed];
+            }
+            
+            UZKCompressedEntry *compressed = entriesInFlight.firstObject;
+            [entriesInFlight removeObjectAtIndex:0];
+            
+            dispatch_group_wait(compressed.group, DISPATCH_TIME_FOREVER);
+            
+            if (![welf writeCompressedEntry:compressed password:passwordStr error:innerError]) {
+                UZKLogError("Failed to write entry %{public}@", compressed.entry.filePath);
+                return;
+            }
+            
+            progress.completedUnitCount++;
+        }
+    } inMode:UZKFileModeAppend error:error];
+    
+    // Don't leave compressions running in the background after returning
+    for (UZKCompressedEntry *compressed in entriesInFlight) {
+        dispatch_group_wait(compressed.group, DISPATCH_TIME_FOREVER);
+    }
+    
+    if (success && progress.isCancelled) {
+        UZKLogError("User cancelled writing entries");
+        NSString *detail = NSLocalizedStringFromTableInBundle(@"User cancelled archive write", @"UnzipKit", _resources, @"Detailed error string");
+        return [self assignError:error code:UZKErrorCodeUserCancelled
+                          detail:detail];
+    }
+    
+    return success;
+}
+
 - (BOOL)deleteFile:(NSString *)filePath error:(NSError * __autoreleasing*)error
 {
     UZKCreateActivity("Deleting File");
     
-    // Thanks to Ivan A. Krestinin for much of the code below: http://www.winimage.com/zLibDll/del.cpp
-    
     UZKLogInfo("Deleting file %{public}@ from archive", filePath);
     
+    return [self deleteFiles:@[filePath] error:error];
+}
+
+- (BOOL)deleteFiles:(NSArray<NSString*> *)filePaths error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Deleting Files");
+    
+    UZKLogInfo("Deleting %lu files from archive", (unsigned long)filePaths.count);
+    
+    if (filePaths.count == 0) {
+        return YES;
+    }
+    
+    NSMutableSet<NSString*> *filenamesToDelete = [NSMutableSet setWithCapacity:filePaths.count];
+    for (NSString *filePath in filePaths) {
+        [filenamesToDelete addObject:[UZKArchive figureOutCString:filePath.UTF8String]];
+    }
+    
+    NSString *deletionDescription = (filePaths.count == 1
+                                     ? filePaths.firstObject
+                                     : [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"%lu files", @"UnzipKit", _resources, @"Description of several files being deleted, in error messages"),
+                                        (unsigned long)filePaths.count]);
+    
+    return [self rewriteArchiveRemovingFilesPassingTest:^BOOL(NSString *filename, unz_file_info64 *fileInfo) {
+        return [filenamesToDelete containsObject:filename.decomposedStringWithCanonicalMapping];
+    }
+                                    deletionDescription:deletionDescription
+                                                  error:error];
+}
+
+- (BOOL)deleteFilesPassingTest:(BOOL(^)(UZKFileInfo *fileInfo))predicate error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Deleting Files Passing Test");
+    
+    UZKLogInfo("Deleting files passing test from archive");
+    
+    NSString *deletionDescription = NSLocalizedStringFromTableInBundle(@"the files passing the test", @"UnzipKit", _resources, @"Description of files being deleted by a predicate, in error messages");
+    
+    return [self rewriteArchiveRemovingFilesPassingTest:^BOOL(NSString *filename, unz_file_info64 *fileInfo) {
+        return predicate([UZKFileInfo fileInfo:fileInfo filename:filename]);
+    }
+                                    deletionDescription:deletionDescription
+                                                  error:error];
+}
+
+- (BOOL)compactArchive:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Compacting Archive");
+    
+    UZKLogInfo("Compacting archive, to reclaim space from files that were overwritten by appending");
+    
+    NSError *rewriteError = nil;
+    if (![self rewriteArchiveRemovingFilesPassingTest:nil deletionDescription:@"" error:&rewriteError]) {
+        NSString *detail = NSLocalizedStringFromTableInBundle(@"Error compacting the archive", @"UnzipKit", _resources, @"Detailed error string");
+        UZKLogError("UZKErrorCodeFileWrite: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeFileWrite
+                          detail:detail
+                       underlyer:rewriteError];
+    }
+    
+    return YES;
+}
+
+/**
+ *  Copies every file the archive's central directory lists into a new archive, except for the ones
+ *  the test matches, and replaces the original with it
+ *
+ *  @param shouldRemove        Returns YES for files to leave out. If nil, nothing is left out, and the
+ *                             archive is rewritten without any unreferenced data
+ *  @param deletionDescription Describes the files being deleted, for error messages
+ */
+- (BOOL)rewriteArchiveRemovingFilesPassingTest:(BOOL(^)(NSString *filename, unz_file_info64 *fileInfo))shouldRemove
+                           deletionDescription:(NSString *)deletionDescription
+                                         error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Rewriting Archive");
+    
+    if (![self recoverInterruptedDeletion:error]) {
+        return NO;
+    }
+    
+    if (self.deletesInPlace) {
+        return [self compactArchiveInPlaceRemovingFilesPassingTest:shouldRemove
+                                               deletionDescription:deletionDescription
+                                                             error:error];
+    }
+    
+    // Thanks to Ivan A. Krestinin for much of the code below: http://www.winimage.com/zLibDll/del.cpp
+    
     NSFileManager *fm = [NSFileManager defaultManager];
     
     if (!self.filename || ![fm fileExistsAtPath:(NSString* _Nonnull)self.filename]) {
-        UZKLogError("No archive exists at path %{public}@, when trying to delete %{public}@", self.filename, filePath);
+        UZKLogError("No archive exists at path %{public}@, when trying to delete %{public}@", self.filename, deletionDescription);
         return YES;
     }
     
@@ -1484,7 +2222,6 @@ compressionMethod:(UZKCompressionMethod)method
     UZKLogInfo("Writing new archive without deleted file to %{public}@", temporaryURL.path);
     
     const char *original_filename = self.filename.UTF8String;
-    const char *del_file = filePath.UTF8String;
     const char *temp_filename = temporaryURL.path.UTF8String;
     
     // Open source and destination files
@@ -1493,7 +2230,7 @@ compressionMethod:(UZKCompressionMethod)method
     zipFile source_zip = unzOpen(original_filename);
     if (source_zip == NULL) {
         NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening the source file while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                            filePath];
+                            deletionDescription];
         UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
         return [self assignError:error code:UZKErrorCodeDeleteFile
                           detail:detail];
@@ -1503,7 +2240,7 @@ compressionMethod:(UZKCompressionMethod)method
     zipFile dest_zip = zipOpen(temp_filename, APPEND_STATUS_CREATE);
     if (dest_zip == NULL) {
         NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening the destination file while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                            filePath];
+                            deletionDescription];
         UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
         UZKLogDebug("Closing source_zip");
         unzClose(source_zip);
@@ -1518,7 +2255,7 @@ compressionMethod:(UZKCompressionMethod)method
     int err = unzGetGlobalInfo(source_zip, &global_info);
     if (err != UNZ_OK) {
         NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting the global info of the source file while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                            filePath, err];
+                            deletionDescription, err];
         UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
         UZKLogDebug("Closing source_zip, dest_zip");
         zipClose(dest_zip, NULL);
@@ -1535,7 +2272,7 @@ compressionMethod:(UZKCompressionMethod)method
         global_comment = (char*)malloc(global_info.size_comment+1);
         if ((global_comment == NULL) && (global_info.size_comment != 0)) {
             NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error reading the global comment of the source file while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                                filePath];
+                                deletionDescription];
             UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
             UZKLogDebug("Closing source_zip, dest_zip");
             zipClose(dest_zip, NULL);
@@ -1546,7 +2283,7 @@ compressionMethod:(UZKCompressionMethod)method
         
         if ((unsigned int)unzGetGlobalComment(source_zip, global_comment, global_info.size_comment + 1) != global_info.size_comment) {
             NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error reading the global comment of the source file while deleting %@ (wrong size)", @"UnzipKit", _resources, @"Detailed error string"),
-                                filePath];
+                                deletionDescription];
             UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
             UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment");
             zipClose(dest_zip, NULL);
@@ -1560,7 +2297,8 @@ compressionMethod:(UZKCompressionMethod)method
     BOOL noFilesDeleted = YES;
     int filesCopied = 0;
     
-    NSString *filenameToDelete = [UZKArchive figureOutCString:del_file];
+    // Reused for every file copied, since the compressed data is copied as is
+    NSMutableData *copyBuffer = [NSMutableData dataWithLength:UZKRawCopyBufferSize];
     
     UZKLogInfo("Navigating to first file in source archive");
     int nextFileReturnValue = unzGoToFirstFile(source_zip);
@@ -1575,7 +2313,7 @@ compressionMethod:(UZKCompressionMethod)method
         err = unzGetCurrentFileInfo64(source_zip, &unzipInfo, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
         if (err != UNZ_OK) {
             NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting file info of file while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                filePath, err];
+                                deletionDescription, err];
             UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
             UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment");
             zipClose(dest_zip, NULL);
@@ -1588,16 +2326,16 @@ compressionMethod:(UZKCompressionMethod)method
         NSString *currentFileName = [UZKArchive figureOutCString:filename_inzip];
         UZKLogDebug("Current file is %{public}@", currentFileName);
         
-        // If this is the file to delete
-        if ([filenameToDelete isEqualToString:currentFileName.decomposedStringWithCanonicalMapping]) {
-            UZKLogDebug("This file is the one we're deleting");
+        // If this is a file to delete
+        if (shouldRemove && shouldRemove(currentFileName, &unzipInfo)) {
+            UZKLogDebug("This file is one we're deleting");
             noFilesDeleted = NO;
         } else {
             UZKLogDebug("Allocating extra field");
             char *extra_field = (char*)malloc(unzipInfo.size_file_extra);
             if ((extra_field == NULL) && (unzipInfo.size_file_extra != 0)) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error allocating extra_field info of %@ while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath];
+                                    currentFileName, deletionDescription];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
                 UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment");
                 zipClose(dest_zip, NULL);
@@ -1611,7 +2349,7 @@ compressionMethod:(UZKCompressionMethod)method
             char *commentary = (char*)malloc(unzipInfo.size_file_comment);
             if ((commentary == NULL) && (unzipInfo.size_file_comment != 0)) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error allocating commentary info of %@ while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath];
+                                    currentFileName, deletionDescription];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
                 UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field");
                 zipClose(dest_zip, NULL);
@@ -1626,7 +2364,7 @@ compressionMethod:(UZKCompressionMethod)method
             err = unzGetCurrentFileInfo64(source_zip, &unzipInfo, filename_inzip, FILE_IN_ZIP_MAX_NAME_LENGTH, extra_field, unzipInfo.size_file_extra, commentary, unzipInfo.size_file_comment);
             if (err != UNZ_OK) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error reading extra_field and commentary info of %@ while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath, err];
+                                    currentFileName, deletionDescription, err];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
                 UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary");
                 free(extra_field);
@@ -1643,7 +2381,7 @@ compressionMethod:(UZKCompressionMethod)method
             err = unzOpenCurrentFile2(source_zip, &method, &level, 1);
             if (err != UNZ_OK) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening %@ for raw reading while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath, err];
+                                    currentFileName, deletionDescription, err];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
                 UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary");
                 zipClose(dest_zip, NULL);
@@ -1659,7 +2397,7 @@ compressionMethod:(UZKCompressionMethod)method
             int size_local_extra = unzGetLocalExtrafield(source_zip, NULL, 0);
             if (size_local_extra < 0) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting size_local_extra for file while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath];
+                                    currentFileName, deletionDescription];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
                 UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary");
                 zipClose(dest_zip, NULL);
@@ -1675,7 +2413,7 @@ compressionMethod:(UZKCompressionMethod)method
             void *local_extra = malloc(size_local_extra);
             if ((local_extra == NULL) && (size_local_extra != 0)) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error allocating local_extra for file %@ while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath];
+                                    currentFileName, deletionDescription];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
                 UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary");
                 zipClose(dest_zip, NULL);
@@ -1690,25 +2428,7 @@ compressionMethod:(UZKCompressionMethod)method
             UZKLogDebug("Getting local extra field");
             if (unzGetLocalExtrafield(source_zip, local_extra, size_local_extra) < 0) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting local_extra for file %@ while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath];
-                UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
-                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra");
-                zipClose(dest_zip, NULL);
-                unzClose(source_zip);
-                free(global_comment);
-                free(extra_field);
-                free(commentary);
-                free(local_extra);
-                return [self assignError:error code:UZKErrorCodeDeleteFile
-                                  detail:detail];
-            }
-            
-            // This malloc may fail if the file is very large
-            UZKLogDebug("Allocating data read buffer");
-            void *buf = malloc((unsigned long)unzipInfo.compressed_size);
-            if ((buf == NULL) && (unzipInfo.compressed_size != 0)) {
-                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error allocating buffer for file %@ while deleting %@. Is it too large?", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath];
+                                    currentFileName, deletionDescription];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
                 UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra");
                 zipClose(dest_zip, NULL);
@@ -1721,25 +2441,6 @@ compressionMethod:(UZKCompressionMethod)method
                                   detail:detail];
             }
             
-            // Read file
-            UZKLogDebug("Reading data into buffer");
-            int size = unzReadCurrentFile(source_zip, buf, (uInt)unzipInfo.compressed_size);
-            if ((unsigned int)size != unzipInfo.compressed_size) {
-                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error reading %@ into buffer while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath];
-                UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
-                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra, buf");
-                zipClose(dest_zip, NULL);
-                unzClose(source_zip);
-                free(global_comment);
-                free(extra_field);
-                free(commentary);
-                free(local_extra);
-                free(buf);
-                return [self assignError:error code:UZKErrorCodeDeleteFile
-                                  detail:detail];
-            }
-            
             // Open destination archive
             
             UZKLogDebug("Filling zip_fileinfo struct");
@@ -1749,43 +2450,73 @@ compressionMethod:(UZKCompressionMethod)method
             zipInfo.internal_fa = unzipInfo.internal_fa;
             zipInfo.external_fa = unzipInfo.external_fa;
             
+            // The destination archive writes its own Zip64 fields, with offsets that don't match the source's
+            int size_file_extra = (int)unzipInfo.size_file_extra;
+            zipRemoveExtraInfoBlock(extra_field, &size_file_extra, 0x0001);
+            zipRemoveExtraInfoBlock(local_extra, &size_local_extra, 0x0001);
+            
+            int zip64 = unzipInfo.compressed_size >= 0xffffffff || unzipInfo.uncompressed_size >= 0xffffffff;
+            
+            // Keep the encryption flag, since the encrypted data is copied as-is
             UZKLogDebug("Opening file in destination archive");
-            err = zipOpenNewFileInZip2(dest_zip, filename_inzip, &zipInfo,
-                                       local_extra, size_local_extra, extra_field, (uInt)unzipInfo.size_file_extra, commentary,
-                                       method, level, 1);
+            err = zipOpenNewFileInZip4_64(dest_zip, filename_inzip, &zipInfo,
+                                          local_extra, size_local_extra, extra_field, size_file_extra, commentary,
+                                          method, level, 1,
+                                          -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+                                          NULL, 0, 0, unzipInfo.flag & 1, zip64);
             if (err != UNZ_OK) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening %@ in destination zip while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath, err];
+                                    currentFileName, deletionDescription, err];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
-                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra, buf");
+                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra");
                 zipClose(dest_zip, NULL);
                 unzClose(source_zip);
                 free(global_comment);
                 free(extra_field);
                 free(commentary);
                 free(local_extra);
-                free(buf);
                 return [self assignError:error code:UZKErrorCodeDeleteFile
                                   detail:detail];
             }
             
-            // Write file
-            UZKLogDebug("Writing file in destination archive");
-            err = zipWriteInFileInZip(dest_zip, buf, (uInt)unzipInfo.compressed_size);
-            if (err != UNZ_OK) {
-                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error writing %@ to destination zip while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath, err];
-                UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
-                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra, buf");
-                zipClose(dest_zip, NULL);
-                unzClose(source_zip);
-                free(global_comment);
-                free(extra_field);
-                free(commentary);
-                free(local_extra);
-                free(buf);
-                return [self assignError:error code:UZKErrorCodeDeleteFile
-                                  detail:detail];
+            // Copy the compressed data in chunks, so large files don't need to fit in memory
+            UZKLogDebug("Copying raw data to destination archive");
+            unsigned long long bytesRemaining = unzipInfo.compressed_size;
+            
+            while (bytesRemaining > 0) {
+                int size = unzReadCurrentFile(source_zip, copyBuffer.mutableBytes, (unsigned)MIN(copyBuffer.length, bytesRemaining));
+                if (size <= 0) {
+                    NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error reading %@ into buffer while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
+                                        currentFileName, deletionDescription];
+                    UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
+                    UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra");
+                    zipClose(dest_zip, NULL);
+                    unzClose(source_zip);
+                    free(global_comment);
+                    free(extra_field);
+                    free(commentary);
+                    free(local_extra);
+                    return [self assignError:error code:UZKErrorCodeDeleteFile
+                                      detail:detail];
+                }
+                
+                err = zipWriteInFileInZip(dest_zip, copyBuffer.mutableBytes, (unsigned)size);
+                if (err != UNZ_OK) {
+                    NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error writing %@ to destination zip while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                        currentFileName, deletionDescription, err];
+                    UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
+                    UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra");
+                    zipClose(dest_zip, NULL);
+                    unzClose(source_zip);
+                    free(global_comment);
+                    free(extra_field);
+                    free(commentary);
+                    free(local_extra);
+                    return [self assignError:error code:UZKErrorCodeDeleteFile
+                                      detail:detail];
+                }
+                
+                bytesRemaining -= (unsigned)size;
             }
             
             // Close destination archive
@@ -1793,16 +2524,15 @@ compressionMethod:(UZKCompressionMethod)method
             err = zipCloseFileInZipRaw64(dest_zip, unzipInfo.uncompressed_size, unzipInfo.crc);
             if (err != UNZ_OK) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error closing %@ in destination zip while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath, err];
+                                    currentFileName, deletionDescription, err];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
-                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra, buf");
+                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra");
                 zipClose(dest_zip, NULL);
                 unzClose(source_zip);
                 free(global_comment);
                 free(extra_field);
                 free(commentary);
                 free(local_extra);
-                free(buf);
                 return [self assignError:error code:UZKErrorCodeDeleteFile
                                   detail:detail];
             }
@@ -1812,25 +2542,23 @@ compressionMethod:(UZKCompressionMethod)method
             err = unzCloseCurrentFile(source_zip);
             if (err != UNZ_OK) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error closing %@ in source zip while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                    currentFileName, filePath, err];
+                                    currentFileName, deletionDescription, err];
                 UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
-                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra, buf");
+                UZKLogDebug("Closing source_zip, dest_zip, freeing global_comment, extra_field, commentary, local_extra");
                 zipClose(dest_zip, NULL);
                 unzClose(source_zip);
                 free(global_comment);
                 free(extra_field);
                 free(commentary);
                 free(local_extra);
-                free(buf);
                 return [self assignError:error code:UZKErrorCodeDeleteFile
                                   detail:detail];
             }
             
-            UZKLogDebug("Freeing extra_field, commentary, local_extra, buf");
+            UZKLogDebug("Freeing extra_field, commentary, local_extra");
             free(extra_field);
             free(commentary);
             free(local_extra);
-            free(buf);
             
             ++filesCopied;
         }
@@ -1846,8 +2574,8 @@ compressionMethod:(UZKCompressionMethod)method
     UZKLogDebug("Freeing global_comment");
     free(global_comment);
 
-    // Don't swap the files
-    if (noFilesDeleted) {
+    // Don't swap the files, unless the point was to rewrite the archive without its unreferenced data
+    if (noFilesDeleted && shouldRemove) {
         UZKLogInfo("No files deleted. Not replacing the original archive with the copy");
         return YES;
     }
@@ -1856,7 +2584,7 @@ compressionMethod:(UZKCompressionMethod)method
     if (nextFileReturnValue != UNZ_END_OF_LIST_OF_FILE)
     {
         NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to seek to the next file, while deleting %@ from the archive", @"UnzipKit", _resources, @"Detailed error string"),
-                            filenameToDelete];
+                            deletionDescription];
         UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
         UZKLogDebug("Removing temp_filename");
         remove(temp_filename);
@@ -1882,7 +2610,7 @@ compressionMethod:(UZKCompressionMethod)method
         
         if (!result) {
             NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to replace the old archive with the new one, after deleting '%@' from it (%@)", @"UnzipKit", _resources, @"Detailed error string"),
-                                filenameToDelete, replaceError.localizedDescription];
+                                deletionDescription, replaceError.localizedDescription];
             UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
             return [self assignError:error code:UZKErrorCodeDeleteFile
                               detail:detail
@@ -1897,7 +2625,7 @@ compressionMethod:(UZKCompressionMethod)method
         if (![fm removeItemAtURL:(NSURL* _Nonnull)newURL
                            error:&deleteError]) {
             NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to remove original archive from external volume '%@', after deleting '%@' from a new version to replace it (%@)", @"UnzipKit", _resources, @"Detailed error string"),
-                                destinationVolume, filenameToDelete, deleteError.localizedDescription];
+                                destinationVolume, deletionDescription, deleteError.localizedDescription];
             UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
             return [self assignError:error code:UZKErrorCodeDeleteFile
                               detail:detail
@@ -1910,7 +2638,7 @@ compressionMethod:(UZKCompressionMethod)method
                          toURL:(NSURL* _Nonnull)newURL
                          error:&copyError]) {
             NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to copy archive to external volume '%@', after deleting '%@' from it (%@)", @"UnzipKit", _resources, @"Detailed error string"),
-                                destinationVolume, filenameToDelete, copyError.localizedDescription];
+                                destinationVolume, deletionDescription, copyError.localizedDescription];
             UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
             return [self assignError:error code:UZKErrorCodeDeleteFile
                               detail:detail
@@ -1918,79 +2646,1146 @@ compressionMethod:(UZKCompressionMethod)method
         }
     }
     
-    UZKLogInfo("Updating archive bookmark");
-    NSError *bookmarkError = nil;
-    if (![self storeFileBookmark:newURL
-                           error:&bookmarkError]) {
-        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to store the new file bookmark to the archive after deleting '%@' from it: %@", @"UnzipKit", _resources, @"Detailed error string"),
-                            filenameToDelete, bookmarkError.localizedDescription];
-        UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
-        return [self assignError:error code:UZKErrorCodeDeleteFile
+    self.centralDirectory = nil;
+    
+    UZKLogInfo("Updating archive bookmark");
+    NSError *bookmarkError = nil;
+    if (![self storeFileBookmark:newURL
+                           error:&bookmarkError]) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to store the new file bookmark to the archive after deleting '%@' from it: %@", @"UnzipKit", _resources, @"Detailed error string"),
+                            deletionDescription, bookmarkError.localizedDescription];
+        UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeDeleteFile
+                          detail:detail
+                       underlyer:bookmarkError];
+    }
+    
+    return YES;
+}
+
+/**
+ *  Removes the files the test matches by sliding the rest down over them within the archive, without
+ *  making a copy of it. See UZKInPlaceCompactor for how an interruption is recovered from
+ *
+ *  @param shouldRemove        Returns YES for files to leave out. If nil, nothing is left out, and the
+ *                             archive is compacted to remove any unreferenced data
+ *  @param deletionDescription Describes the files being deleted, for error messages
+ */
+- (BOOL)compactArchiveInPlaceRemovingFilesPassingTest:(BOOL(^)(NSString *filename, unz_file_info64 *fileInfo))shouldRemove
+                                  deletionDescription:(NSString *)deletionDescription
+                                                error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Compacting Archive In Place");
+    
+    NSString *journalPath = self.deletionJournalPath;
+    
+    if (!journalPath || ![[NSFileManager defaultManager] fileExistsAtPath:(NSString* _Nonnull)self.filename]) {
+        UZKLogError("No archive exists at path %{public}@, when trying to delete %{public}@", self.filename, deletionDescription);
+        return YES;
+    }
+    
+    @synchronized(self.threadLock) {
+        if (![self waitForConcurrentReadsToFinish:error]) {
+            return NO;
+        }
+        
+        UZKLogInfo("Opening archive to find the files to keep");
+        unzFile source_zip = unzOpen64(self.filename.UTF8String);
+        if (source_zip == NULL) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening the source file while deleting %@", @"UnzipKit", _resources, @"Detailed error string"),
+                                deletionDescription];
+            UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
+            return [self assignError:error code:UZKErrorCodeDeleteFile
+                              detail:detail];
+        }
+        
+        NSMutableArray<NSNumber*> *recordsToKeep = [NSMutableArray array];
+        BOOL noFilesDeleted = YES;
+        
+        int err = unzGoToFirstFile(source_zip);
+        
+        while (err == UNZ_OK) {
+            char filename_inzip[FILE_IN_ZIP_MAX_NAME_LENGTH];
+            unz_file_info64 unzipInfo;
+            
+            err = unzGetCurrentFileInfo64(source_zip, &unzipInfo, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
+            if (err != UNZ_OK) {
+                break;
+            }
+            
+            NSString *currentFileName = [UZKArchive figureOutCString:filename_inzip];
+            
+            if (shouldRemove && shouldRemove(currentFileName, &unzipInfo)) {
+                UZKLogDebug("Deleting %{public}@", currentFileName);
+                noFilesDeleted = NO;
+            } else {
+                [recordsToKeep addObject:@(unzGetOffset64(source_zip))];
+            }
+            
+            err = unzGoToNextFile(source_zip);
+        }
+        
+        NSMutableData *globalComment = nil;
+        unz_global_info64 globalInfo;
+        
+        if (err == UNZ_END_OF_LIST_OF_FILE && unzGetGlobalInfo64(source_zip, &globalInfo) == UNZ_OK && globalInfo.size_comment > 0) {
+            globalComment = [NSMutableData dataWithLength:globalInfo.size_comment];
+            if (unzGetGlobalComment(source_zip, globalComment.mutableBytes, globalInfo.size_comment) != (int)globalInfo.size_comment) {
+                err = UNZ_ERRNO;
+            }
+        }
+        
+        unzClose(source_zip);
+        
+        if (err != UNZ_END_OF_LIST_OF_FILE) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting file info of file while deleting %@ (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                deletionDescription, err];
+            UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
+            return [self assignError:error code:UZKErrorCodeDeleteFile
+                              detail:detail];
+        }
+        
+        if (noFilesDeleted && shouldRemove) {
+            UZKLogInfo("No files deleted. Leaving the archive as it is");
+            return YES;
+        }
+        
+        UZKLogInfo("Moving %lu files down within the archive", (unsigned long)recordsToKeep.count);
+        err = [UZKInPlaceCompactor compactArchiveAtPath:(NSString* _Nonnull)self.filename
+                       keepingCentralDirectoryRecordsAt:recordsToKeep
+                                          globalComment:globalComment
+                                            journalPath:journalPath];
+        
+        self.centralDirectory = nil;
+        
+        if (err != 0) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error deleting %@ from the archive in place (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                deletionDescription, err];
+            UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
+            return [self assignError:error code:UZKErrorCodeDeleteFile
+                              detail:detail];
+        }
+    }
+    
+    return YES;
+}
+
+/**
+ *  Finishes an in-place deletion that was interrupted, if there's a journal left behind by one
+ */
+- (BOOL)recoverInterruptedDeletion:(NSError * __autoreleasing*)error
+{
+    NSString *journalPath = self.deletionJournalPath;
+    
+    if (!journalPath || access(journalPath.fileSystemRepresentation, F_OK) != 0) {
+        return YES;
+    }
+    
+    UZKCreateActivity("Recovering Interrupted Deletion");
+    
+    @synchronized(self.threadLock) {
+        if (![self waitForConcurrentReadsToFinish:error]) {
+            return NO;
+        }
+        
+        UZKLogInfo("Found the journal of an interrupted in-place deletion. Finishing it");
+        int err = [UZKInPlaceCompactor recoverArchiveAtPath:(NSString* _Nonnull)self.filename
+                                                journalPath:journalPath];
+        
+        if (err == ENOENT) {
+            UZKLogDebug("Another thread already finished the deletion");
+            return YES;
+        }
+        
+        self.centralDirectory = nil;
+        
+        if (err == EILSEQ) {
+            NSString *detail = NSLocalizedStringFromTableInBundle(@"The journal of an interrupted deletion from the archive is damaged, or doesn't belong to it", @"UnzipKit", _resources, @"Detailed error string");
+            UZKLogError("UZKErrorCodeDeletionJournalDamaged: %{public}@", detail);
+            return [self assignError:error code:UZKErrorCodeDeletionJournalDamaged
+                              detail:detail];
+        }
+        
+        if (err != 0) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error finishing an interrupted deletion from the archive (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                err];
+            UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
+            return [self assignError:error code:UZKErrorCodeDeleteFile
+                              detail:detail];
+        }
+    }
+    
+    return YES;
+}
+
+- (BOOL)discardDeletionJournal:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Discarding Deletion Journal");
+    
+    NSString *journalPath = self.deletionJournalPath;
+    
+    if (!journalPath) {
+        return YES;
+    }
+    
+    @synchronized(self.threadLock) {
+        if (![self waitForConcurrentReadsToFinish:error]) {
+            return NO;
+        }
+        
+        UZKLogInfo("Discarding the journal of an interrupted in-place deletion");
+        int err = unlink(journalPath.fileSystemRepresentation) == 0 ? 0 : errno;
+        
+        if (err != 0 && err != ENOENT) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error discarding the journal of an interrupted deletion from the archive (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                err];
+            UZKLogError("UZKErrorCodeDeleteFile: %{public}@", detail);
+            return [self assignError:error code:UZKErrorCodeDeleteFile
+                              detail:detail];
+        }
+        
+        self.centralDirectory = nil;
+    }
+    
+    return YES;
+}
+
+- (NSString *)deletionJournalPath
+{
+    return [self.filename stringByAppendingString:@".uzkjournal"];
+}
+
+
+
+#pragma mark - Private Methods
+
+
+- (BOOL)performActionWithArchiveOpen:(void(^)(NSError * __autoreleasing*innerError))action
+                              inMode:(UZKFileMode)mode
+                               error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Performing Action With Archive Open");
+    
+    if (![self recoverInterruptedDeletion:error]) {
+        return NO;
+    }
+    
+    if (mode == UZKFileModeUnzip && (self.allowsConcurrentReads || self.currentReadContext)) {
+        return [self performConcurrentReadAction:action
+                                           error:error];
+    }
+    
+    @synchronized(self.threadLock) {
+        if (error) {
+            *error = nil;
+        }
+        
+        if (mode != UZKFileModeUnzip && ![self waitForConcurrentReadsToFinish:error]) {
+            return NO;
+        }
+        
+        NSError *openError = nil;
+        NSError *actionError = nil;
+        
+        @try {
+            if (![self openFile:self.filename
+                         inMode:mode
+                   withPassword:self.password
+                          error:&openError])
+            {
+                UZKLogDebug("Archive failed to open. Reporting error");
+                
+                if (error) {
+                    *error = openError;
+                }
+                
+                return NO;
+            }
+            
+            if (action) {
+                UZKLogDebug("Performing action");
+                action(&actionError);
+            }
+        }
+        @finally {
+            NSError *closeError = nil;
+            if (![self closeFile:&closeError inMode:mode]) {
+                UZKLogDebug("Archive failed to close");
+
+                if (error && !actionError && !openError) {
+                    *error = closeError;
+                }
+                
+                return NO;
+            }
+        }
+        
+        if (error && actionError && !openError) {
+            *error = actionError;
+        }
+        
+        return !actionError;
+    }
+}
+
+- (BOOL)performConcurrentReadAction:(void(^)(NSError * __autoreleasing*innerError))action
+                              error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Performing Concurrent Read Action");
+    
+    if (error) {
+        *error = nil;
+    }
+    
+    NSError *actionError = nil;
+    
+    if (self.currentReadContext) {
+        UZKLogDebug("Archive already open for reading on this thread. Reusing its handle");
+        
+        if (action) {
+            action(&actionError);
+        }
+    } else {
+        UZKReadContext *context = [self beginConcurrentRead:error];
+        if (!context) {
+            UZKLogDebug("Archive failed to open. Reporting error");
+            return NO;
+        }
+        
+        NSMutableDictionary *threadDictionary = [NSThread currentThread].threadDictionary;
+        threadDictionary[self.readContextKey] = context;
+        
+        @try {
+            if (action) {
+                UZKLogDebug("Performing action");
+                action(&actionError);
+            }
+        }
+        @finally {
+            [threadDictionary removeObjectForKey:self.readContextKey];
+            [self endConcurrentRead:context];
+        }
+    }
+    
+    if (error && actionError) {
+        *error = actionError;
+    }
+    
+    return !actionError;
+}
+
+- (UZKReadContext *)currentReadContext
+{
+    return [NSThread currentThread].threadDictionary[self.readContextKey];
+}
+
+/**
+ *  Checks out a handle for the current thread, which it can read from without holding the thread lock.
+ *  Every successful call needs to be balanced by a call to -endConcurrentRead:
+ */
+- (UZKReadContext *)beginConcurrentRead:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Beginning Concurrent Read");
+    
+    NSString *path = self.filename;
+    
+    @synchronized(self.threadLock) {
+        if (self.mode != UZKFileModeUnassigned && self.mode != UZKFileModeUnzip) {
+            NSString *detail = NSLocalizedStringFromTableInBundle(@"Unable to begin reading from the archive until all write operations have completed", @"UnzipKit", _resources, @"Detailed error string");
+            UZKLogError("UZKErrorCodeMixedModeAccess: %{public}@", detail);
+            [self assignError:error code:UZKErrorCodeMixedModeAccess detail:detail];
+            return nil;
+        }
+        
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdirect-ivar-access"
+        if (!self.commentRetrieved) {
+            UZKLogDebug("Retrieving comment");
+            self.commentRetrieved = YES;
+            _comment = [self readGlobalComment];
+        }
+#pragma clang diagnostic pop
+        
+        if (!path || ![[NSFileManager defaultManager] fileExistsAtPath:path]) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"No file found at path %@", @"UnzipKit", _resources, @"Detailed error string"),
+                                path];
+            UZKLogError("UZKErrorCodeArchiveNotFound: %{public}@", detail);
+            [self assignError:error code:UZKErrorCodeArchiveNotFound detail:detail];
+            return nil;
+        }
+        
+        UZKReadContext *context = [self dequeueIdleReadContext];
+        
+        if (!context) {
+            UZKLogDebug("Opening new read handle...");
+            unzFile handle = [self openUnzipHandle:path];
+            if (handle == NULL) {
+                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening zip file %@", @"UnzipKit", _resources, @"Detailed error string"),
+                                    path];
+                UZKLogError("UZKErrorCodeBadZipFile: %{public}@", detail);
+                [self assignError:error code:UZKErrorCodeBadZipFile detail:detail];
+                return nil;
+            }
+            
+            if (![self loadCentralDirectoryFromHandle:handle error:error]) {
+                unzClose(handle);
+                return nil;
+            }
+            
+            context = [[UZKReadContext alloc] init];
+            context.handle = handle;
+            context.centralDirectory = self.centralDirectory;
+        }
+        
+        [self.readersCondition lock];
+        self.activeReaders++;
+        [self.readersCondition unlock];
+        
+        return context;
+    }
+}
+
+/**
+ *  Returns a handle checked out by -beginConcurrentRead: to the idle pool, or closes it if the pool is
+ *  full. Doesn't take the thread lock, so a writer holding it can wait for readers to finish
+ */
+- (void)endConcurrentRead:(UZKReadContext *)context
+{
+    UZKCreateActivity("Ending Concurrent Read");
+    
+    [self enqueueIdleReadContext:context];
+    
+    [self.readersCondition lock];
+    
+    if (--self.activeReaders == 0) {
+        [self.readersCondition broadcast];
+    }
+    
+    [self.readersCondition unlock];
+}
+
+- (BOOL)keepsIdleHandles
+{
+    return self.allowsConcurrentReads || self.idleHandleTimeout > 0;
+}
+
+/**
+ *  Takes a handle out of the idle pool, as long as the archive on disk still matches the central
+ *  directory it was opened with. Must be called while holding the thread lock
+ *
+ *  @return The handle and its central directory, or nil if there's no usable handle in the pool
+ */
+- (UZKReadContext *)dequeueIdleReadContext
+{
+    UZKCreateActivity("Dequeuing Idle Read Handle");
+    
+    [self closeExpiredIdleReadContexts];
+    
+    if (![self centralDirectoryMatchesArchive]) {
+        UZKLogDebug("Archive changed on disk. Not reusing idle handles");
+        return nil;
+    }
+    
+    UZKCentralDirectoryIndex *index = self.centralDirectory;
+    UZKReadContext *context = nil;
+    
+    [self.readersCondition lock];
+    
+    while (!context && self.idleReadContexts.count > 0) {
+        UZKReadContext *idleContext = self.idleReadContexts.lastObject;
+        [self.idleReadContexts removeLastObject];
+        
+        if (idleContext.centralDirectory == index) {
+            context = idleContext;
+        } else {
+            UZKLogDebug("Closing idle handle opened before the archive changed");
+            unzClose(idleContext.handle);
+        }
+    }
+    
+    [self.readersCondition unlock];
+    
+    if (context) {
+        UZKLogDebug("Reusing idle read handle");
+        unzSetReadBufferSize(context.handle, (uInt)MIN(self.readBufferSize, (NSUInteger)UINT_MAX));
+    }
+    
+    return context;
+}
+
+/**
+ *  Returns a handle to the idle pool, or closes it if idle handles aren't being kept or the pool is full.
+ *  Doesn't take the thread lock, so a writer holding it can wait for readers to finish
+ */
+- (void)enqueueIdleReadContext:(UZKReadContext *)context
+{
+    UZKCreateActivity("Enqueuing Idle Read Handle");
+    
+    NSUInteger maxIdleHandles = self.maxIdleHandles > 0 ? self.maxIdleHandles : [NSProcessInfo processInfo].activeProcessorCount;
+    NSTimeInterval timeout = self.idleHandleTimeout;
+    BOOL keepHandle = NO;
+    
+    [self.readersCondition lock];
+    
+    if ([self keepsIdleHandles] && context.centralDirectory && self.idleReadContexts.count < maxIdleHandles) {
+        UZKLogDebug("Returning read handle to idle pool");
+        context.idleSince = [NSProcessInfo processInfo].systemUptime;
+        [self.idleReadContexts addObject:context];
+        keepHandle = YES;
+    }
+    
+    [self.readersCondition unlock];
+    
+    if (!keepHandle) {
+        UZKLogDebug("Not keeping read handle. Closing it");
+        int err = unzClose(context.handle);
+        if (err != UNZ_OK) {
+            UZKLogError("Error closing read handle (%d)", err);
+        }
+        return;
+    }
+    
+    if (timeout > 0) {
+        __weak UZKArchive *welf = self;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)),
+                       dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                           [welf closeExpiredIdleReadContexts];
+                       });
+    }
+}
+
+- (void)closeExpiredIdleReadContexts
+{
+    NSTimeInterval timeout = self.idleHandleTimeout;
+    if (timeout <= 0) {
+        return;
+    }
+    
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    
+    [self.readersCondition lock];
+    
+    NSIndexSet *expired = [self.idleReadContexts indexesOfObjectsPassingTest:^BOOL(UZKReadContext *context, NSUInteger idx, BOOL *stop) {
+        return now - context.idleSince >= timeout;
+    }];
+    
+    if (expired.count > 0) {
+        UZKLogDebug("Closing %lu handles idle for longer than %f seconds", (unsigned long)expired.count, timeout);
+        
+        for (UZKReadContext *context in [self.idleReadContexts objectsAtIndexes:expired]) {
+            unzClose(context.handle);
+        }
+        
+        [self.idleReadContexts removeObjectsAtIndexes:expired];
+    }
+    
+    [self.readersCondition unlock];
+}
+
+/**
+ *  Blocks until no other threads are reading the archive concurrently, and closes any idle read
+ *  handles. Must be called while holding the thread lock, so no new reads can begin in the meantime
+ */
+- (BOOL)waitForConcurrentReadsToFinish:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Waiting for Concurrent Reads");
+    
+    if (self.currentReadContext) {
+        NSString *detail = NSLocalizedStringFromTableInBundle(@"Unable to begin writing to the archive until all read operations have completed", @"UnzipKit", _resources, @"Detailed error string");
+        UZKLogError("UZKErrorCodeMixedModeAccess: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeMixedModeAccess detail:detail];
+    }
+    
+    [self.readersCondition lock];
+    
+    while (self.activeReaders > 0) {
+        UZKLogDebug("Waiting for %lu concurrent reads to finish", (unsigned long)self.activeReaders);
+        [self.readersCondition wait];
+    }
+    
+    for (UZKReadContext *context in self.idleReadContexts) {
+        unzClose(context.handle);
+    }
+    [self.idleReadContexts removeAllObjects];
+    
+    [self.readersCondition unlock];
+    
+    return YES;
+}
+
+- (BOOL)extractFilesInParallelTo:(NSString *)destinationDirectory
+                       overwrite:(BOOL)overwrite
+                     concurrency:(NSUInteger)concurrency
+                       totalSize:(double)totalSize
+                        progress:(NSProgress *)progress
+                   progressBlock:(void (^)(UZKFileInfo *currentFile, CGFloat percentArchiveDecompressed))progressBlock
+                           error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Extracting Files in Parallel");
+    
+    __weak UZKArchive *welf = self;
+    
+    return [self performActionWithArchiveOpen:^(NSError * __autoreleasing*innerError) {
+        UZKCreateActivity("Performing Parallel Extraction");
+        
+        UZKCentralDirectoryIndex *index = welf.centralDirectory;
+        NSArray<UZKFileInfo*> *fileInfo = index.allFileInfo;
+        NSString *archivePath = welf.filename;
+        NSFileManager *fm = [[NSFileManager alloc] init];
+        
+        UZKLogInfo("Collecting files and directories to extract");
+        NSMutableArray<NSNumber*> *queue = [NSMutableArray arrayWithCapacity:fileInfo.count];
+        NSMutableSet<NSString*> *directories = [NSMutableSet set];
+        
+        for (NSUInteger i = 0; i < fileInfo.count; i++) {
+            UZKFileInfo *info = fileInfo[i];
+            NSString *extractPath = [destinationDirectory stringByAppendingPathComponent:info.filename];
+            
+            // Like a serial extraction, stop at the first item that already exists, leaving it and
+            // everything after it in the archive alone
+            if ([fm fileExistsAtPath:extractPath] && !overwrite) {
+                UZKLogDebug("%{public}@ exists and overwrite==NO. Not extracting it or any later files", extractPath);
+                break;
+            }
+            
+            if (info.isDirectory) {
+                [directories addObject:extractPath];
+                continue;
+            }
+            
+            [directories addObject:extractPath.stringByDeletingLastPathComponent];
+            [queue addObject:@(i)];
+        }
+        
+        // Creating every directory up front means the workers never race to create the same one
+        UZKLogInfo("Creating %lu directories", (unsigned long)directories.count);
+        for (NSString *directory in [directories.allObjects sortedArrayUsingSelector:@selector(compare:)]) {
+            if ([fm fileExistsAtPath:directory]) {
+                continue;
+            }
+            
+            NSError *createError = nil;
+            if (![fm createDirectoryAtPath:directory
+               withIntermediateDirectories:YES
+                                attributes:nil
+                                     error:&createError])
+            {
+                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to create destination directory: %@", @"UnzipKit", _resources, @"Detailed error string"),
+                                    directory];
+                UZKLogError("UZKErrorCodeOutputError: %{public}@", detail);
+                [welf assignError:innerError code:UZKErrorCodeOutputError
+                           detail:detail
+                        underlyer:createError];
+                return;
+            }
+        }
+        
+        UZKLogDebug("Ordering files by compressed size, largest first");
+        [queue sortWithOptions:NSSortStable
+               usingComparator:^NSComparisonResult(NSNumber *left, NSNumber *right) {
+                   ZPOS64_T leftSize = [index headerAtIndex:left.unsignedIntegerValue]->compressed_size;
+                   ZPOS64_T rightSize = [index headerAtIndex:right.unsignedIntegerValue]->compressed_size;
+                   
+                   if (leftSize == rightSize) {
+                       return NSOrderedSame;
+                   }
+                   
+                   return leftSize > rightSize ? NSOrderedAscending : NSOrderedDescending;
+               }];
+        
+        const char *password = [welf.password cStringUsingEncoding:NSISOLatin1StringEncoding];
+        NSObject *queueLock = [[NSObject alloc] init];
+        __block NSUInteger nextItem = 0;
+        __block long long bytesDecompressed = 0;
+        __block NSInteger filesExtracted = 0;
+        __block NSError *firstError = nil;
+        
+        size_t workerCount = MIN(concurrency, queue.count);
+        UZKLogInfo("Extracting %lu files using %lu workers", (unsigned long)queue.count, (unsigned long)workerCount);
+        
+        // The workers read through one shared descriptor, using pread so they don't move each other's offsets
+        int descriptor = open(archivePath.fileSystemRepresentation, O_RDONLY);
+        const int *sharedDescriptor = descriptor >= 0 ? &descriptor : NULL;
+        
+        dispatch_apply(workerCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+            UZKCreateActivity("Extraction Worker");
+            
+            UZKLogDebug("Opening archive for worker %lu", (unsigned long)worker);
+            unzFile handle = [welf openUnzipHandle:archivePath
+                                  sharedDescriptor:sharedDescriptor];
+            
+            if (handle == NULL) {
+                NSError *openError = nil;
+                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening zip file %@", @"UnzipKit", _resources, @"Detailed error string"),
+                                    archivePath];
+                UZKLogError("UZKErrorCodeBadZipFile: %{public}@", detail);
+                [welf assignError:&openError code:UZKErrorCodeBadZipFile
+                           detail:detail];
+                
+                @synchronized(queueLock) {
+                    if (!firstError) {
+                        firstError = openError;
+                    }
+                }
+                return;
+            }
+            
+            NSMutableData *buffer = [NSMutableData dataWithLength:1024 * 256]; // 256 kb, arbitrary
+            
+            for (;;) {
+                NSUInteger item = NSNotFound;
+                
+                @synchronized(queueLock) {
+                    if (!firstError && nextItem < queue.count) {
+                        item = queue[nextItem++].unsignedIntegerValue;
+                    }
+                }
+                
+                if (item == NSNotFound) {
+                    UZKLogDebug("Worker %lu finished", (unsigned long)worker);
+                    break;
+                }
+                
+                @autoreleasepool {
+                    UZKFileInfo *info = fileInfo[item];
+                    NSError *itemError = nil;
+                    
+                    if (progress.isCancelled) {
+                        NSString *detail = NSLocalizedStringFromTableInBundle(@"User cancelled operation", @"UnzipKit", _resources, @"Detailed error string");
+                        UZKLogError("Halted file extraction due to user cancellation: %{public}@", detail);
+                        [welf assignError:&itemError code:UZKErrorCodeUserCancelled
+                                   detail:detail];
+                    }
+                    else {
+                        NSURL *deflatedFileURL = [[NSURL fileURLWithPath:destinationDirectory] URLByAppendingPathComponent:info.filename];
+                        
+                        @synchronized(queueLock) {
+                            [progress setUserInfoObject:deflatedFileURL
+                                                 forKey:NSProgressFileURLKey];
+                            [progress setUserInfoObject:info
+                                                 forKey:UZKProgressInfoKeyFileInfoExtracting];
+                            
+                            if (progressBlock) {
+                                progressBlock(info, bytesDecompressed / totalSize);
+                            }
+                        }
+                        
+                        unz64_file_pos position = [index positionAtIndex:item];
+                        int err = unzGoToFilePos64(handle, &position);
+                        
+                        if (err != UNZ_OK) {
+                            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error locating file '%@' in archive", @"UnzipKit", _resources, @"Detailed error string"),
+                                                info.filename];
+                            UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
+                            [welf assignError:&itemError code:UZKErrorCodeFileNotFoundInArchive
+                                       detail:detail];
+                        }
+                        else {
+                            [welf extractCurrentFile:info
+                                          fromHandle:handle
+                                            password:password
+                                              toPath:(NSString * _Nonnull)deflatedFileURL.path
+                                              buffer:buffer
+                                        chunkWritten:^BOOL(NSUInteger length) {
+                                            @synchronized(queueLock) {
+                                                bytesDecompressed += length;
+                                                progress.completedUnitCount = bytesDecompressed;
+                                                
+                                                if (progressBlock) {
+                                                    progressBlock(info, bytesDecompressed / totalSize);
+                                                }
+                                                
+                                                return !firstError && !progress.isCancelled;
+                                            }
+                                        }
+                                               error:&itemError];
+                        }
+                    }
+                    
+                    @synchronized(queueLock) {
+                        if (itemError) {
+                            if (!firstError) {
+                                firstError = itemError;
+                            }
+                        }
+                        else {
+                            [progress setUserInfoObject:@(++filesExtracted)
+                                                 forKey:NSProgressFileCompletedCountKey];
+                            [progress setUserInfoObject:@(fileInfo.count)
+                                                 forKey:NSProgressFileTotalCountKey];
+                        }
+                    }
+                }
+            }
+            
+            unzClose(handle);
+        });
+        
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+        
+        if (firstError) {
+            if (firstError.code != UZKErrorCodeUserCancelled) {
+                UZKLogInfo("Cleaning up target directory after failure: %{public}@", destinationDirectory);
+                // Remove the directory we were going to unzip to if it fails.
+                [fm removeItemAtPath:destinationDirectory
+                               error:nil];
+            }
+            
+            *innerError = firstError;
+        }
+    } inMode:UZKFileModeUnzip error:error];
+}
+
+- (BOOL)extractCurrentFile:(UZKFileInfo *)info
+                fromHandle:(unzFile)handle
+                  password:(const char *)password
+                    toPath:(NSString *)path
+                    buffer:(NSMutableData *)buffer
+              chunkWritten:(BOOL(^)(NSUInteger length))chunkWritten
+                     error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("extractCurrentFile");
+    
+    UZKLogDebug("Getting file info");
+    unz_file_info64 file_info;
+    int err = unzGetCurrentFileInfo64(handle, &file_info, NULL, 0, NULL, 0, NULL, 0);
+    if (err != UNZ_OK) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting current file info for archive (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            err];
+        UZKLogError("UZKErrorCodeInternalError: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeInternalError
+                          detail:detail];
+    }
+    
+    if ([self isDeflate64:file_info]) {
+        NSString *detail = NSLocalizedStringFromTableInBundle(@"Cannot open archive, since it was compressed using the Deflate64 algorithm (method ID 9)", @"UnzipKit", _resources, @"Error message");
+        UZKLogError("UZKErrorCodeDeflate64: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeDeflate64
+                          detail:detail];
+    }
+    
+    UZKLogDebug("Opening file...");
+    err = unzOpenCurrentFilePassword(handle, password);
+    if (err == UNZ_BADPASSWORD) {
+        err = UZKErrorCodeInvalidPassword;
+    }
+    
+    if (err != UNZ_OK) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening archive (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            err];
+        UZKLogError("%{public}@", detail);
+        return [self assignError:error code:err
+                          detail:detail];
+    }
+    
+    UZKLogDebug("Creating empty file at path %{public}@", path);
+    NSFileHandle *fileHandle = nil;
+    if ([[NSFileManager defaultManager] createFileAtPath:path
+                                                contents:nil
+                                              attributes:nil])
+    {
+        fileHandle = [NSFileHandle fileHandleForWritingAtPath:path];
+    }
+    
+    if (!fileHandle) {
+        unzCloseCurrentFile(handle);
+        
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error writing to file: %@", @"UnzipKit", _resources, @"Detailed error string"),
+                            path];
+        UZKLogError("UZKErrorCodeOutputError: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeOutputError
+                          detail:detail];
+    }
+    
+    NSError *readError = nil;
+    
+    for (;;) {
+        int bytesRead = unzReadCurrentFile(handle, buffer.mutableBytes, (unsigned)buffer.length);
+        
+        if (bytesRead < 0) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to read file %@ in zip", @"UnzipKit", _resources, @"Detailed error string"),
+                                info.filename];
+            UZKLogError("Error reading data (code %d): %{public}@", bytesRead, detail);
+            [self assignError:&readError code:bytesRead
+                       detail:detail];
+            break;
+        }
+        else if (bytesRead == 0) {
+            UZKLogDebug("Done reading file");
+            break;
+        }
+        
+        [fileHandle writeData:[NSData dataWithBytesNoCopy:buffer.mutableBytes
+                                                   length:(NSUInteger)bytesRead
+                                             freeWhenDone:NO]];
+        
+        if (!chunkWritten((NSUInteger)bytesRead)) {
+            NSString *detail = NSLocalizedStringFromTableInBundle(@"User cancelled operation", @"UnzipKit", _resources, @"Detailed error string");
+            UZKLogInfo("Stopping extraction of %{public}@: %{public}@", info.filename, detail);
+            [self assignError:&readError code:UZKErrorCodeUserCancelled
+                       detail:detail];
+            break;
+        }
+    }
+    
+    UZKLogDebug("Closing file handle");
+    [fileHandle closeFile];
+    
+    err = unzCloseCurrentFile(handle);
+    
+    if (readError) {
+        if (error) {
+            *error = readError;
+        }
+        
+        return NO;
+    }
+    
+    if (err != UNZ_OK) {
+        if (err == UZKErrorCodeCRCError) {
+            err = UZKErrorCodeInvalidPassword;
+        }
+        
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error closing '%@' after extracting it (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            info.filename, err];
+        UZKLogError("Error closing file (code %d): %{public}@", err, detail);
+        return [self assignError:error code:err
+                          detail:detail];
+    }
+    
+    // Restore the timestamp and permission attributes of the file
+    NSDictionary* attribs = @{NSFileModificationDate: info.timestamp,
+                              NSFilePosixPermissions: @(info.posixPermissions)};
+    [[NSFileManager defaultManager] setAttributes:attribs ofItemAtPath:path error:nil];
+    
+    return YES;
+}
+
+/**
+ *  @param dataLength The number of bytes to be written, or ULLONG_MAX if it isn't known up front
+ *
+ *  @return A deflater that compresses a file's data on several threads and writes it to the open file in the
+ *          archive, or nil if the data should be compressed by MiniZip on the calling thread
+ */
+- (UZKParallelDeflater *)parallelDeflaterForCompressionMethod:(UZKCompressionMethod)method
+                                                   dataLength:(unsigned long long)dataLength
+{
+    NSUInteger concurrency = self.maxConcurrentCompressions ?: [NSProcessInfo processInfo].activeProcessorCount;
+    
+    if (method == UZKCompressionMethodNone || concurrency < 2 || dataLength <= UZKParallelDeflateBlockSize) {
+        return nil;
+    }
+    
+    UZKLogDebug("Compressing on up to %lu threads", (unsigned long)concurrency);
+    
+    __weak UZKArchive *welf = self;
+    return [[UZKParallelDeflater alloc] initWithLevel:(int)method
+                                          concurrency:concurrency
+                                            blockSize:UZKParallelDeflateBlockSize
+                                               output:^int(const void *bytes, NSUInteger length) {
+                                                   return zipWriteInFileInZip(welf.zipFile, bytes, (unsigned)length);
+                                               }];
+}
+
+/**
+ *  Loads and compresses an entry. Runs in the background, so it doesn't touch any archive state
+ */
++ (void)compressEntry:(UZKCompressedEntry *)compressed
+{
+    UZKCreateActivity("Compressing Entry");
+    
+    UZKWriteEntry *entry = compressed.entry;
+    
+    NSError *loadError = nil;
+    NSData *data = [entry loadData:&loadError];
+    
+    if (!data) {
+        UZKLogError("Failed to load data for %{public}@: %{public}@", entry.filePath, loadError);
+        compressed.loadError = loadError ?: [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:nil];
+        return;
+    }
+    
+    compressed.uncompressedSize = data.length;
+    compressed.residentBytes = data.length;
+    
+    if (entry.compressionMethod == UZKCompressionMethodNone) {
+        compressed.crc = crc32_fast(0, data.bytes, data.length);
+        compressed.data = data;
+        compressed.status = Z_OK;
+        return;
+    }
+    
+    uLong crc = 0;
+    int status = Z_OK;
+    NSData *deflated = [UZKParallelDeflater deflateData:data
+                                                  level:(int)entry.compressionMethod
+                                                    crc:&crc
+                                                 status:&status];
+    
+    compressed.crc = crc;
+    compressed.status = status;
+    
+    if (!deflated) {
+        UZKLogError("Failed to compress %{public}@: %d", entry.filePath, status);
+        compressed.residentBytes = 0;
+        return;
+    }
+    
+    if (deflated.length > UZKWriteEntrySpillThreshold) {
+        UZKLogDebug("Spilling %{iec-bytes}lu of compressed data for %{public}@ to disk", (unsigned long)deflated.length, entry.filePath);
+        
+        NSURL *spillURL = [[NSURL fileURLWithPath:NSTemporaryDirectory()]
+                           URLByAppendingPathComponent:[NSString stringWithFormat:@"UnzipKit-%@", [NSUUID UUID].UUIDString]];
+        
+        NSError *spillError = nil;
+        NSData *spilled = nil;
+        
+        if ([deflated writeToURL:spillURL options:0 error:&spillError]) {
+            spilled = [NSData dataWithContentsOfURL:spillURL options:NSDataReadingMappedAlways error:&spillError];
+            
+            // The mapping stays valid after the file is unlinked, and the space is reclaimed once it's released
+            [[NSFileManager defaultManager] removeItemAtURL:spillURL error:nil];
+        }
+        
+        if (spilled) {
+            compressed.data = spilled;
+            compressed.residentBytes = 0;
+            return;
+        } else {
+            UZKLogInfo("Failed to spill compressed data to disk, keeping it in memory: %{public}@", spillError);
+        }
+    }
+    
+    compressed.data = deflated;
+    compressed.residentBytes = deflated.length;
+}
+
+/**
+ *  @return The total bytes held in memory by entries waiting to be written, including those still compressing
+ */
++ (unsigned long long)residentBytesOfEntries:(NSArray<UZKCompressedEntry*> *)entries
+{
+    unsigned long long total = 0;
+    for (UZKCompressedEntry *compressed in entries) {
+        total += compressed.residentBytes;
+    }
+    return total;
+}
+
+/**
+ *  Writes an entry's already-compressed data into the open archive
+ */
+- (BOOL)writeCompressedEntry:(UZKCompressedEntry *)compressed
+                    password:(const char *)passwordStr
+                       error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("Writing Compressed Entry");
+    
+    NSString *filePath = compressed.entry.filePath;
+    
+    if (compressed.loadError) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error loading data for '%@'", @"UnzipKit", _resources, @"Detailed error string"),
+                            filePath];
+        UZKLogError("UZKErrorCodeFileRead: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeFileRead
                           detail:detail
-                       underlyer:bookmarkError];
+                       underlyer:compressed.loadError];
+    }
+    
+    if (compressed.status != Z_OK) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error compressing '%@' (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            filePath, compressed.status];
+        UZKLogError("UZKErrorCodeZLibError: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeZLibError
+                          detail:detail];
+    }
+    
+    UZKCompressionMethod method = compressed.entry.compressionMethod;
+    zip_fileinfo zi = [UZKArchive zipFileInfoForDate:compressed.entry.fileDate
+                                    posixPermissions:compressed.entry.posixPermissions];
+    
+    UZKLogDebug("Opening new file %{public}@ for raw write...", filePath);
+    int err = zipOpenNewFileInZip3(self.zipFile,
+                                   filePath.UTF8String,
+                                   &zi,
+                                   NULL, 0, NULL, 0, NULL,
+                                   (method != UZKCompressionMethodNone) ? Z_DEFLATED : 0,
+                                   method,
+                                   1,
+                                   -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+                                   passwordStr,
+                                   compressed.crc);
+    
+    if (err != ZIP_OK) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening file '%@' for write (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            filePath, err];
+        UZKLogError("UZKErrorCodeFileOpenForWrite: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeFileOpenForWrite
+                          detail:detail];
+    }
+    
+    NSData *data = compressed.data;
+    
+    for (NSUInteger i = 0; i < data.length && err == ZIP_OK; i += UINT_MAX / 2) {
+        err = zipWriteInFileInZip(self.zipFile, (const char *)data.bytes + i, (unsigned)MIN(UINT_MAX / 2, data.length - i));
+    }
+    
+    if (err != ZIP_OK) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error writing to file  '%@' (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            filePath, err];
+        UZKLogError("UZKErrorCodeFileWrite: %{public}@", detail);
+        zipCloseFileInZipRaw64(self.zipFile, compressed.uncompressedSize, compressed.crc);
+        return [self assignError:error code:UZKErrorCodeFileWrite
+                          detail:detail];
+    }
+    
+    UZKLogDebug("Closing file...");
+    err = zipCloseFileInZipRaw64(self.zipFile, compressed.uncompressedSize, compressed.crc);
+    if (err != ZIP_OK) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error closing file '%@' for write (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            filePath, err];
+        UZKLogError("UZKErrorCodeFileWrite: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeFileWrite
+                          detail:detail];
     }
     
     return YES;
 }
 
-
-
-#pragma mark - Private Methods
-
-
-- (BOOL)performActionWithArchiveOpen:(void(^)(NSError * __autoreleasing*innerError))action
-                              inMode:(UZKFileMode)mode
-                               error:(NSError * __autoreleasing*)error
+/**
+ *  Deletes the files in the archive that the given entries would replace. A missing or empty archive
+ *  isn't an error, since there's nothing to delete
+ */
+- (BOOL)deleteExistingFilesForEntries:(NSArray<UZKWriteEntry*> *)entries
+                                error:(NSError * __autoreleasing*)error
 {
-    UZKCreateActivity("Performing Action With Archive Open");
+    UZKCreateActivity("Deleting Existing Files For Entries");
     
-    @synchronized(self.threadLock) {
-        if (error) {
-            *error = nil;
-        }
-        
-        NSError *openError = nil;
-        NSError *actionError = nil;
-        
-        @try {
-            if (![self openFile:self.filename
-                         inMode:mode
-                   withPassword:self.password
-                          error:&openError])
-            {
-                UZKLogDebug("Archive failed to open. Reporting error");
-                
-                if (error) {
-                    *error = openError;
-                }
-                
-                return NO;
-            }
-            
-            if (action) {
-                UZKLogDebug("Performing action");
-                action(&actionError);
-            }
-        }
-        @finally {
-            NSError *closeError = nil;
-            if (![self closeFile:&closeError inMode:mode]) {
-                UZKLogDebug("Archive failed to close");
-
-                if (error && !actionError && !openError) {
-                    *error = closeError;
-                }
-                
-                return NO;
-            }
-        }
-        
-        if (error && actionError && !openError) {
-            *error = actionError;
+    NSError *listError = nil;
+    NSArray<NSString*> *existingFilenames = [self listFilenames:&listError];
+    
+    if (!existingFilenames) {
+        UZKLogDebug("No existing files to overwrite: %{public}@", listError);
+        return YES;
+    }
+    
+    NSSet<NSString*> *existing = [NSSet setWithArray:existingFilenames];
+    NSMutableOrderedSet<NSString*> *toDelete = [NSMutableOrderedSet orderedSet];
+    
+    for (UZKWriteEntry *entry in entries) {
+        if ([existing containsObject:entry.filePath]) {
+            [toDelete addObject:entry.filePath];
         }
-        
-        return !actionError;
     }
+    
+    if (toDelete.count == 0) {
+        return YES;
+    }
+    
+    UZKLogInfo("Deleting %lu files before writing the entries replacing them", (unsigned long)toDelete.count);
+    return [self deleteFiles:toDelete.array error:error];
 }
 
 - (BOOL)performWriteAction:(int(^)(uLong *crc, NSError * __autoreleasing*innerError))write
@@ -2001,10 +3796,13 @@ compressionMethod:(UZKCompressionMethod)method
                   password:(NSString *)password
                  overwrite:(BOOL)overwrite
                        CRC:(uLong)crc
+                  deflater:(UZKParallelDeflater *)deflater
                      error:(NSError * __autoreleasing*)error
 {
     UZKCreateActivity("Performing Write");
     
+    NSIndexSet *staleEntries = nil;
+    
     if (overwrite) {
         UZKLogInfo("Overwriting %{public}@ if it already exists. Will look for existing file to delete", filePath);
         
@@ -2020,15 +3818,14 @@ compressionMethod:(UZKCompressionMethod)method
             UZKLogDebug("Existing files found. Looking for matches to filePath %{public}@", filePath);
             NSIndexSet *matchingFiles = [existingFiles indexesOfObjectsPassingTest:
                                          ^BOOL(UZKFileInfo *info, NSUInteger idx, BOOL *stop) {
-                                             if ([info.filename isEqualToString:filePath]) {
-                                                 *stop = YES;
-                                                 return YES;
-                                             }
-                                             
-                                             return NO;
+                                             return [info.filename isEqualToString:filePath];
                                          }];
             
-            if (matchingFiles.count > 0 && ![self deleteFile:filePath error:error]) {
+            if (matchingFiles.count > 0 && self.overwritesByAppending) {
+                UZKLogDebug("Will drop %lu existing entries from the central directory instead of deleting them", (unsigned long)matchingFiles.count);
+                staleEntries = matchingFiles;
+            }
+            else if (matchingFiles.count > 0 && ![self deleteFile:filePath error:error]) {
                 UZKLogError("Failed to delete %{public}@ before writing new data for it", filePath);
                 return NO;
             }
@@ -2056,6 +3853,26 @@ compressionMethod:(UZKCompressionMethod)method
             passwordStr = [password cStringUsingEncoding:NSISOLatin1StringEncoding];
         }
         
+        if (staleEntries.count > 0) {
+            UZKLogDebug("Removing %lu stale entries from the central directory...", (unsigned long)staleEntries.count);
+            
+            NSMutableData *positions = [NSMutableData dataWithLength:staleEntries.count * sizeof(ZPOS64_T)];
+            __block ZPOS64_T *nextPosition = positions.mutableBytes;
+            [staleEntries enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *stop) {
+                *nextPosition++ = idx;
+            }];
+            
+            int removeErr = zipRemoveCentralDirEntries(welf.zipFile, positions.bytes, staleEntries.count);
+            if (removeErr != ZIP_OK) {
+                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error removing the existing '%@' from the central directory (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                    filePath, removeErr];
+                UZKLogError("UZKErrorCodeFileWrite: %{public}@", detail);
+                [welf assignError:innerError code:UZKErrorCodeFileWrite
+                           detail:detail];
+                return;
+            }
+        }
+        
         UZKLogDebug("Opening new file...");
         int err = zipOpenNewFileInZip3(welf.zipFile,
                                        filePath.UTF8String,
@@ -2063,7 +3880,7 @@ compressionMethod:(UZKCompressionMethod)method
                                        NULL, 0, NULL, 0, NULL,
                                        (method != UZKCompressionMethodNone) ? Z_DEFLATED : 0,
                                        method,
-                                       0,
+                                       deflater != nil,
                                        -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
                                        passwordStr,
                                        crc);
@@ -2090,7 +3907,12 @@ compressionMethod:(UZKCompressionMethod)method
         }
         
         UZKLogDebug("Closing file...");
-        err = zipCloseFileInZipRaw(self.zipFile, 0, outCRC);
+        if (deflater) {
+            // The data was written already compressed, so MiniZip didn't count its uncompressed size
+            err = zipCloseFileInZipRaw64(self.zipFile, deflater.uncompressedSize, outCRC);
+        } else {
+            err = zipCloseFileInZipRaw(self.zipFile, 0, outCRC);
+        }
         if (err != ZIP_OK) {
             NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error closing file '%@' for write (%d)", @"UnzipKit", _resources, @"Detailed error string"),
                                 filePath, err];
@@ -2168,8 +3990,14 @@ compressionMethod:(UZKCompressionMethod)method
                 return NO;
             }
             
+            UZKReadContext *idleContext = [self dequeueIdleReadContext];
+            if (idleContext) {
+                self.unzFile = idleContext.handle;
+                break;
+            }
+            
             UZKLogDebug("Opening file for read...");
-            self.unzFile = unzOpen(self.filename.UTF8String);
+            self.unzFile = [self openUnzipHandle:zipFile];
             if (self.unzFile == NULL) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening zip file %@", @"UnzipKit", _resources, @"Detailed error string"),
                                     zipFile];
@@ -2179,44 +4007,10 @@ compressionMethod:(UZKCompressionMethod)method
                 return NO;
             }
             
-            UZKLogDebug("Seeking to first file...");
-            int err = unzGoToFirstFile(self.unzFile);
-            if (err != UNZ_OK) {
-                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error going to first file in archive (%d)", @"UnzipKit", _resources, @"Detailed error string"),
-                                    err];
-                UZKLogError("UZKErrorCodeFileNavigationError: %{public}@", detail);
-                [self assignError:error code:UZKErrorCodeFileNavigationError
-                           detail:detail];
+            if (![self loadCentralDirectory:error]) {
                 return NO;
             }
             
-            NSMutableDictionary *dic = [NSMutableDictionary dictionary];
-            
-            UZKLogInfo("Reading file info to cache file positions");
-            
-            do {
-                @autoreleasepool {
-                    UZKLogDebug("Reading file info for current file in zip");
-                    UZKFileInfo *info = [self currentFileInZipInfo:error];
-                    
-                    if (!info) {
-                        UZKLogDebug("No info returned. Exiting loop");
-                        return NO;
-                    }
-
-                    UZKLogDebug("Got info for %{public}@", info.filename);
-
-                    unz_file_pos pos;
-                    int err = unzGetFilePos(self.unzFile, &pos);
-                    if (err == UNZ_OK && info.filename) {
-                        NSValue *dictValue = [NSValue valueWithBytes:&pos
-                                                            objCType:@encode(unz_file_pos)];
-                        dic[info.filename.decomposedStringWithCanonicalMapping] = dictValue;
-                    }
-                }
-            } while (unzGoToNextFile (self.unzFile) != UNZ_END_OF_LIST_OF_FILE);
-            
-            self.archiveContents = [dic copy];
             break;
         }
         case UZKFileModeCreate:
@@ -2260,6 +4054,18 @@ compressionMethod:(UZKCompressionMethod)method
                            detail:detail];
                 return NO;
             }
+            
+            int encryptionErr = zipSetAESEncryption(self.zipFile, (int)self.encryptionMethod);
+            if (encryptionErr != ZIP_OK) {
+                NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error setting the encryption method for write (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                                    encryptionErr];
+                UZKLogError("UZKErrorCodeFileOpenForWrite: %{public}@", detail);
+                zipClose(self.zipFile, NULL);
+                self.zipFile = NULL;
+                [self assignError:error code:UZKErrorCodeFileOpenForWrite
+                           detail:detail];
+                return NO;
+            }
             break;
             
         case UZKFileModeUnassigned:
@@ -2297,6 +4103,17 @@ compressionMethod:(UZKCompressionMethod)method
                 UZKLogDebug("self.unzFile is nil. File already closed?");
                 break;
             }
+            if ([self keepsIdleHandles]) {
+                UZKLogDebug("Keeping file open for the next read...");
+                UZKReadContext *context = [[UZKReadContext alloc] init];
+                context.handle = self.unzFile;
+                context.centralDirectory = self.centralDirectory;
+                self.unzFile = NULL;
+                
+                [self enqueueIdleReadContext:context];
+                break;
+            }
+            
             UZKLogDebug("Closing file in read mode...");
             err = unzClose(self.unzFile);
             if (err != UNZ_OK) {
@@ -2319,7 +4136,28 @@ compressionMethod:(UZKCompressionMethod)method
             }
             cmt = self.comment.UTF8String;
             UZKLogDebug("Closing file in %{public}s mode with comment %{public}s...", logverb, cmt);
-            err = zipClose(self.zipFile, cmt);
+            ZPOS64_T archiveSize = 0;
+            err = zipClose2(self.zipFile, cmt, &archiveSize);
+            self.centralDirectory = nil;
+            
+            // Dropping entries from the central directory can leave the end of the old one past the new end
+            if (err == ZIP_OK) {
+                const char *path = self.filename.fileSystemRepresentation;
+                struct stat archiveStat;
+                
+                if (stat(path, &archiveStat) != 0) {
+                    UZKLogError("Failed to get the size of the archive after closing it (%d)", errno);
+                    err = ZIP_ERRNO;
+                } else if ((ZPOS64_T)archiveStat.st_size > archiveSize) {
+                    UZKLogDebug("Truncating archive from %lld to %llu bytes", (long long)archiveStat.st_size, archiveSize);
+                    
+                    if (truncate(path, (off_t)archiveSize) != 0) {
+                        UZKLogError("Failed to truncate archive to %llu bytes (%d)", archiveSize, errno);
+                        err = ZIP_ERRNO;
+                    }
+                }
+            }
+            
             if (err != ZIP_OK) {
                 NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error closing file in archive in write mode %lu (%d)", @"UnzipKit", _resources, @"Detailed error string"),
                                     self.mode, err];
@@ -2342,6 +4180,51 @@ compressionMethod:(UZKCompressionMethod)method
     return closeSucceeded;
 }
 
+- (unzFile)openUnzipHandle:(NSString *)path
+{
+    return [self openUnzipHandle:path
+                sharedDescriptor:NULL];
+}
+
+/**
+ *  @param descriptor If not NULL, an open descriptor of the archive, which the handle reads from using pread
+ *                    instead of opening the file again. Several handles can share the same descriptor, and
+ *                    read from it at the same time. Ignored for memory-mapped archives
+ */
+- (unzFile)openUnzipHandle:(NSString *)path sharedDescriptor:(const int *)descriptor
+{
+    UZKCreateActivity("openUnzipHandle");
+    
+    unzFile handle = NULL;
+    
+    if (self.useMemoryMappedIO) {
+        UZKLogDebug("Opening memory-mapped archive");
+        zlib_filefunc64_map_def fileFunctions;
+        fill_mmap64_filefunc(&fileFunctions);
+        handle = unzOpen2_64_map(path.UTF8String, &fileFunctions);
+    } else if (descriptor) {
+        UZKLogDebug("Opening archive from shared descriptor %d", *descriptor);
+        zlib_filefunc64_def fileFunctions;
+        fill_pread64_shared_filefunc(&fileFunctions, descriptor);
+        handle = unzOpen2_64(path.UTF8String, &fileFunctions);
+    } else {
+        handle = unzOpen(path.UTF8String);
+    }
+    
+    if (handle && self.readBufferSize > 0) {
+        UZKLogDebug("Setting read buffer size to %lu bytes", (unsigned long)self.readBufferSize);
+        unzSetReadBufferSize(handle, (uInt)MIN(self.readBufferSize, (NSUInteger)UINT_MAX));
+    }
+    
+#ifdef HAVE_AES
+    if (handle) {
+        unzSetDeriveKeysFunc(handle, UZKDeriveAESKeys, (__bridge void *)self.derivedKeyCache);
+    }
+#endif
+    
+    return handle;
+}
+
 
 
 #pragma mark - Zip File Navigation
@@ -2368,13 +4251,71 @@ compressionMethod:(UZKCompressionMethod)method
     return [UZKFileInfo fileInfo:&file_info filename:filename];
 }
 
+- (BOOL)loadCentralDirectory:(NSError * __autoreleasing*)error {
+    return [self loadCentralDirectoryFromHandle:self.unzFile
+                                          error:error];
+}
+
+- (BOOL)loadCentralDirectoryFromHandle:(unzFile)handle error:(NSError * __autoreleasing*)error {
+    UZKCreateActivity("loadCentralDirectory");
+    
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:self.filename
+                                                                                error:nil];
+    unsigned long long archiveSize = attributes.fileSize;
+    NSDate *modificationDate = attributes.fileModificationDate;
+    
+    if (attributes && [self.centralDirectory matchesArchiveSize:archiveSize
+                                               modificationDate:modificationDate])
+    {
+        UZKLogDebug("Archive unchanged since its central directory was indexed. Reusing index");
+        return YES;
+    }
+    
+    self.centralDirectory = nil;
+    
+    unz_global_info64 gi;
+    int err = unzGetGlobalInfo64(handle, &gi);
+    if (err != UNZ_OK) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting global info (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            err];
+        UZKLogError("UZKErrorCodeArchiveNotFound: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeArchiveNotFound
+                          detail:detail];
+    }
+    
+    UZKCentralDirectoryIndex *index = [[UZKCentralDirectoryIndex alloc] initWithArchiveSize:archiveSize
+                                                                           modificationDate:modificationDate
+                                                                                   capacity:(NSUInteger)gi.number_entry];
+    
+    UZKLogInfo("Reading central directory to index it");
+    err = unzReadCentralDirectory64(handle, UZKAddCentralDirectoryEntryToIndex, (__bridge void *)index);
+    if (err != UNZ_OK) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error reading the archive's central directory (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            err];
+        UZKLogError("UZKErrorCodeBadZipFile: %{public}@", detail);
+        return [self assignError:error code:UZKErrorCodeBadZipFile
+                          detail:detail];
+    }
+    
+    UZKLogDebug("Indexed %lu entries", (unsigned long)index.count);
+    self.centralDirectory = index;
+    return YES;
+}
+
+- (BOOL)centralDirectoryMatchesArchive {
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:self.filename
+                                                                                error:nil];
+    return attributes && [self.centralDirectory matchesArchiveSize:attributes.fileSize
+                                                  modificationDate:attributes.fileModificationDate];
+}
+
 - (BOOL)locateFileInZip:(NSString *)fileNameInZip error:(NSError * __autoreleasing*)error {
     UZKCreateActivity("locateFileInZip");
     
     UZKLogDebug("Looking up file position");
-    NSValue *filePosValue = self.archiveContents[fileNameInZip.decomposedStringWithCanonicalMapping];
+    NSUInteger index = [self.centralDirectory indexOfFilename:fileNameInZip];
     
-    if (!filePosValue) {
+    if (index == NSNotFound) {
         NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"No file position found for '%@'", @"UnzipKit", _resources, @"Detailed error string"),
                             fileNameInZip];
         UZKLogError("UZKErrorCodeFileNotFoundInArchive: %{public}@", detail);
@@ -2382,11 +4323,10 @@ compressionMethod:(UZKCompressionMethod)method
                           detail:detail];
     }
     
-    unz_file_pos pos;
-    [filePosValue getValue:&pos];
+    unz64_file_pos pos = [self.centralDirectory positionAtIndex:index];
     
     UZKLogDebug("Going to file position");
-    int err = unzGoToFilePos(self.unzFile, &pos);
+    int err = unzGoToFilePos64(self.unzFile, &pos);
     
     if (err == UNZ_END_OF_LIST_OF_FILE) {
         NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"File '%@' not found in archive", @"UnzipKit", _resources, @"Detailed error string"),
@@ -2445,6 +4385,10 @@ compressionMethod:(UZKCompressionMethod)method
     
     UZKLogDebug("Opening file...");
     err = unzOpenCurrentFilePassword(self.unzFile, passwordStr);
+    if (err == UNZ_BADPASSWORD) {
+        err = UZKErrorCodeInvalidPassword;
+    }
+    
     if (err != UNZ_OK) {
         NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error opening archive (%d)", @"UnzipKit", _resources, @"Detailed error string"),
                             err];
@@ -2483,6 +4427,144 @@ compressionMethod:(UZKCompressionMethod)method
     return data;
 }
 
+/**
+ *  Reads the whole current file into memory, with a buffer allocated up front at its recorded size
+ *
+ *  @return The file's data, or nil if it couldn't be read or the progress was cancelled
+ */
+- (NSMutableData *)readCurrentFile:(NSString *)filePath
+                          fileInfo:(const unz_file_info64 *)fileInfo
+                          progress:(NSProgress *)progress
+                     progressBlock:(void (^)(CGFloat))progressBlock
+                             error:(NSError * __autoreleasing*)error
+{
+    UZKCreateActivity("readCurrentFile");
+    
+    NSUInteger chunkSize = 1024 * 256; // 256 kb, arbitrary
+    
+    // The output buffer is allocated up front at the size recorded in the header, so check it first.
+    // Stored data is never larger than its compressed size, and Deflate can't expand data by more than
+    // about 1032:1, so anything larger means the header is lying
+    ZPOS64_T maxPlausibleSize = ULLONG_MAX;
+    if (fileInfo->compression_method == 0) {
+        maxPlausibleSize = fileInfo->compressed_size;
+    } else if (fileInfo->compression_method == Z_DEFLATED && fileInfo->compressed_size < ULLONG_MAX / 1032) {
+        maxPlausibleSize = fileInfo->compressed_size * 1032;
+    }
+    
+    if (fileInfo->uncompressed_size > maxPlausibleSize) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"The uncompressed size recorded for '%@' (%llu bytes) is impossible for its compressed size (%llu bytes)", @"UnzipKit", _resources, @"Detailed error string"),
+                            filePath, fileInfo->uncompressed_size, fileInfo->compressed_size];
+        UZKLogError("UZKErrorCodeBadZipFile: %{public}@", detail);
+        [self assignError:error code:UZKErrorCodeBadZipFile
+                   detail:detail];
+        return nil;
+    }
+    
+    UZKLogDebug("Allocating %{iec-bytes}llu (%llu bytes) for extracted data", fileInfo->uncompressed_size, fileInfo->uncompressed_size);
+    NSMutableData *result = [NSMutableData dataWithLength:(NSUInteger)fileInfo->uncompressed_size];
+    
+    if (!result) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Unable to allocate %llu bytes to extract '%@'", @"UnzipKit", _resources, @"Detailed error string"),
+                            fileInfo->uncompressed_size, filePath];
+        UZKLogError("UZKErrorCodeFileRead: %{public}@", detail);
+        [self assignError:error code:UZKErrorCodeFileRead
+                   detail:detail];
+        return nil;
+    }
+    
+    UZKLogInfo("Opening file");
+    if (![self openFile:error]) {
+        UZKLogError("Failed to open file %{public}@ in archive", filePath);
+        return nil;
+    }
+    
+    NSUInteger bytesDecompressed = 0;
+    
+    while (bytesDecompressed < result.length) {
+        if (progress.isCancelled) {
+            UZKLogInfo("Data extraction cancelled");
+            // Close it, so the handle isn't left with a file open if it goes back to the idle pool
+            unzCloseCurrentFile(self.unzFile);
+            return nil;
+        }
+        
+        unsigned bytesToRead = (unsigned)MIN(chunkSize, result.length - bytesDecompressed);
+        int bytesRead = unzReadCurrentFile(self.unzFile, (Bytef *)result.mutableBytes + bytesDecompressed, bytesToRead);
+        
+        if (bytesRead < 0) {
+            NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to read file %@ in zip", @"UnzipKit", _resources, @"Detailed error string"),
+                                filePath];
+            UZKLogError("Error reading data (code %d): %{public}@", bytesRead, detail);
+            unzCloseCurrentFile(self.unzFile);
+            [self assignError:error code:bytesRead
+                       detail:detail];
+            return nil;
+        }
+        else if (bytesRead == 0) {
+            UZKLogInfo("File data ended before its recorded size. Truncating result");
+            break;
+        }
+        
+        bytesDecompressed += (NSUInteger)bytesRead;
+        UZKLogDebug("Decompressed %{iec-bytes}lu (%lu bytes) so far", (unsigned long)bytesDecompressed, (unsigned long)bytesDecompressed);
+        
+        if (progressBlock) {
+            progressBlock(bytesDecompressed / (CGFloat)fileInfo->uncompressed_size);
+        }
+        
+        progress.completedUnitCount += bytesRead;
+    }
+    
+    result.length = bytesDecompressed;
+    
+    UZKLogInfo("Closing file...");
+    int err = unzCloseCurrentFile(self.unzFile);
+    if (err != UNZ_OK) {
+        if (err == UZKErrorCodeCRCError) {
+            err = UZKErrorCodeInvalidPassword;
+        }
+        
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error closing '%@' after extracting it (%d)", @"UnzipKit", _resources, @"Detailed error string"),
+                            filePath, err];
+        UZKLogError("Error closing file (code %d): %{public}@", err, detail);
+        [self assignError:error code:err
+                   detail:detail];
+        return nil;
+    }
+    
+    return result;
+}
+
+- (NSData *)archiveMapping:(NSError * __autoreleasing*)error {
+    UZKCreateActivity("archiveMapping");
+    
+    NSData *mapping = self.centralDirectory.archiveMapping;
+    if (mapping) {
+        UZKLogDebug("Reusing existing mapping of the archive");
+        return mapping;
+    }
+    
+    UZKLogDebug("Mapping archive into memory");
+    NSError *mapError = nil;
+    mapping = [NSData dataWithContentsOfFile:self.filename
+                                     options:NSDataReadingMappedAlways
+                                       error:&mapError];
+    
+    if (!mapping) {
+        NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Failed to map the archive into memory: %@", @"UnzipKit", _resources, @"Detailed error string"),
+                            mapError.localizedDescription];
+        UZKLogError("UZKErrorCodeArchiveNotFound: %{public}@", detail);
+        [self assignError:error code:UZKErrorCodeArchiveNotFound
+                   detail:detail
+                underlyer:mapError];
+        return nil;
+    }
+    
+    self.centralDirectory.archiveMapping = mapping;
+    return mapping;
+}
+
 - (NSString *)readGlobalComment {
     UZKCreateActivity("readGlobalComment");
     
@@ -2508,8 +4590,6 @@ compressionMethod:(UZKCompressionMethod)method
             NSString *detail = [NSString localizedStringWithFormat:NSLocalizedStringFromTableInBundle(@"Error getting global info of archive during comment read: %d", @"UnzipKit", _resources, @"Detailed error string"),
                                 err];
             UZKLogError("UZKErrorCodeReadComment: %{public}@", detail);
-            UZKLogDebug("Closing archive...");
-            unzClose(welf.unzFile);
             
             [welf assignError:innerError code:UZKErrorCodeReadComment detail:detail];
             return;
@@ -2524,8 +4604,6 @@ compressionMethod:(UZKCompressionMethod)method
             if ((global_comment == NULL) && (global_info.size_comment != 0)) {
                 NSString *detail = NSLocalizedStringFromTableInBundle(@"Error allocating the global comment during comment read", @"UnzipKit", _resources, @"Detailed error string");
                 UZKLogError("UZKErrorCodeReadComment: %{public}@", detail);
-                UZKLogDebug("Closing archive...");
-                unzClose(welf.unzFile);
                 
                 [welf assignError:innerError code:UZKErrorCodeReadComment detail:detail];
                 return;
@@ -2535,8 +4613,7 @@ compressionMethod:(UZKCompressionMethod)method
             if ((unsigned int)unzGetGlobalComment(welf.unzFile, global_comment, global_info.size_comment + 1) != global_info.size_comment) {
                 NSString *detail = NSLocalizedStringFromTableInBundle(@"Error reading the comment (readGlobalComment)", @"UnzipKit", _resources, @"Detailed error string");
                 UZKLogError("UZKErrorCodeReadComment: %{public}@", detail);
-                UZKLogDebug("Closing archive and freeing global_comment...");
-                unzClose(welf.unzFile);
+                UZKLogDebug("Freeing global_comment...");
                 free(global_comment);
                 
                 [welf assignError:innerError code:UZKErrorCodeReadComment detail:@"Error reading global comment (unzGetGlobalComment)"];
@@ -2689,6 +4766,10 @@ compressionMethod:(UZKCompressionMethod)method
             errorName = NSLocalizedStringFromTableInBundle(@"The archive was compressed with the Deflate64 method, which isn't supported", @"UnzipKit", _resources, @"UZKErrorCodeDeflate64");
             break;
             
+        case UZKErrorCodeDeletionJournalDamaged:
+            errorName = NSLocalizedStringFromTableInBundle(@"The journal of an interrupted deletion can't be used to finish it", @"UnzipKit", _resources, @"UZKErrorCodeDeletionJournalDamaged");
+            break;
+            
         default:
             errorName = [NSString localizedStringWithFormat:
                          NSLocalizedStringFromTableInBundle(@"Unknown error code: %ld", @"UnzipKit", _resources, @"UnknownErrorCode"), errorCode];
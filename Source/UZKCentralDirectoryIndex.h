@@ -0,0 +1,135 @@
+//
+//  UZKCentralDirectoryIndex.h
+//  UnzipKit
+//
+//
+
+@import Foundation;
+
+#import "unzip.h"
+
+@class UZKFileInfo;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  A parsed copy of an archive's central directory. The header data for each entry is kept in a
+ *  flat array, so it can be reused across open/close cycles of the archive for as long as the file
+ *  on disk keeps the size and modification date it had when the index was built
+ */
+@interface UZKCentralDirectoryIndex : NSObject
+
+/**
+ *  The number of entries in the index
+ */
+@property (readonly) NSUInteger count;
+
+/**
+ *  The size of the archive file the index was built from
+ */
+@property (readonly) unsigned long long archiveSize;
+
+/**
+ *  The modification date of the archive file the index was built from
+ */
+@property (readonly, strong, nullable) NSDate *archiveModificationDate;
+
+/**
+ *  A read-only mapping of the archive file, created on demand by the archive that owns the index.
+ *  It's discarded along with the index once the file on disk changes
+ */
+@property (strong, nullable) NSData *archiveMapping;
+
+
+/**
+ *  Creates an empty index for an archive in the given state
+ *
+ *  @param size     The size of the archive file, in bytes
+ *  @param date     The modification date of the archive file
+ *  @param capacity The number of entries expected in the archive
+ *
+ *  @return An empty index, ready to have entries added to it
+ */
+- (instancetype)initWithArchiveSize:(unsigned long long)size
+                   modificationDate:(nullable NSDate *)date
+                           capacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ *  Adds an entry to the end of the index. If an entry with the same (normalized) name was already
+ *  added, lookups by name return the new one. Directories are looked up without their trailing slash
+ *
+ *  @param fileInfo          The header data read from the central directory
+ *  @param filename          The decoded name of the entry
+ *  @param position          The position of the entry in the central directory
+ *  @param localHeaderOffset The offset of the entry's local header, relative to the start of the archive
+ */
+- (void)addEntry:(const unz_file_info64 *)fileInfo
+        filename:(NSString *)filename
+        position:(unz64_file_pos)position
+localHeaderOffset:(ZPOS64_T)localHeaderOffset;
+
+/**
+ *  Checks whether the index still describes the archive on disk
+ *
+ *  @param size The current size of the archive file
+ *  @param date The current modification date of the archive file
+ *
+ *  @return YES if the index can be reused, NO if it needs to be rebuilt
+ */
+- (BOOL)matchesArchiveSize:(unsigned long long)size
+          modificationDate:(nullable NSDate *)date;
+
+/**
+ *  Looks up an entry by name, using the same Unicode normalization as the rest of UnzipKit
+ *
+ *  @param filename The name of the entry in the archive
+ *
+ *  @return The index of the entry, or NSNotFound if there's no entry with that name
+ */
+- (NSUInteger)indexOfFilename:(NSString *)filename;
+
+/**
+ *  @param index The index of an entry
+ *
+ *  @return The position of the entry in the central directory, to be passed to unzGoToFilePos64
+ */
+- (unz64_file_pos)positionAtIndex:(NSUInteger)index;
+
+/**
+ *  @param index The index of an entry
+ *
+ *  @return The offset of the entry's local header, which is where its data starts in the archive
+ */
+- (ZPOS64_T)localHeaderOffsetAtIndex:(NSUInteger)index;
+
+/**
+ *  @param index The index of an entry
+ *
+ *  @return The header data of the entry. The pointer is valid until another entry is added
+ */
+- (const unz_file_info64 *)headerAtIndex:(NSUInteger)index;
+
+/**
+ *  @param index The index of an entry
+ *
+ *  @return The name of the entry, as stored in the archive
+ */
+- (NSString *)filenameAtIndex:(NSUInteger)index;
+
+/**
+ *  @param index The index of an entry
+ *
+ *  @return A new UZKFileInfo instance describing the entry
+ */
+- (UZKFileInfo *)fileInfoAtIndex:(NSUInteger)index;
+
+/**
+ *  @return UZKFileInfo instances for every entry, in central directory order
+ */
+- (NSArray<UZKFileInfo*> *)allFileInfo;
+
+@end
+
+NS_ASSUME_NONNULL_END
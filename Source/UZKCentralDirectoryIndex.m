@@ -0,0 +1,144 @@
+//
+//  UZKCentralDirectoryIndex.m
+//  UnzipKit
+//
+//
+
+#import "UZKCentralDirectoryIndex.h"
+
+#import "UZKFileInfo.h"
+#import "UZKFileInfo_Private.h"
+
+
+typedef struct {
+    unz_file_info64 header;
+    unz64_file_pos position;
+    ZPOS64_T localHeaderOffset;
+} UZKCentralDirectoryEntry;
+
+
+@interface UZKCentralDirectoryIndex ()
+
+@property (strong) NSMutableData *entries;
+@property (strong) NSMutableArray<NSString*> *filenames;
+@property (strong) NSMutableDictionary<NSString*, NSNumber*> *indexesByName;
+
+@end
+
+
+@implementation UZKCentralDirectoryIndex
+
+
+#pragma mark - Initialization
+
+
+- (instancetype)initWithArchiveSize:(unsigned long long)size
+                   modificationDate:(NSDate *)date
+                           capacity:(NSUInteger)capacity
+{
+    if ((self = [super init])) {
+        _archiveSize = size;
+        _archiveModificationDate = date;
+        _entries = [NSMutableData dataWithCapacity:capacity * sizeof(UZKCentralDirectoryEntry)];
+        _filenames = [NSMutableArray arrayWithCapacity:capacity];
+        _indexesByName = [NSMutableDictionary dictionaryWithCapacity:capacity];
+    }
+    return self;
+}
+
+
+
+#pragma mark - Properties
+
+
+- (NSUInteger)count {
+    return self.filenames.count;
+}
+
+
+
+#pragma mark - Public Methods
+
+
+- (void)addEntry:(const unz_file_info64 *)fileInfo
+        filename:(NSString *)filename
+        position:(unz64_file_pos)position
+localHeaderOffset:(ZPOS64_T)localHeaderOffset
+{
+    UZKCentralDirectoryEntry entry;
+    entry.header = *fileInfo;
+    entry.position = position;
+    entry.localHeaderOffset = localHeaderOffset;
+
+    NSUInteger index = self.filenames.count;
+    [self.entries appendBytes:&entry length:sizeof(entry)];
+    [self.filenames addObject:filename];
+
+    // Directories are looked up without their trailing slash, matching UZKFileInfo.filename
+    NSString *key = [filename hasSuffix:@"/"] ? [filename substringToIndex:filename.length - 1] : filename;
+    self.indexesByName[key.decomposedStringWithCanonicalMapping] = @(index);
+}
+
+- (BOOL)matchesArchiveSize:(unsigned long long)size
+          modificationDate:(NSDate *)date
+{
+    if (size != self.archiveSize) {
+        return NO;
+    }
+
+    if (!date || !self.archiveModificationDate) {
+        return date == self.archiveModificationDate;
+    }
+
+    return [date isEqualToDate:(NSDate * _Nonnull)self.archiveModificationDate];
+}
+
+- (NSUInteger)indexOfFilename:(NSString *)filename {
+    NSNumber *index = self.indexesByName[filename.decomposedStringWithCanonicalMapping];
+    return index ? index.unsignedIntegerValue : NSNotFound;
+}
+
+- (unz64_file_pos)positionAtIndex:(NSUInteger)index {
+    return [self entryAtIndex:index]->position;
+}
+
+- (ZPOS64_T)localHeaderOffsetAtIndex:(NSUInteger)index {
+    return [self entryAtIndex:index]->localHeaderOffset;
+}
+
+- (const unz_file_info64 *)headerAtIndex:(NSUInteger)index {
+    return &[self entryAtIndex:index]->header;
+}
+
+- (NSString *)filenameAtIndex:(NSUInteger)index {
+    return self.filenames[index];
+}
+
+- (UZKFileInfo *)fileInfoAtIndex:(NSUInteger)index {
+    unz_file_info64 header = [self entryAtIndex:index]->header;
+    return [UZKFileInfo fileInfo:&header filename:self.filenames[index]];
+}
+
+- (NSArray<UZKFileInfo*> *)allFileInfo {
+    NSUInteger count = self.count;
+    NSMutableArray<UZKFileInfo*> *result = [NSMutableArray arrayWithCapacity:count];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        [result addObject:[self fileInfoAtIndex:i]];
+    }
+
+    return [result copy];
+}
+
+
+
+#pragma mark - Private Methods
+
+
+- (const UZKCentralDirectoryEntry *)entryAtIndex:(NSUInteger)index {
+    NSAssert(index < self.count, @"Central directory index %lu out of bounds (%lu entries)", (unsigned long)index, (unsigned long)self.count);
+    const UZKCentralDirectoryEntry *entries = self.entries.bytes;
+    return &entries[index];
+}
+
+@end
@@ -0,0 +1,62 @@
+//
+//  UZKInPlaceCompactor.h
+//  UnzipKit
+//
+//
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Removes files from an archive without making a second copy of it. The entries that are kept slide
+ *  down over the space the removed ones took up, then a new central directory is written after them and
+ *  the file is truncated.
+ *
+ *  Before anything in the archive is overwritten, the plan (every move, and the new central directory) is
+ *  saved to a journal file, and after each chunk is moved, the progress is recorded in it. Where a chunk's
+ *  destination overlaps its own source, the chunk is saved to the journal before it's written. If the
+ *  process is interrupted, +recoverArchiveAtPath:journalPath: finishes the job from where it left off
+ *
+ *  The journal is written in full, including room for the largest chunk it may need to save, before the
+ *  archive is touched, and nothing written after that needs any more space. If the volume is full, the
+ *  compaction fails with ENOSPC and no journal is left behind
+ */
+@interface UZKInPlaceCompactor : NSObject
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ *  Compacts an archive, keeping only the given files
+ *
+ *  @param path          The archive to compact. Nothing else may have it open
+ *  @param recordOffsets The offsets in the archive of the central directory records of the files to keep,
+ *                       in central directory order
+ *  @param comment       The archive's global comment, or nil if it has none
+ *  @param journalPath   Where to write the journal. It should be on the same volume as the archive, in a
+ *                       place where it will be found again after a crash
+ *
+ *  @return 0 on success, or an errno value. EILSEQ means the archive's structure couldn't be followed,
+ *          EINVAL that its entries overlap, and ENOSPC that there wasn't room for the journal. In each
+ *          case, the archive is left unchanged
+ */
++ (int)compactArchiveAtPath:(NSString *)path
+keepingCentralDirectoryRecordsAt:(NSArray<NSNumber*> *)recordOffsets
+              globalComment:(nullable NSData *)comment
+                journalPath:(NSString *)journalPath;
+
+/**
+ *  Finishes compacting an archive after an interruption, using the journal left behind. The journal is
+ *  deleted when done
+ *
+ *  @param path        The archive that was being compacted
+ *  @param journalPath The journal written by +compactArchiveAtPath:keepingCentralDirectoryRecordsAt:globalComment:journalPath:
+ *
+ *  @return 0 on success, ENOENT if there's no journal, or another errno value. EILSEQ means the journal is
+ *          damaged or doesn't belong to the archive, and both are left as they were
+ */
++ (int)recoverArchiveAtPath:(NSString *)path journalPath:(NSString *)journalPath;
+
+@end
+
+NS_ASSUME_NONNULL_END
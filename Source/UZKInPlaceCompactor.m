@@ -0,0 +1,751 @@
+//
+//  UZKInPlaceCompactor.m
+//  UnzipKit
+//
+//
+
+#import "UZKInPlaceCompactor_Private.h"
+#import "crc32fast.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+#import <zlib.h>
+
+
+static const NSUInteger UZKCompactionChunkSize = 4 * 1024 * 1024;
+
+static const uint32_t UZKLocalHeaderSignature = 0x04034b50;
+static const uint32_t UZKCentralHeaderSignature = 0x02014b50;
+static const uint32_t UZKDataDescriptorSignature = 0x08074b50;
+static const uint32_t UZKZip64EndSignature = 0x06064b50;
+static const uint32_t UZKZip64LocatorSignature = 0x07064b50;
+static const uint32_t UZKEndSignature = 0x06054b50;
+
+static const char UZKJournalMagic[8] = {'U', 'Z', 'K', 'J', 'R', 'N', 'L', 1};
+
+
+/**
+ *  The start of the journal. It's followed by the moves, the new central directory, and then room for one
+ *  chunk of stashed data. The first three fields after the magic are the progress, rewritten after each
+ *  chunk, and everything else is written once
+ */
+typedef struct {
+    char magic[8];
+    uint64_t position;     // Bytes moved so far, counting through the moves in order
+    uint64_t stashLength;  // The length of the chunk starting at position saved in the stash, or 0
+    uint32_t stashCRC;
+    uint32_t planCRC;      // Covers the rest of the header, the moves, and the new central directory
+    uint64_t originalSize;
+    uint64_t moveCount;
+    uint64_t tailOffset;
+    uint64_t tailLength;
+} UZKJournalHeader;
+
+typedef struct {
+    uint64_t source;
+    uint64_t destination;
+    uint64_t length;
+} UZKJournalMove;
+
+
+#pragma mark - Byte Helpers
+
+
+static uint16_t UZKRead16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t UZKRead32(const uint8_t *p) { return (uint32_t)UZKRead16(p) | (uint32_t)UZKRead16(p + 2) << 16; }
+static uint64_t UZKRead64(const uint8_t *p) { return (uint64_t)UZKRead32(p) | (uint64_t)UZKRead32(p + 4) << 32; }
+
+static void UZKWrite16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void UZKWrite32(uint8_t *p, uint32_t v) { UZKWrite16(p, (uint16_t)v); UZKWrite16(p + 2, (uint16_t)(v >> 16)); }
+static void UZKWrite64(uint8_t *p, uint64_t v) { UZKWrite32(p, (uint32_t)v); UZKWrite32(p + 4, (uint32_t)(v >> 32)); }
+
+static int UZKReadFully(int fd, void *buffer, size_t length, uint64_t offset)
+{
+    uint8_t *next = buffer;
+    while (length > 0) {
+        ssize_t count = pread(fd, next, length, (off_t)offset);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (count == 0) {
+            return EILSEQ;
+        }
+        next += count;
+        length -= (size_t)count;
+        offset += (uint64_t)count;
+    }
+    return 0;
+}
+
+static int UZKWriteFully(int fd, const void *buffer, size_t length, uint64_t offset)
+{
+    const uint8_t *next = buffer;
+    while (length > 0) {
+        ssize_t count = pwrite(fd, next, length, (off_t)offset);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        next += count;
+        length -= (size_t)count;
+        offset += (uint64_t)count;
+    }
+    return 0;
+}
+
+/**
+ *  Flushes a file all the way to the disk. On Apple platforms, fsync alone leaves it in the drive's cache
+ */
+static int UZKSync(int fd)
+{
+#ifdef F_FULLFSYNC
+    if (fcntl(fd, F_FULLFSYNC) == 0) {
+        return 0;
+    }
+#endif
+    return fsync(fd) == 0 ? 0 : errno;
+}
+
+static int UZKSyncDirectoryOfPath(NSString *path)
+{
+    int fd = open(path.stringByDeletingLastPathComponent.fileSystemRepresentation, O_RDONLY);
+    if (fd < 0) {
+        return errno;
+    }
+    int err = UZKSync(fd);
+    close(fd);
+    return err;
+}
+
+/**
+ *  Finds the Zip64 extended information in an extra field
+ *
+ *  @return The start of the block's data, or NULL if there isn't one. Its length is stored in dataLength
+ */
+static uint8_t *UZKFindZip64Block(uint8_t *extra, NSUInteger extraLength, uint16_t *dataLength)
+{
+    NSUInteger i = 0;
+    while (i + 4 <= extraLength) {
+        uint16_t header = UZKRead16(extra + i);
+        uint16_t length = UZKRead16(extra + i + 2);
+        if (i + 4 + length > extraLength) {
+            return NULL;
+        }
+        if (header == 0x0001) {
+            *dataLength = length;
+            return extra + i + 4;
+        }
+        i += 4 + length;
+    }
+    return NULL;
+}
+
+
+#pragma mark - Entries
+
+
+/**
+ *  A central directory record, and the span of the archive its local entry takes up
+ */
+@interface UZKCompactedRecord : NSObject
+
+@property (strong) NSMutableData *record;
+@property (assign) uint64_t localOffset;
+@property (assign) uint64_t entryLength;
+@property (assign) uint64_t newLocalOffset;
+
+@end
+
+@implementation UZKCompactedRecord
+@end
+
+
+@interface UZKInPlaceCompactor ()
+
+@property (assign) int fd;
+@property (assign) int openError;
+@property (copy) NSString *path;
+@property (copy) NSString *journalPath;
+#ifdef DEBUG
+@property (assign) UZKCompactionInterruption interruption;
+#endif
+
+@property (strong) NSMutableData *buffer;
+
+@end
+
+
+@implementation UZKInPlaceCompactor
+
+
+#pragma mark - Public Methods
+
+
++ (int)compactArchiveAtPath:(NSString *)path
+keepingCentralDirectoryRecordsAt:(NSArray<NSNumber*> *)recordOffsets
+              globalComment:(NSData *)comment
+                journalPath:(NSString *)journalPath
+{
+    UZKInPlaceCompactor *compactor = [[UZKInPlaceCompactor alloc] initWithPath:path journalPath:journalPath];
+    return [compactor runKeepingRecordsAt:recordOffsets comment:comment];
+}
+
+#ifdef DEBUG
++ (int)compactArchiveAtPath:(NSString *)path
+keepingCentralDirectoryRecordsAt:(NSArray<NSNumber*> *)recordOffsets
+              globalComment:(NSData *)comment
+                journalPath:(NSString *)journalPath
+               interruption:(UZKCompactionInterruption)interruption
+{
+    UZKInPlaceCompactor *compactor = [[UZKInPlaceCompactor alloc] initWithPath:path journalPath:journalPath];
+    compactor.interruption = interruption;
+    return [compactor runKeepingRecordsAt:recordOffsets comment:comment];
+}
+#endif
+
++ (int)recoverArchiveAtPath:(NSString *)path journalPath:(NSString *)journalPath
+{
+    if (access(journalPath.fileSystemRepresentation, F_OK) != 0) {
+        return ENOENT;
+    }
+
+    UZKInPlaceCompactor *compactor = [[UZKInPlaceCompactor alloc] initWithPath:path journalPath:journalPath];
+    if (compactor.fd < 0) {
+        return compactor.openError;
+    }
+
+    int err = [compactor recover];
+    close(compactor.fd);
+    return err;
+}
+
+
+#pragma mark - Private Methods
+
+
+- (instancetype)initWithPath:(NSString *)path journalPath:(NSString *)journalPath
+{
+    if ((self = [super init])) {
+        _path = [path copy];
+        _journalPath = [journalPath copy];
+        _fd = open(path.fileSystemRepresentation, O_RDWR);
+        _openError = _fd < 0 ? errno : 0;
+        _buffer = [NSMutableData dataWithLength:UZKCompactionChunkSize];
+    }
+    return self;
+}
+
+- (int)runKeepingRecordsAt:(NSArray<NSNumber*> *)recordOffsets comment:(NSData *)comment
+{
+    if (self.fd < 0) {
+        return self.openError;
+    }
+
+    int err = [self compactKeepingRecordsAt:recordOffsets comment:comment];
+    close(self.fd);
+    return err;
+}
+
+- (int)compactKeepingRecordsAt:(NSArray<NSNumber*> *)recordOffsets comment:(NSData *)comment
+{
+    struct stat info;
+    if (fstat(self.fd, &info) != 0) {
+        return errno;
+    }
+    uint64_t originalSize = (uint64_t)info.st_size;
+
+    // Read everything needed before anything is changed, so any problem leaves the archive as it was
+
+    NSMutableArray<UZKCompactedRecord*> *records = [NSMutableArray arrayWithCapacity:recordOffsets.count];
+    for (NSNumber *offset in recordOffsets) {
+        UZKCompactedRecord *record = nil;
+        int err = [self readRecordAt:offset.unsignedLongLongValue archiveSize:originalSize record:&record];
+        if (err != 0) {
+            return err;
+        }
+        [records addObject:record];
+    }
+
+    NSArray<UZKCompactedRecord*> *recordsInFileOrder = [records sortedArrayUsingComparator:^NSComparisonResult(UZKCompactedRecord *a, UZKCompactedRecord *b) {
+        return a.localOffset < b.localOffset ? NSOrderedAscending : (a.localOffset > b.localOffset ? NSOrderedDescending : NSOrderedSame);
+    }];
+
+    NSMutableData *moves = [NSMutableData data];
+    uint64_t cursor = 0;
+    uint64_t previousEnd = 0;
+
+    for (UZKCompactedRecord *record in recordsInFileOrder) {
+        if (record.localOffset < previousEnd) {
+            return EINVAL;
+        }
+        previousEnd = record.localOffset + record.entryLength;
+        record.newLocalOffset = cursor;
+
+        if (record.localOffset != cursor) {
+            // Entries that move together are merged into a single move
+            UZKJournalMove *last = moves.length > 0 ? (UZKJournalMove *)moves.mutableBytes + moves.length / sizeof(UZKJournalMove) - 1 : NULL;
+            if (last && last->source + last->length == record.localOffset && last->source - last->destination == record.localOffset - cursor) {
+                last->length += record.entryLength;
+            } else {
+                UZKJournalMove move = {record.localOffset, cursor, record.entryLength};
+                [moves appendBytes:&move length:sizeof(move)];
+            }
+        }
+
+        cursor += record.entryLength;
+    }
+
+    NSData *tail = [self centralDirectoryForRecords:records offset:cursor comment:comment];
+    if (!tail) {
+        return EILSEQ;
+    }
+
+    // Chunks are only stashed where they overlap their own source, so there's only room kept for the largest
+    uint64_t stashCapacity = 0;
+    const UZKJournalMove *move = moves.bytes;
+    for (NSUInteger i = 0; i < moves.length / sizeof(UZKJournalMove); i++) {
+        uint64_t largestChunk = MIN(move[i].length, (uint64_t)self.buffer.length);
+        if (largestChunk > move[i].source - move[i].destination) {
+            stashCapacity = MAX(stashCapacity, largestChunk);
+        }
+    }
+
+    int err = [self writeJournalWithMoves:moves tail:tail tailOffset:cursor originalSize:originalSize stashCapacity:stashCapacity];
+    if (err != 0) {
+        return err;
+    }
+
+    return [self recover];
+}
+
+/**
+ *  Reads a central directory record, along with the local header it points to, to find the full span of
+ *  the entry in the archive
+ */
+- (int)readRecordAt:(uint64_t)offset archiveSize:(uint64_t)archiveSize record:(UZKCompactedRecord * __autoreleasing*)result
+{
+    uint8_t fixed[46];
+    int err = UZKReadFully(self.fd, fixed, sizeof(fixed), offset);
+    if (err != 0) {
+        return err;
+    }
+    if (UZKRead32(fixed) != UZKCentralHeaderSignature) {
+        return EILSEQ;
+    }
+
+    uint16_t filenameLength = UZKRead16(fixed + 28);
+    uint16_t extraLength = UZKRead16(fixed + 30);
+    uint16_t commentLength = UZKRead16(fixed + 32);
+
+    NSMutableData *recordData = [NSMutableData dataWithLength:sizeof(fixed) + filenameLength + extraLength + commentLength];
+    err = UZKReadFully(self.fd, recordData.mutableBytes, recordData.length, offset);
+    if (err != 0) {
+        return err;
+    }
+
+    uint8_t *bytes = recordData.mutableBytes;
+    uint16_t flags = UZKRead16(bytes + 8);
+    uint64_t compressedSize = UZKRead32(bytes + 20);
+    uint64_t uncompressedSize = UZKRead32(bytes + 24);
+    uint64_t localOffset = UZKRead32(bytes + 42);
+
+    if (compressedSize == 0xffffffff || uncompressedSize == 0xffffffff || localOffset == 0xffffffff) {
+        uint16_t zip64Length = 0;
+        uint8_t *zip64 = UZKFindZip64Block(bytes + 46 + filenameLength, extraLength, &zip64Length);
+        if (!zip64) {
+            return EILSEQ;
+        }
+
+        uint8_t *end = zip64 + zip64Length;
+        if (uncompressedSize == 0xffffffff) {
+            if (zip64 + 8 > end) return EILSEQ;
+            uncompressedSize = UZKRead64(zip64);
+            zip64 += 8;
+        }
+        if (compressedSize == 0xffffffff) {
+            if (zip64 + 8 > end) return EILSEQ;
+            compressedSize = UZKRead64(zip64);
+            zip64 += 8;
+        }
+        if (localOffset == 0xffffffff) {
+            if (zip64 + 8 > end) return EILSEQ;
+            localOffset = UZKRead64(zip64);
+        }
+    }
+
+    uint8_t local[30];
+    err = UZKReadFully(self.fd, local, sizeof(local), localOffset);
+    if (err != 0) {
+        return err;
+    }
+    if (UZKRead32(local) != UZKLocalHeaderSignature) {
+        return EILSEQ;
+    }
+
+    uint16_t localFilenameLength = UZKRead16(local + 26);
+    uint16_t localExtraLength = UZKRead16(local + 28);
+    uint64_t entryLength = sizeof(local) + localFilenameLength + localExtraLength + compressedSize;
+
+    // The sizes follow the data when bit 3 is set, and are 8 bytes each if the local header has Zip64 info
+    if (flags & 0x08) {
+        NSMutableData *localExtra = [NSMutableData dataWithLength:localExtraLength];
+        err = UZKReadFully(self.fd, localExtra.mutableBytes, localExtraLength, localOffset + sizeof(local) + localFilenameLength);
+        if (err != 0) {
+            return err;
+        }
+
+        uint16_t unused = 0;
+        BOOL zip64 = UZKFindZip64Block(localExtra.mutableBytes, localExtraLength, &unused) != NULL;
+
+        uint8_t signature[4];
+        err = UZKReadFully(self.fd, signature, sizeof(signature), localOffset + entryLength);
+        if (err != 0) {
+            return err;
+        }
+
+        entryLength += (UZKRead32(signature) == UZKDataDescriptorSignature ? 4 : 0) + 4 + (zip64 ? 16 : 8);
+    }
+
+    if (localOffset + entryLength > archiveSize) {
+        return EILSEQ;
+    }
+
+    UZKCompactedRecord *record = [[UZKCompactedRecord alloc] init];
+    record.record = recordData;
+    record.localOffset = localOffset;
+    record.entryLength = entryLength;
+    *result = record;
+    return 0;
+}
+
+/**
+ *  Builds the new central directory and end records, pointing each record at its entry's new offset
+ */
+- (NSData *)centralDirectoryForRecords:(NSArray<UZKCompactedRecord*> *)records offset:(uint64_t)offset comment:(NSData *)comment
+{
+    NSMutableData *tail = [NSMutableData data];
+
+    for (UZKCompactedRecord *compacted in records) {
+        uint8_t *bytes = compacted.record.mutableBytes;
+
+        // Offsets only ever shrink, so a record never needs to grow. Zip64 offsets stay in Zip64 form
+        if (UZKRead32(bytes + 42) != 0xffffffff) {
+            UZKWrite32(bytes + 42, (uint32_t)compacted.newLocalOffset);
+        } else {
+            uint16_t zip64Length = 0;
+            uint8_t *zip64 = UZKFindZip64Block(bytes + 46 + UZKRead16(bytes + 28), UZKRead16(bytes + 30), &zip64Length);
+            if (!zip64) {
+                return nil;
+            }
+            zip64 += (UZKRead32(bytes + 24) == 0xffffffff ? 8 : 0) + (UZKRead32(bytes + 20) == 0xffffffff ? 8 : 0);
+            UZKWrite64(zip64, compacted.newLocalOffset);
+        }
+
+        [tail appendData:compacted.record];
+    }
+
+    uint64_t count = records.count;
+    uint64_t size = tail.length;
+    BOOL zip64 = count >= 0xffff || size >= 0xffffffff || offset >= 0xffffffff;
+
+    if (zip64) {
+        uint8_t end64[56] = {0};
+        UZKWrite32(end64, UZKZip64EndSignature);
+        UZKWrite64(end64 + 4, sizeof(end64) - 12);
+        UZKWrite16(end64 + 12, 45);
+        UZKWrite16(end64 + 14, 45);
+        UZKWrite64(end64 + 24, count);
+        UZKWrite64(end64 + 32, count);
+        UZKWrite64(end64 + 40, size);
+        UZKWrite64(end64 + 48, offset);
+
+        uint8_t locator[20] = {0};
+        UZKWrite32(locator, UZKZip64LocatorSignature);
+        UZKWrite64(locator + 8, offset + size);
+        UZKWrite32(locator + 16, 1);
+
+        [tail appendBytes:end64 length:sizeof(end64)];
+        [tail appendBytes:locator length:sizeof(locator)];
+    }
+
+    uint8_t end[22] = {0};
+    UZKWrite32(end, UZKEndSignature);
+    UZKWrite16(end + 8, (uint16_t)MIN(count, 0xffff));
+    UZKWrite16(end + 10, (uint16_t)MIN(count, 0xffff));
+    UZKWrite32(end + 12, zip64 ? 0xffffffff : (uint32_t)size);
+    UZKWrite32(end + 16, zip64 ? 0xffffffff : (uint32_t)offset);
+    UZKWrite16(end + 20, (uint16_t)comment.length);
+
+    [tail appendBytes:end length:sizeof(end)];
+    if (comment) {
+        [tail appendData:comment];
+    }
+
+    return tail;
+}
+
+/**
+ *  Writes the journal beside its final location, then moves it into place, so it's never seen half-written.
+ *  The stash's room is filled in here too, so running out of space can only happen before the archive is
+ *  touched, and never leaves a journal behind
+ */
+- (int)writeJournalWithMoves:(NSData *)moves tail:(NSData *)tail tailOffset:(uint64_t)tailOffset originalSize:(uint64_t)originalSize stashCapacity:(uint64_t)stashCapacity
+{
+    UZKJournalHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, UZKJournalMagic, sizeof(header.magic));
+    header.originalSize = originalSize;
+    header.moveCount = moves.length / sizeof(UZKJournalMove);
+    header.tailOffset = tailOffset;
+    header.tailLength = tail.length;
+    header.planCRC = [UZKInPlaceCompactor planCRCOfHeader:&header moves:moves tail:tail];
+
+    NSMutableData *journal = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+    [journal appendData:moves];
+    [journal appendData:tail];
+
+    NSString *newJournalPath = [self.journalPath stringByAppendingString:@"-new"];
+    int journalFD = open(newJournalPath.fileSystemRepresentation, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (journalFD < 0) {
+        return errno;
+    }
+
+    int err = UZKWriteFully(journalFD, journal.bytes, journal.length, 0);
+
+    // Written out rather than only extended, which would leave a sparse file with no space set aside
+    memset(self.buffer.mutableBytes, 0, self.buffer.length);
+    for (uint64_t reserved = 0; err == 0 && reserved < stashCapacity; ) {
+#ifdef DEBUG
+        if (self.interruption == UZKCompactionInterruptionJournalOutOfSpace) {
+            err = ENOSPC;
+            break;
+        }
+#endif
+
+        uint64_t length = MIN(stashCapacity - reserved, (uint64_t)self.buffer.length);
+        err = UZKWriteFully(journalFD, self.buffer.bytes, (size_t)length, journal.length + reserved);
+        reserved += length;
+    }
+
+    if (err == 0) {
+        err = UZKSync(journalFD);
+    }
+    close(journalFD);
+
+    if (err == 0 && rename(newJournalPath.fileSystemRepresentation, self.journalPath.fileSystemRepresentation) != 0) {
+        err = errno;
+    }
+    if (err == 0) {
+        err = UZKSyncDirectoryOfPath(self.journalPath);
+    }
+    if (err != 0) {
+        unlink(newJournalPath.fileSystemRepresentation);
+    }
+
+    return err;
+}
+
++ (uint32_t)planCRCOfHeader:(const UZKJournalHeader *)header moves:(NSData *)moves tail:(NSData *)tail
+{
+    uLong crc = crc32_fast(0, NULL, 0);
+    crc = crc32_fast(crc, (const Bytef *)&header->originalSize, sizeof(*header) - offsetof(UZKJournalHeader, originalSize));
+    crc = crc32_fast(crc, moves.bytes, moves.length);
+    crc = crc32_fast(crc, tail.bytes, tail.length);
+    return (uint32_t)crc;
+}
+
+/**
+ *  The stash's CRC covers its position too, so if the progress is only partly written, the stash can't be
+ *  mistaken for the chunk at a different position
+ */
++ (uint32_t)stashCRCOfBytes:(const uint8_t *)bytes length:(uint64_t)length position:(uint64_t)position
+{
+    uLong crc = crc32_fast(0, (const Bytef *)&position, sizeof(position));
+    return (uint32_t)crc32_fast(crc, bytes, (size_t)length);
+}
+
+/**
+ *  Carries out the plan in the journal, from the recorded position on, then deletes the journal
+ */
+- (int)recover
+{
+    int journalFD = open(self.journalPath.fileSystemRepresentation, O_RDWR);
+    if (journalFD < 0) {
+        return errno;
+    }
+
+    int err = [self replayJournal:journalFD];
+    close(journalFD);
+
+    if (err == 0 && unlink(self.journalPath.fileSystemRepresentation) != 0) {
+        err = errno;
+    }
+    if (err == 0) {
+        err = UZKSyncDirectoryOfPath(self.journalPath);
+    }
+
+    return err;
+}
+
+- (int)replayJournal:(int)journalFD
+{
+    UZKJournalHeader header;
+    int err = UZKReadFully(journalFD, &header, sizeof(header), 0);
+    if (err != 0) {
+        return err;
+    }
+    if (memcmp(header.magic, UZKJournalMagic, sizeof(header.magic)) != 0 || header.moveCount > SIZE_MAX / sizeof(UZKJournalMove)) {
+        return EILSEQ;
+    }
+
+    NSMutableData *moves = [NSMutableData dataWithLength:(NSUInteger)header.moveCount * sizeof(UZKJournalMove)];
+    NSMutableData *tail = [NSMutableData dataWithLength:(NSUInteger)header.tailLength];
+    if (!moves || !tail) {
+        return ENOMEM;
+    }
+
+    uint64_t movesOffset = sizeof(header);
+    uint64_t tailOffsetInJournal = movesOffset + moves.length;
+    uint64_t stashOffset = tailOffsetInJournal + tail.length;
+
+    if ((err = UZKReadFully(journalFD, moves.mutableBytes, moves.length, movesOffset)) != 0 ||
+        (err = UZKReadFully(journalFD, tail.mutableBytes, tail.length, tailOffsetInJournal)) != 0)
+    {
+        return err;
+    }
+    if (header.planCRC != [UZKInPlaceCompactor planCRCOfHeader:&header moves:moves tail:tail]) {
+        return EILSEQ;
+    }
+
+    // The archive keeps its original size until the very end, when it's truncated to its final size
+    struct stat info;
+    if (fstat(self.fd, &info) != 0) {
+        return errno;
+    }
+    uint64_t finalSize = header.tailOffset + header.tailLength;
+    if ((uint64_t)info.st_size != header.originalSize && (uint64_t)info.st_size != finalSize) {
+        return EILSEQ;
+    }
+
+    uint8_t *buffer = self.buffer.mutableBytes;
+
+    // A chunk saved before being written over its own source can't be read back from the archive. If the
+    // progress was only partly written, the stash doesn't match it, and the chunk was never written
+    if (header.stashLength > self.buffer.length) {
+        return EILSEQ;
+    }
+    if (header.stashLength > 0) {
+        if ((err = UZKReadFully(journalFD, buffer, (size_t)header.stashLength, stashOffset)) != 0) {
+            return err;
+        }
+        if ([UZKInPlaceCompactor stashCRCOfBytes:buffer length:header.stashLength position:header.position] == header.stashCRC) {
+            uint64_t destination = 0;
+            if ([self locatePosition:header.position inMoves:moves destination:&destination]) {
+                if ((err = UZKWriteFully(self.fd, buffer, (size_t)header.stashLength, destination)) != 0 ||
+                    (err = UZKSync(self.fd)) != 0)
+                {
+                    return err;
+                }
+                header.position += header.stashLength;
+            }
+        }
+    }
+
+    const UZKJournalMove *move = moves.bytes;
+    uint64_t moveStart = 0;
+
+    for (uint64_t i = 0; i < header.moveCount; i++) {
+        uint64_t shift = move[i].source - move[i].destination;
+
+        for (uint64_t done = MAX(header.position, moveStart) - moveStart; done < move[i].length; ) {
+            uint64_t length = MIN(move[i].length - done, (uint64_t)self.buffer.length);
+            uint64_t source = move[i].source + done;
+            uint64_t destination = move[i].destination + done;
+
+            if ((err = UZKReadFully(self.fd, buffer, (size_t)length, source)) != 0) {
+                return err;
+            }
+
+            // When the chunk overlaps its own source, writing it destroys the only copy of part of it
+            BOOL overlaps = length > shift;
+            if (overlaps) {
+                header.position = moveStart + done;
+                header.stashLength = length;
+                header.stashCRC = [UZKInPlaceCompactor stashCRCOfBytes:buffer length:length position:header.position];
+
+                if ((err = UZKWriteFully(journalFD, buffer, (size_t)length, stashOffset)) != 0 ||
+                    (err = UZKWriteFully(journalFD, &header.position, offsetof(UZKJournalHeader, planCRC) - offsetof(UZKJournalHeader, position), offsetof(UZKJournalHeader, position))) != 0 ||
+                    (err = UZKSync(journalFD)) != 0)
+                {
+                    return err;
+                }
+
+#ifdef DEBUG
+                if (self.interruption == UZKCompactionInterruptionMidStashedChunk) {
+                    UZKWriteFully(self.fd, buffer, (size_t)length / 2, destination);
+                    UZKSync(self.fd);
+                    return EINTR;
+                }
+#endif
+            }
+
+            if ((err = UZKWriteFully(self.fd, buffer, (size_t)length, destination)) != 0 ||
+                (err = UZKSync(self.fd)) != 0)
+            {
+                return err;
+            }
+
+            done += length;
+
+            header.position = moveStart + done;
+            header.stashLength = 0;
+            header.stashCRC = 0;
+
+            if ((err = UZKWriteFully(journalFD, &header.position, offsetof(UZKJournalHeader, planCRC) - offsetof(UZKJournalHeader, position), offsetof(UZKJournalHeader, position))) != 0 ||
+                (err = UZKSync(journalFD)) != 0)
+            {
+                return err;
+            }
+        }
+
+        moveStart += move[i].length;
+    }
+
+    // Every entry is in place, so the old central directory isn't needed anymore
+    if ((err = UZKWriteFully(self.fd, tail.bytes, tail.length, header.tailOffset)) != 0) {
+        return err;
+    }
+#ifdef DEBUG
+    if (self.interruption == UZKCompactionInterruptionBeforeTruncate) {
+        UZKSync(self.fd);
+        return EINTR;
+    }
+#endif
+    if (ftruncate(self.fd, (off_t)finalSize) != 0) {
+        return errno;
+    }
+
+    return UZKSync(self.fd);
+}
+
+/**
+ *  Finds where a position, counted through the moves in order, falls in the archive
+ */
+- (BOOL)locatePosition:(uint64_t)position inMoves:(NSData *)moves destination:(uint64_t *)destination
+{
+    const UZKJournalMove *move = moves.bytes;
+    NSUInteger count = moves.length / sizeof(UZKJournalMove);
+
+    for (NSUInteger i = 0; i < count; i++) {
+        if (position < move[i].length) {
+            *destination = move[i].destination + position;
+            return YES;
+        }
+        position -= move[i].length;
+    }
+
+    return NO;
+}
+
+@end
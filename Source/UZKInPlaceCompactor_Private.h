@@ -0,0 +1,64 @@
+//
+//  UZKInPlaceCompactor_Private.h
+//  UnzipKit
+//
+//
+
+@import Foundation;
+
+#import "UZKInPlaceCompactor.h"
+
+#ifdef DEBUG
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Where a compaction stops early, as if the process had been killed there
+ */
+typedef NS_ENUM(NSInteger, UZKCompactionInterruption) {
+    
+    /**
+     *  Runs to completion
+     */
+    UZKCompactionInterruptionNone,
+    
+    /**
+     *  Stops after a chunk that overlaps its own source has been stashed in the journal, and half of it
+     *  written over its source
+     */
+    UZKCompactionInterruptionMidStashedChunk,
+    
+    /**
+     *  Stops after the new central directory has been written, before the archive is truncated
+     */
+    UZKCompactionInterruptionBeforeTruncate,
+    
+    /**
+     *  Fails with ENOSPC while filling in the room for the stash, as if the volume had filled up while the
+     *  journal was being written
+     */
+    UZKCompactionInterruptionJournalOutOfSpace,
+};
+
+/**
+ *  Hooks for testing recovery from a crash mid-compaction. Only built in Debug configurations
+ */
+@interface UZKInPlaceCompactor (Testing)
+
+/**
+ *  Compacts an archive like +compactArchiveAtPath:keepingCentralDirectoryRecordsAt:globalComment:journalPath:,
+ *  but stops at the given point, leaving the journal behind
+ *
+ *  @return EINTR when stopped at the interruption, otherwise the same as the method above
+ */
++ (int)compactArchiveAtPath:(NSString *)path
+keepingCentralDirectoryRecordsAt:(NSArray<NSNumber*> *)recordOffsets
+              globalComment:(nullable NSData *)comment
+                journalPath:(NSString *)journalPath
+               interruption:(UZKCompactionInterruption)interruption;
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+#endif
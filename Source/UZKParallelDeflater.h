@@ -0,0 +1,82 @@
+//
+//  UZKParallelDeflater.h
+//  UnzipKit
+//
+//
+
+@import Foundation;
+
+#import "zip.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Compresses a stream of data into a single raw Deflate stream, using several threads at once. The data
+ *  is split into blocks that are compressed independently, each one primed with the last 32 KB of the
+ *  block before it, so the result is nearly as small as with a single stream. Blocks end on a byte
+ *  boundary (Z_SYNC_FLUSH), so they're joined by simple concatenation, and any inflater can read the result
+ */
+@interface UZKParallelDeflater : NSObject
+
+/**
+ *  The CRC-32 of the data output so far
+ */
+@property (readonly) uLong crc;
+
+/**
+ *  The number of bytes of uncompressed data output so far
+ */
+@property (readonly) unsigned long long uncompressedSize;
+
+
+/**
+ *  Creates a deflater, ready to have data appended to it
+ *
+ *  @param level       The zlib compression level
+ *  @param concurrency The maximum number of blocks compressed at the same time
+ *  @param blockSize   The number of bytes of uncompressed data in each block. Sizes under 32 KB are rounded up
+ *  @param output      Called with each block's compressed data, in order, on the thread that appended the data.
+ *                     Returns ZIP_OK on success, or an error code, which stops compression
+ *
+ *  @return A new deflater
+ */
+- (instancetype)initWithLevel:(int)level
+                  concurrency:(NSUInteger)concurrency
+                    blockSize:(NSUInteger)blockSize
+                       output:(int(^)(const void *bytes, NSUInteger length))output NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ *  Compresses data into a complete raw Deflate stream on the calling thread
+ *
+ *  @param data   The data to compress
+ *  @param level  The zlib compression level
+ *  @param crc    Set to the CRC-32 of the uncompressed data
+ *  @param status Set to Z_OK, or the error returned by zlib
+ *
+ *  @return The compressed data, or nil if there was an error
+ */
++ (nullable NSData *)deflateData:(NSData *)data
+                           level:(int)level
+                             crc:(uLong *)crc
+                          status:(int *)status;
+
+/**
+ *  Adds data to the stream. Each full block is handed off to be compressed in the background, and may
+ *  wait for earlier blocks to finish and be output
+ *
+ *  @return Z_OK, or the first error returned by zlib or the output block
+ */
+- (int)appendBytes:(const void *)bytes length:(NSUInteger)length;
+
+/**
+ *  Compresses any remaining data as the final block, and waits until every block has been output
+ *
+ *  @return Z_OK, or the first error returned by zlib or the output block
+ */
+- (int)finish;
+
+@end
+
+NS_ASSUME_NONNULL_END
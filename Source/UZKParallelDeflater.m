@@ -0,0 +1,249 @@
+//
+//  UZKParallelDeflater.m
+//  UnzipKit
+//
+//
+
+#import "UZKParallelDeflater.h"
+
+#import "crc32fast.h"
+
+
+static const NSUInteger UZKDeflateWindowSize = 32 * 1024;
+static const NSUInteger UZKDeflateMaxChunkSize = UINT_MAX / 2;
+
+
+/**
+ *  One block of input, along with its compressed output once the background work is done
+ */
+@interface UZKDeflateBlock : NSObject
+
+@property (strong) NSData *input;
+@property (strong, nullable) NSData *dictionary;
+@property (assign) BOOL last;
+
+@property (strong) dispatch_group_t group;
+@property (strong) NSMutableData *output;
+@property (assign) uLong crc;
+@property (assign) int status;
+
+@end
+
+@implementation UZKDeflateBlock
+
+- (void)compressWithLevel:(int)level
+{
+    const Bytef *inputBytes = self.input.bytes;
+    NSUInteger inputRemaining = self.input.length;
+
+    self.crc = crc32_fast(0, inputBytes, self.input.length);
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    int err = deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if (err != Z_OK) {
+        self.status = err;
+        return;
+    }
+
+    if (self.dictionary.length > 0) {
+        err = deflateSetDictionary(&stream, self.dictionary.bytes, (uInt)self.dictionary.length);
+    }
+
+    // deflateBound covers a finished stream. A sync flush adds an empty stored block, so leave room for it
+    NSUInteger capacity = deflateBound(&stream, (uLong)self.input.length) + 16;
+    self.output = [NSMutableData dataWithLength:capacity];
+
+    stream.next_in = (Bytef *)(uintptr_t)inputBytes;
+
+    NSUInteger outputLength = 0;
+
+    while (err == Z_OK) {
+        // Input and output are fed in chunks that fit in zlib's counters
+        if (stream.avail_in == 0 && inputRemaining > 0) {
+            stream.avail_in = (uInt)MIN(inputRemaining, UZKDeflateMaxChunkSize);
+            inputRemaining -= stream.avail_in;
+        }
+
+        if (outputLength == self.output.length) {
+            self.output.length *= 2;
+        }
+
+        uInt availOut = (uInt)MIN(self.output.length - outputLength, UZKDeflateMaxChunkSize);
+        stream.next_out = (Bytef *)self.output.mutableBytes + outputLength;
+        stream.avail_out = availOut;
+
+        int flush = Z_NO_FLUSH;
+        if (inputRemaining == 0) {
+            flush = self.last ? Z_FINISH : Z_SYNC_FLUSH;
+        }
+
+        err = deflate(&stream, flush);
+        outputLength += availOut - stream.avail_out;
+
+        // A sync flush is complete once deflate stops short of filling the output buffer
+        if (err == Z_OK && flush == Z_SYNC_FLUSH && stream.avail_out > 0) {
+            break;
+        }
+    }
+
+    self.output.length = outputLength;
+    self.status = (err == Z_OK || err == Z_STREAM_END) ? Z_OK : err;
+
+    deflateEnd(&stream);
+}
+
+@end
+
+
+@interface UZKParallelDeflater ()
+
+@property (assign) int level;
+@property (assign) NSUInteger blockSize;
+@property (assign) NSUInteger concurrency;
+@property (copy) int(^output)(const void *bytes, NSUInteger length);
+
+@property (strong) NSMutableData *pendingInput;
+@property (strong, nullable) NSData *dictionary;
+@property (strong) NSMutableArray<UZKDeflateBlock*> *blocksInFlight;
+@property (assign) int status;
+
+@property (readwrite) uLong crc;
+@property (readwrite) unsigned long long uncompressedSize;
+
+@end
+
+
+@implementation UZKParallelDeflater
+
+
+#pragma mark - Initialization
+
+
+- (instancetype)initWithLevel:(int)level
+                  concurrency:(NSUInteger)concurrency
+                    blockSize:(NSUInteger)blockSize
+                       output:(int (^)(const void *, NSUInteger))output
+{
+    if ((self = [super init])) {
+        _level = level;
+        _concurrency = MAX(concurrency, (NSUInteger)1);
+        _blockSize = MIN(MAX(blockSize, UZKDeflateWindowSize), (NSUInteger)UINT_MAX / 2);
+        _output = [output copy];
+
+        _pendingInput = [NSMutableData dataWithCapacity:_blockSize];
+        _blocksInFlight = [NSMutableArray arrayWithCapacity:_concurrency + 1];
+        _status = Z_OK;
+
+        _crc = crc32_fast(0, NULL, 0);
+        _uncompressedSize = 0;
+    }
+    return self;
+}
+
+
+
+#pragma mark - Public Methods
+
+
++ (NSData *)deflateData:(NSData *)data
+                  level:(int)level
+                    crc:(uLong *)crc
+                 status:(int *)status
+{
+    UZKDeflateBlock *block = [[UZKDeflateBlock alloc] init];
+    block.input = data;
+    block.last = YES;
+
+    [block compressWithLevel:level];
+
+    *crc = block.crc;
+    *status = block.status;
+
+    return block.status == Z_OK ? block.output : nil;
+}
+
+- (int)appendBytes:(const void *)bytes length:(NSUInteger)length
+{
+    const uint8_t *next = bytes;
+
+    while (length > 0 && self.status == Z_OK) {
+        NSUInteger count = MIN(length, self.blockSize - self.pendingInput.length);
+        [self.pendingInput appendBytes:next length:count];
+        next += count;
+        length -= count;
+
+        if (self.pendingInput.length == self.blockSize) {
+            [self submitPendingInputAsLastBlock:NO];
+        }
+    }
+
+    return self.status;
+}
+
+- (int)finish
+{
+    if (self.status == Z_OK) {
+        [self submitPendingInputAsLastBlock:YES];
+    }
+
+    while (self.blocksInFlight.count > 0) {
+        [self outputFirstBlock];
+    }
+
+    return self.status;
+}
+
+
+
+#pragma mark - Private Methods
+
+
+- (void)submitPendingInputAsLastBlock:(BOOL)last
+{
+    UZKDeflateBlock *block = [[UZKDeflateBlock alloc] init];
+    block.input = self.pendingInput;
+    block.dictionary = self.dictionary;
+    block.last = last;
+    block.group = dispatch_group_create();
+
+    // Blocks are at least as large as the window, so the next block's dictionary is all in this one
+    NSUInteger dictionaryLength = MIN(block.input.length, UZKDeflateWindowSize);
+    self.dictionary = [block.input subdataWithRange:NSMakeRange(block.input.length - dictionaryLength, dictionaryLength)];
+    self.pendingInput = [NSMutableData dataWithCapacity:self.blockSize];
+
+    int level = self.level;
+    dispatch_group_async(block.group, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [block compressWithLevel:level];
+    });
+
+    [self.blocksInFlight addObject:block];
+
+    while (self.blocksInFlight.count > self.concurrency) {
+        [self outputFirstBlock];
+    }
+}
+
+- (void)outputFirstBlock
+{
+    UZKDeflateBlock *block = self.blocksInFlight.firstObject;
+    [self.blocksInFlight removeObjectAtIndex:0];
+
+    dispatch_group_wait(block.group, DISPATCH_TIME_FOREVER);
+
+    if (self.status != Z_OK) {
+        return;
+    }
+
+    if (block.status != Z_OK) {
+        self.status = block.status;
+        return;
+    }
+
+    self.crc = crc32_combine(self.crc, block.crc, (z_off_t)block.input.length);
+    self.uncompressedSize += block.input.length;
+    self.status = self.output(block.output.bytes, block.output.length);
+}
+
+@end
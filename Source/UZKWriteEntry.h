@@ -0,0 +1,80 @@
+//
+//  UZKWriteEntry.h
+//  UnzipKit
+//
+//
+
+#import <Foundation/Foundation.h>
+
+#import "UZKFileInfo.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Describes one file to be written into an archive with -[UZKArchive writeEntries:overwrite:error:],
+ *  along with where its data comes from. The data isn't read until the entry is compressed
+ */
+@interface UZKWriteEntry : NSObject
+
+/**
+ *  The full path to the target file in the archive
+ */
+@property (readonly, strong) NSString *filePath;
+
+/**
+ *  The timestamp of the file in the archive. Uses the current time if nil
+ */
+@property (strong, nullable) NSDate *fileDate;
+
+/**
+ *  The POSIX permissions of the file in the archive, in octal form, like 0644. Uses the default
+ *  permissions if 0
+ */
+@property (assign) short posixPermissions;
+
+/**
+ *  The UZKCompressionMethod to use (Default, None, Fastest, Best). Defaults to UZKCompressionMethodDefault
+ */
+@property (assign) UZKCompressionMethod compressionMethod;
+
+
+/**
+ *  Creates an entry for data that's already in memory
+ *
+ *  @param data     Data to write into the archive
+ *  @param filePath The full path to the target file in the archive
+ *
+ *  @return A new entry
+ */
++ (instancetype)entryWithData:(NSData *)data
+                     filePath:(NSString *)filePath;
+
+/**
+ *  Creates an entry for the contents of a file on disk, which is read (memory-mapped when possible)
+ *  only when the entry is compressed
+ *
+ *  @param fileURL  The location of the file to read
+ *  @param filePath The full path to the target file in the archive
+ *
+ *  @return A new entry
+ */
++ (instancetype)entryWithContentsOfURL:(NSURL *)fileURL
+                              filePath:(NSString *)filePath;
+
+/**
+ *  Creates an entry whose data is produced on demand, on whichever thread compresses the entry
+ *
+ *  @param filePath The full path to the target file in the archive
+ *  @param producer Returns the data to write, or nil on error (in which case, assign the error
+ *                  parameter)
+ *
+ *  @return A new entry
+ */
++ (instancetype)entryWithFilePath:(NSString *)filePath
+                         producer:(NSData * _Nullable(^)(NSError **error))producer;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,88 @@
+//
+//  UZKWriteEntry.m
+//  UnzipKit
+//
+//
+
+#import "UZKWriteEntry.h"
+#import "UZKWriteEntry_Private.h"
+
+@interface UZKWriteEntry ()
+
+@property (readwrite, strong) NSString *filePath;
+@property (copy) NSData * _Nullable(^producer)(NSError * __autoreleasing *error);
+@property (copy) unsigned long long(^lengthEstimator)(void);
+
+@end
+
+
+@implementation UZKWriteEntry
+
+
+#pragma mark - Initialization
+
+
++ (instancetype)entryWithData:(NSData *)data
+                     filePath:(NSString *)filePath
+{
+    UZKWriteEntry *entry = [[UZKWriteEntry alloc] initWithFilePath:filePath
+                                                          producer:^NSData *(NSError * __autoreleasing *error) {
+                                                              return data;
+                                                          }];
+    entry.lengthEstimator = ^unsigned long long{
+        return data.length;
+    };
+    return entry;
+}
+
++ (instancetype)entryWithContentsOfURL:(NSURL *)fileURL
+                              filePath:(NSString *)filePath
+{
+    UZKWriteEntry *entry = [[UZKWriteEntry alloc] initWithFilePath:filePath
+                                                          producer:^NSData *(NSError * __autoreleasing *error) {
+                                                              return [NSData dataWithContentsOfURL:fileURL
+                                                                                           options:NSDataReadingMappedIfSafe
+                                                                                             error:error];
+                                                          }];
+    entry.lengthEstimator = ^unsigned long long{
+        NSNumber *fileSize = nil;
+        [fileURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:nil];
+        return fileSize.unsignedLongLongValue;
+    };
+    return entry;
+}
+
++ (instancetype)entryWithFilePath:(NSString *)filePath
+                         producer:(NSData * _Nullable(^)(NSError * __autoreleasing *error))producer
+{
+    return [[UZKWriteEntry alloc] initWithFilePath:filePath
+                                          producer:producer];
+}
+
+- (instancetype)initWithFilePath:(NSString *)filePath
+                        producer:(NSData * _Nullable(^)(NSError * __autoreleasing *error))producer
+{
+    if ((self = [super init])) {
+        _filePath = filePath;
+        _producer = [producer copy];
+        _compressionMethod = UZKCompressionMethodDefault;
+    }
+    return self;
+}
+
+
+
+#pragma mark - Private Methods
+
+
+- (NSData *)loadData:(NSError * __autoreleasing *)error
+{
+    return self.producer(error);
+}
+
+- (unsigned long long)expectedLength
+{
+    return self.lengthEstimator ? self.lengthEstimator() : 0;
+}
+
+@end
@@ -0,0 +1,28 @@
+//
+//  UZKWriteEntry_Private.h
+//  UnzipKit
+//
+//
+
+@import Foundation;
+
+#import "UZKWriteEntry.h"
+
+@interface UZKWriteEntry (Private)
+
+/**
+ *  Reads or produces the entry's data
+ *
+ *  @param error Contains an NSError object when the data couldn't be loaded
+ *
+ *  @return The data to write into the archive, or nil on error
+ */
+- (nullable NSData *)loadData:(NSError * __autoreleasing *)error;
+
+/**
+ *  @return The length of the data loadData: is expected to return, without loading it, or 0 if that
+ *          isn't known until the data is produced
+ */
+- (unsigned long long)expectedLength;
+
+@end
@@ -17,3 +17,4 @@ FOUNDATION_EXPORT const unsigned char UnzipKitVersionString[];
 
 #import "UZKArchive.h"
 #import "UZKFileInfo.h"
+#import "UZKWriteEntry.h"
@@ -8,6 +8,7 @@
 
 #import "UZKArchiveTestCase.h"
 #import "UnzipKit.h"
+#import "crc32fast.h"
 
 @interface CheckDataTests : UZKArchiveTestCase
 @end
@@ -50,6 +51,22 @@
     XCTAssertFalse(success, @"Data integrity check passed for archive with a modified CRC");
 }
 
+- (void)testCheckDataIntegrity_AE2 {
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive (AE-2).zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL password:@"password" error:nil];
+    
+    BOOL success = [archive checkDataIntegrity];
+    XCTAssertTrue(success, @"Data integrity check failed for AE-2 archive, which has no CRCs");
+}
+
+- (void)testCheckDataIntegrity_AE2_ModifiedData {
+    NSURL *testArchiveURL = self.testFileURLs[@"Modified Data Archive (AE-2).zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL password:@"password" error:nil];
+    
+    BOOL success = [archive checkDataIntegrity];
+    XCTAssertFalse(success, @"Data integrity check passed for AE-2 archive with modified data");
+}
+
 #pragma mark - checkDataIntegrityOfFile
 
 - (void)testCheckDataIntegrityForFile {
@@ -93,5 +110,90 @@
     XCTAssertFalse(success, @"Data integrity check passed for archive with modified CRC");
 }
 
+- (void)testCheckDataIntegrityForFile_AE2 {
+    NSURL *testArchiveURL = self.testFileURLs[@"Modified Data Archive (AE-2).zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL password:@"password" error:nil];
+    
+    XCTAssertFalse([archive checkDataIntegrityOfFile:@"Short Text File.txt"],
+                   @"Data integrity check passed for modified file in AE-2 archive");
+    XCTAssertTrue([archive checkDataIntegrityOfFile:@"Tiny Text File.txt"],
+                  @"Data integrity check failed for unmodified file in AE-2 archive");
+}
+
+
+#pragma mark - CRC-32
+
+- (void)testCRC32Fast_MatchesZlib {
+    NSUInteger maxLength = 1024;
+    NSMutableData *data = [NSMutableData dataWithLength:maxLength + 16];
+    arc4random_buf(data.mutableBytes, data.length);
+    const Bytef *bytes = data.bytes;
+    
+    // Every alignment, and lengths on both sides of each implementation's block sizes
+    for (NSUInteger offset = 0; offset < 16; offset++) {
+        for (NSUInteger length = 0; length <= maxLength; length++) {
+            uLong expectedCRC = crc32(0x12345678, bytes + offset, (uInt)length);
+            uLong calculatedCRC = crc32_fast(0x12345678, bytes + offset, length);
+            
+            if (calculatedCRC != expectedCRC) {
+                XCTFail(@"%s CRC of %lu bytes at offset %lu is %08lx, expected %08lx", crc32_fast_implementation(),
+                        (unsigned long)length, (unsigned long)offset, calculatedCRC, expectedCRC);
+                return;
+            }
+        }
+    }
+}
+
+- (void)testCRC32Fast_Chunked {
+    NSUInteger length = 4 * 1024 * 1024;
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    const Bytef *bytes = data.bytes;
+    
+    uLong crc = crc32_fast(0, NULL, 0);
+    for (NSUInteger offset = 0; offset < length; ) {
+        NSUInteger chunkLength = MIN(arc4random_uniform(100000), length - offset);
+        crc = crc32_fast(crc, bytes + offset, chunkLength);
+        offset += chunkLength;
+    }
+    
+    XCTAssertEqual(crc, crc32(0, bytes, (uInt)length), @"Chunked CRC doesn't match zlib's");
+    XCTAssertEqual(crc, crc32_fast(0, bytes, length), @"Chunked CRC doesn't match a single call's");
+}
+
+- (void)testPerformance_CRC32Fast {
+    NSUInteger length = 32 * 1024 * 1024;
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    
+    uLong expectedCRC = crc32(0, data.bytes, (uInt)length);
+    
+    [self measureBlock:^{
+        XCTAssertEqual(crc32_fast(0, data.bytes, length), expectedCRC, @"%s CRC doesn't match zlib's", crc32_fast_implementation());
+    }];
+}
+
+- (void)testPerformance_CheckDataIntegrity_Stored {
+    NSUInteger fileSize = 64 * 1024 * 1024;
+    NSMutableData *randomData = [NSMutableData dataWithLength:fileSize];
+    arc4random_buf(randomData.mutableBytes, fileSize);
+    
+    NSURL *archiveURL = [self.tempDirectory URLByAppendingPathComponent:@"CRC Benchmark.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    
+    NSError *writeError = nil;
+    BOOL writeSuccess = [archive writeData:randomData
+                                  filePath:@"Random.bin"
+                                  fileDate:nil
+                         compressionMethod:UZKCompressionMethodNone
+                                  password:nil
+                                     error:&writeError];
+    XCTAssertTrue(writeSuccess, @"Failed to write benchmark archive: %@", writeError);
+    
+    [self measureBlock:^{
+        XCTAssertTrue([archive checkDataIntegrity], @"Data integrity check failed for benchmark archive");
+    }];
+}
+
 
 @end
@@ -8,6 +8,13 @@
 
 #import "UZKArchiveTestCase.h"
 #import "UnzipKit.h"
+#import "UZKInPlaceCompactor_Private.h"
+#import "unzip.h"
+
+#ifdef DEBUG
+// The journal's header, before the moves and the new central directory
+static const unsigned long long UZKJournalHeaderSize = 64;
+#endif
 
 @interface DeleteFileTests : UZKArchiveTestCase
 @end
@@ -147,4 +154,345 @@
 }
 
 
+- (void)testDeleteFile_LargeFileCopiedInChunks
+{
+    // Random data doesn't compress, so the remaining file is copied in several chunks
+    NSUInteger fileSize = 5 * 1024 * 1024 + 17;
+    NSMutableData *randomData = [NSMutableData dataWithLength:fileSize];
+    arc4random_buf(randomData.mutableBytes, fileSize);
+    
+    NSURL *archiveURL = [self.tempDirectory URLByAppendingPathComponent:@"DeleteLargeFileTest.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    
+    NSError *writeError = nil;
+    XCTAssertTrue([archive writeData:randomData filePath:@"Random.bin" error:&writeError], @"Failed to write large file: %@", writeError);
+    XCTAssertTrue([archive writeData:[@"Delete me" dataUsingEncoding:NSUTF8StringEncoding] filePath:@"Small.txt" error:&writeError], @"Failed to write small file: %@", writeError);
+    
+    NSError *deleteError = nil;
+    BOOL result = [archive deleteFile:@"Small.txt" error:&deleteError];
+    XCTAssertTrue(result, @"Failed to delete small file");
+    XCTAssertNil(deleteError, @"Error deleting small file");
+    
+    NSError *listError = nil;
+    XCTAssertEqualObjects([archive listFilenames:&listError], @[@"Random.bin"], @"Unexpected files remaining");
+    
+    NSError *extractError = nil;
+    NSData *extractedData = [archive extractDataFromFile:@"Random.bin" error:&extractError];
+    XCTAssertNil(extractError, @"Error extracting large file after deletion");
+    XCTAssertEqualObjects(extractedData, randomData, @"Large file's data changed by the deletion");
+}
+
+- (void)testDeleteFiles
+{
+    NSArray *testArchives = @[@"Test Archive.zip",
+                              @"Test Archive (Password).zip"];
+    
+    NSSet *expectedFileSet = self.nonZipTestFilePaths;
+    NSArray *expectedFiles = [expectedFileSet.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    NSArray *filesToDelete = @[expectedFiles[0], expectedFiles[2]];
+    
+    NSMutableArray *newFileList = [NSMutableArray arrayWithArray:expectedFiles];
+    [newFileList removeObjectsInArray:filesToDelete];
+    
+    for (NSString *testArchiveName in testArchives) {
+        NSURL *testArchiveURL = self.testFileURLs[testArchiveName];
+        NSString *password = ([testArchiveName rangeOfString:@"Password"].location != NSNotFound
+                              ? @"password"
+                              : nil);
+        UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL password:password error:nil];
+        
+        NSError *deleteError = nil;
+        BOOL result = [archive deleteFiles:filesToDelete error:&deleteError];
+        XCTAssertTrue(result, @"Failed to delete %@ from %@", filesToDelete, testArchiveName);
+        XCTAssertNil(deleteError, @"Error deleting %@ from %@", filesToDelete, testArchiveName);
+        
+        __block NSUInteger fileIndex = 0;
+        NSError *error = nil;
+        
+        [archive performOnDataInArchive:
+         ^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+             NSString *expectedFilename = newFileList[fileIndex++];
+             XCTAssertEqualObjects(fileInfo.filename, expectedFilename, @"Unexpected filename encountered");
+             
+             NSData *expectedFileData = [NSData dataWithContentsOfURL:self.testFileURLs[expectedFilename]];
+             
+             XCTAssertNotNil(fileData, @"No data extracted");
+             XCTAssertTrue([expectedFileData isEqualToData:fileData], @"File data doesn't match original file");
+         } error:&error];
+        
+        XCTAssertNil(error, @"Error iterating through files");
+        XCTAssertEqual(fileIndex, newFileList.count, @"Incorrect number of files encountered");
+    }
+}
+
+- (void)testDeleteFiles_InPlace
+{
+    NSSet *expectedFileSet = self.nonZipTestFilePaths;
+    NSArray *expectedFiles = [expectedFileSet.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    NSArray *filesToDelete = @[expectedFiles[0], expectedFiles[2]];
+    
+    NSMutableArray *newFileList = [NSMutableArray arrayWithArray:expectedFiles];
+    [newFileList removeObjectsInArray:filesToDelete];
+    
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    unsigned long long originalSize = [[NSFileManager defaultManager] attributesOfItemAtPath:testArchiveURL.path error:nil].fileSize;
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    archive.deletesInPlace = YES;
+    
+    NSError *deleteError = nil;
+    BOOL result = [archive deleteFiles:filesToDelete error:&deleteError];
+    XCTAssertTrue(result, @"Failed to delete %@ in place", filesToDelete);
+    XCTAssertNil(deleteError, @"Error deleting %@ in place", filesToDelete);
+    
+    unsigned long long newSize = [[NSFileManager defaultManager] attributesOfItemAtPath:testArchiveURL.path error:nil].fileSize;
+    XCTAssertLessThan(newSize, originalSize, @"Archive didn't shrink");
+    
+    NSString *journalPath = [testArchiveURL.path stringByAppendingString:@".uzkjournal"];
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:journalPath], @"Journal left behind");
+    
+    __block NSUInteger fileIndex = 0;
+    NSError *error = nil;
+    
+    [archive performOnDataInArchive:
+     ^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+         NSString *expectedFilename = newFileList[fileIndex++];
+         XCTAssertEqualObjects(fileInfo.filename, expectedFilename, @"Unexpected filename encountered");
+         
+         NSData *expectedFileData = [NSData dataWithContentsOfURL:self.testFileURLs[expectedFilename]];
+         
+         XCTAssertNotNil(fileData, @"No data extracted");
+         XCTAssertTrue([expectedFileData isEqualToData:fileData], @"File data doesn't match original file");
+     } error:&error];
+    
+    XCTAssertNil(error, @"Error iterating through files");
+    XCTAssertEqual(fileIndex, newFileList.count, @"Incorrect number of files encountered");
+    
+#if !TARGET_OS_IPHONE
+    XCTAssertTrue([self extractArchive:testArchiveURL password:nil], @"Archive compacted in place is invalid");
+#endif
+}
+
+- (void)testDeleteFilesPassingTest
+{
+    NSSet *expectedFileSet = self.nonZipTestFilePaths;
+    NSArray *expectedFiles = [expectedFileSet.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    NSString *fileToKeep = expectedFiles[1];
+    
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    __block NSUInteger testedCount = 0;
+    NSError *deleteError = nil;
+    BOOL result = [archive deleteFilesPassingTest:^BOOL(UZKFileInfo *fileInfo) {
+        testedCount++;
+        return ![fileInfo.filename isEqualToString:fileToKeep];
+    } error:&deleteError];
+    
+    XCTAssertTrue(result, @"Failed to delete files");
+    XCTAssertNil(deleteError, @"Error deleting files");
+    XCTAssertEqual(testedCount, expectedFiles.count, @"Predicate not called once per file");
+    
+    NSError *listError = nil;
+    NSArray *remainingFiles = [archive listFilenames:&listError];
+    XCTAssertNil(listError, @"Error listing remaining files");
+    XCTAssertEqualObjects(remainingFiles, @[fileToKeep], @"Unexpected files remaining");
+}
+
+
+
+// Recovery is tested by interrupting compactions, which is only possible in Debug builds
+#ifdef DEBUG
+
+#pragma mark - In-Place Deletion Recovery
+
+
+- (void)testDeleteFiles_InPlace_RecoverFromInterruptionMidStashedChunk
+{
+    [self checkRecoveryFromInterruption:UZKCompactionInterruptionMidStashedChunk];
+}
+
+- (void)testDeleteFiles_InPlace_RecoverFromInterruptionBeforeTruncate
+{
+    [self checkRecoveryFromInterruption:UZKCompactionInterruptionBeforeTruncate];
+}
+
+- (void)testDeleteFiles_InPlace_RecoverWithTruncatedJournal
+{
+    [self checkRecoveryRejectsJournalDamagedBy:^(NSFileHandle *journal) {
+        [journal truncateFileAtOffset:UZKJournalHeaderSize + 8];
+    }];
+}
+
+- (void)testDeleteFiles_InPlace_RecoverWithTruncatedStash
+{
+    [self checkRecoveryRejectsJournalDamagedBy:^(NSFileHandle *journal) {
+        [journal truncateFileAtOffset:journal.seekToEndOfFile - 1];
+    }];
+}
+
+- (void)testDeleteFiles_InPlace_RecoverWithJournalCRCMismatch
+{
+    [self checkRecoveryRejectsJournalDamagedBy:^(NSFileHandle *journal) {
+        [journal seekToFileOffset:UZKJournalHeaderSize];
+        uint8_t byte = ((const uint8_t *)[journal readDataOfLength:1].bytes)[0] ^ 0xff;
+        [journal seekToFileOffset:UZKJournalHeaderSize];
+        [journal writeData:[NSData dataWithBytes:&byte length:1]];
+    }];
+}
+
+- (void)testDeleteFiles_InPlace_NoSpaceForJournal
+{
+    NSURL *testArchiveURL = [self copyOfTestArchiveNamed:@"No Space.zip"];
+    NSData *originalArchive = [NSData dataWithContentsOfURL:testArchiveURL];
+    
+    XCTAssertEqual([self compactArchive:testArchiveURL deletingFile:@"Test File A.txt" interruption:UZKCompactionInterruptionJournalOutOfSpace], ENOSPC,
+                   @"Running out of space for the journal not reported");
+    
+    NSString *journalPath = [testArchiveURL.path stringByAppendingString:@".uzkjournal"];
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:journalPath], @"Journal left behind");
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[journalPath stringByAppendingString:@"-new"]], @"Partial journal left behind");
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:testArchiveURL], originalArchive, @"Archive changed without room for the journal");
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSError *listError = nil;
+    NSArray *filenames = [archive listFilenames:&listError];
+    XCTAssertNil(listError, @"Error listing files: %@", listError);
+    XCTAssertEqualObjects(filenames, (@[@"Test File A.txt", @"Test File B.jpg", @"Test File C.m4a"]), @"Unexpected files");
+}
+
+- (void)testDiscardDeletionJournal
+{
+    NSURL *testArchiveURL = [self copyOfTestArchiveNamed:@"Discarded Journal.zip"];
+    XCTAssertEqual([self compactArchive:testArchiveURL deletingFile:@"Test File A.txt" interruption:UZKCompactionInterruptionMidStashedChunk], EINTR,
+                   @"Compaction not interrupted");
+    
+    // Damage the plan, so the deletion can't be finished
+    NSString *journalPath = [testArchiveURL.path stringByAppendingString:@".uzkjournal"];
+    NSFileHandle *journal = [NSFileHandle fileHandleForUpdatingAtPath:journalPath];
+    [journal truncateFileAtOffset:UZKJournalHeaderSize];
+    [journal closeFile];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSError *writeError = nil;
+    XCTAssertFalse([archive writeData:[@"New file" dataUsingEncoding:NSUTF8StringEncoding] filePath:@"New File.txt" error:&writeError],
+                   @"Archive written despite a damaged journal");
+    XCTAssertEqual(writeError.code, UZKErrorCodeDeletionJournalDamaged, @"Unexpected error code for a damaged journal");
+    
+    NSError *discardError = nil;
+    XCTAssertTrue([archive discardDeletionJournal:&discardError], @"Failed to discard journal: %@", discardError);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:journalPath], @"Journal not deleted");
+    
+    // The interruption came before the central directory was replaced, so the original one is still in place
+    NSError *listError = nil;
+    NSArray *filenames = [archive listFilenames:&listError];
+    XCTAssertNil(listError, @"Error listing files after discarding the journal: %@", listError);
+    XCTAssertEqualObjects(filenames, (@[@"Test File A.txt", @"Test File B.jpg", @"Test File C.m4a"]), @"Unexpected files after discarding the journal");
+    
+    XCTAssertTrue([archive discardDeletionJournal:&discardError], @"Discarding a journal that isn't there failed: %@", discardError);
+}
+
+
+#pragma mark - Helper Methods
+
+
+/**
+ *  Deletes the first file from a copy of Test Archive.zip in place, stopping at the given point, and checks
+ *  that the next operation on the archive finishes the job, leaving it byte for byte the same as an archive
+ *  compacted without being interrupted
+ */
+- (void)checkRecoveryFromInterruption:(UZKCompactionInterruption)interruption
+{
+    NSURL *expectedURL = [self copyOfTestArchiveNamed:@"Expected.zip"];
+    XCTAssertEqual([self compactArchive:expectedURL deletingFile:@"Test File A.txt" interruption:UZKCompactionInterruptionNone], 0,
+                   @"Failed to compact archive without interruption");
+    
+    NSURL *testArchiveURL = [self copyOfTestArchiveNamed:@"Interrupted.zip"];
+    XCTAssertEqual([self compactArchive:testArchiveURL deletingFile:@"Test File A.txt" interruption:interruption], EINTR,
+                   @"Compaction not interrupted");
+    
+    NSString *journalPath = [testArchiveURL.path stringByAppendingString:@".uzkjournal"];
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:journalPath], @"No journal left by interrupted compaction");
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSError *listError = nil;
+    NSArray *filenames = [archive listFilenames:&listError];
+    
+    XCTAssertNil(listError, @"Error listing files after interrupted compaction: %@", listError);
+    XCTAssertEqualObjects(filenames, (@[@"Test File B.jpg", @"Test File C.m4a"]), @"Unexpected files after recovery");
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:journalPath], @"Journal left behind after recovery");
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:testArchiveURL], [NSData dataWithContentsOfURL:expectedURL],
+                          @"Recovered archive doesn't match one compacted without interruption");
+}
+
+/**
+ *  Interrupts a deletion mid-chunk, damages the journal it leaves behind, and checks that recovery refuses to
+ *  use it, leaving both the archive and the journal as they were
+ */
+- (void)checkRecoveryRejectsJournalDamagedBy:(void(^)(NSFileHandle *journal))damage
+{
+    NSURL *testArchiveURL = [self copyOfTestArchiveNamed:@"Damaged Journal.zip"];
+    XCTAssertEqual([self compactArchive:testArchiveURL deletingFile:@"Test File A.txt" interruption:UZKCompactionInterruptionMidStashedChunk], EINTR,
+                   @"Compaction not interrupted");
+    
+    NSString *journalPath = [testArchiveURL.path stringByAppendingString:@".uzkjournal"];
+    NSFileHandle *journal = [NSFileHandle fileHandleForUpdatingAtPath:journalPath];
+    damage(journal);
+    [journal closeFile];
+    
+    NSData *interruptedArchive = [NSData dataWithContentsOfURL:testArchiveURL];
+    NSData *damagedJournal = [NSData dataWithContentsOfFile:journalPath];
+    
+    int err = [UZKInPlaceCompactor recoverArchiveAtPath:testArchiveURL.path journalPath:journalPath];
+    XCTAssertEqual(err, EILSEQ, @"Damaged journal not reported");
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSError *listError = nil;
+    XCTAssertNil([archive listFilenames:&listError], @"Files listed despite a damaged journal");
+    XCTAssertEqual(listError.code, UZKErrorCodeDeletionJournalDamaged, @"Unexpected error code for a damaged journal");
+    
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:testArchiveURL], interruptedArchive, @"Archive changed by a damaged journal");
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:journalPath], damagedJournal, @"Damaged journal changed");
+}
+
+- (NSURL *)copyOfTestArchiveNamed:(NSString *)name
+{
+    NSURL *url = [self.tempDirectory URLByAppendingPathComponent:name];
+    
+    NSError *copyError = nil;
+    XCTAssertTrue([[NSFileManager defaultManager] copyItemAtURL:self.testFileURLs[@"Test Archive.zip"] toURL:url error:&copyError],
+                  @"Failed to copy test archive: %@", copyError);
+    
+    return url;
+}
+
+- (int)compactArchive:(NSURL *)url deletingFile:(NSString *)filename interruption:(UZKCompactionInterruption)interruption
+{
+    NSMutableArray<NSNumber*> *recordsToKeep = [NSMutableArray array];
+    
+    unzFile zip = unzOpen64(url.fileSystemRepresentation);
+    for (int err = unzGoToFirstFile(zip); err == UNZ_OK; err = unzGoToNextFile(zip)) {
+        char filenameInZip[1024];
+        unzGetCurrentFileInfo64(zip, NULL, filenameInZip, sizeof(filenameInZip), NULL, 0, NULL, 0);
+        
+        if (![@(filenameInZip) isEqualToString:filename]) {
+            [recordsToKeep addObject:@(unzGetOffset64(zip))];
+        }
+    }
+    unzClose(zip);
+    
+    return [UZKInPlaceCompactor compactArchiveAtPath:url.path
+                    keepingCentralDirectoryRecordsAt:recordsToKeep
+                                       globalComment:nil
+                                         journalPath:[url.path stringByAppendingString:@".uzkjournal"]
+                                        interruption:interruption];
+}
+
+#endif
+
+
 @end
@@ -63,6 +63,49 @@ enum SignPostColor: uint {  // standard color scheme for signposts in Instrument
                   @"File extracted in buffer not returned correctly");
 }
 
+- (void)testExtractBufferedData_ReusedBuffer
+{
+    NSURL *archiveURL = self.testFileURLs[@"Test Archive.zip"];
+    NSString *extractedFile = @"Test File B.jpg";
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    
+    NSUInteger chunkSize = 4096;
+    __block NSUInteger chunkCount = 0;
+    __block const void *firstChunkBytes = NULL;
+    __block BOOL bufferReused = YES;
+    
+    NSError *error = nil;
+    NSMutableData *reconstructedFile = [NSMutableData data];
+    BOOL success = [archive extractBufferedDataFromFile:extractedFile
+                                              chunkSize:chunkSize
+                                                  error:&error
+                                            bytesAction:
+                    ^(const void *bytes, NSUInteger length, CGFloat percentDecompressed) {
+#if DEBUG
+                        UZKLogDebug("Decompressed: %f%%", percentDecompressed);
+#endif
+                        if (!firstChunkBytes) {
+                            firstChunkBytes = bytes;
+                        }
+                        
+                        bufferReused = bufferReused && bytes == firstChunkBytes;
+                        chunkCount++;
+                        
+                        XCTAssertLessThanOrEqual(length, chunkSize, @"Chunk larger than requested");
+                        [reconstructedFile appendBytes:bytes
+                                                length:length];
+                    }];
+    
+    XCTAssertTrue(success, @"Failed to read buffered data");
+    XCTAssertNil(error, @"Error reading buffered data");
+    XCTAssertTrue(bufferReused, @"A new buffer was used for some chunks");
+    
+    NSData *originalFile = [NSData dataWithContentsOfURL:self.testFileURLs[extractedFile]];
+    XCTAssertEqual(chunkCount, (originalFile.length + chunkSize - 1) / chunkSize, @"Incorrect number of chunks returned");
+    XCTAssertTrue([originalFile isEqualToData:reconstructedFile],
+                  @"File extracted in buffer not returned correctly");
+}
+
 #if !TARGET_OS_IPHONE && __MAC_OS_X_VERSION_MIN_REQUIRED >= 101200
 - (void)testExtractBufferedData_VeryLarge
 {
@@ -93,6 +93,243 @@
     }
 }
 
+- (void)testExtractData_MemoryMapped
+{
+    NSArray *testArchives = @[@"Test Archive.zip",
+                              @"Test Archive (Password).zip"];
+    
+    NSSet *expectedFileSet = self.nonZipTestFilePaths;
+    NSArray *expectedFiles = [expectedFileSet.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    
+    for (NSString *testArchiveName in testArchives) {
+        NSURL *testArchiveURL = self.testFileURLs[testArchiveName];
+        NSString *password = ([testArchiveName rangeOfString:@"Password"].location != NSNotFound
+                              ? @"password"
+                              : nil);
+        UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL password:password error:nil];
+        archive.useMemoryMappedIO = YES;
+        
+        for (NSString *expectedFilename in expectedFiles) {
+            NSError *error = nil;
+            NSData *extractedData = [archive extractDataFromFile:expectedFilename
+                                                           error:&error];
+            
+            XCTAssertNil(error, @"Error in extractData:error: (%@)", testArchiveName);
+            
+            NSData *expectedFileData = [NSData dataWithContentsOfURL:self.testFileURLs[expectedFilename]];
+            
+            XCTAssertNotNil(extractedData, @"No data extracted (%@)", testArchiveName);
+            XCTAssertTrue([expectedFileData isEqualToData:extractedData], @"Extracted data doesn't match original file (%@)", testArchiveName);
+        }
+    }
+}
+
+- (void)testExtractMappedData
+{
+    NSArray *testArchives = @[@"Test Archive.zip",
+                              @"Test Archive (Password).zip"];
+    
+    NSSet *expectedFileSet = self.nonZipTestFilePaths;
+    NSArray *expectedFiles = [expectedFileSet.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    
+    for (NSString *testArchiveName in testArchives) {
+        NSURL *testArchiveURL = self.testFileURLs[testArchiveName];
+        NSString *password = ([testArchiveName rangeOfString:@"Password"].location != NSNotFound
+                              ? @"password"
+                              : nil);
+        UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL password:password error:nil];
+        
+        for (NSString *expectedFilename in expectedFiles) {
+            NSData *expectedFileData = [NSData dataWithContentsOfURL:self.testFileURLs[expectedFilename]];
+            
+            for (NSNumber *verifyCRC in @[@NO, @YES]) {
+                NSError *error = nil;
+                NSData *extractedData = [archive extractMappedDataFromFile:expectedFilename
+                                                                 verifyCRC:verifyCRC.boolValue
+                                                                     error:&error];
+                
+                XCTAssertNil(error, @"Error in extractMappedDataFromFile:verifyCRC:error: (%@)", testArchiveName);
+                XCTAssertNotNil(extractedData, @"No data extracted (%@)", testArchiveName);
+                XCTAssertTrue([expectedFileData isEqualToData:extractedData], @"Extracted data doesn't match original file (%@)", testArchiveName);
+            }
+        }
+    }
+}
+
+- (void)testExtractMappedData_OutlivesArchive
+{
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    NSData *extractedData = nil;
+    
+    @autoreleasepool {
+        UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+        
+        NSError *error = nil;
+        extractedData = [archive extractMappedDataFromFile:@"Test File A.txt"
+                                                 verifyCRC:NO
+                                                     error:&error];
+        XCTAssertNil(error, @"Error in extractMappedDataFromFile:verifyCRC:error:");
+    }
+    
+    NSData *expectedFileData = [NSData dataWithContentsOfURL:self.testFileURLs[@"Test File A.txt"]];
+    XCTAssertTrue([expectedFileData isEqualToData:extractedData], @"Mapped data changed after the archive was released");
+}
+
+- (void)testExtractMappedData_FileNotFound
+{
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSError *error = nil;
+    NSData *extractedData = [archive extractMappedDataFromFile:@"no file here.txt"
+                                                     verifyCRC:YES
+                                                         error:&error];
+    
+    XCTAssertNil(extractedData, @"Data returned for a file not in the archive");
+    XCTAssertNotNil(error, @"No error returned for a file not in the archive");
+    XCTAssertEqual(error.code, UZKErrorCodeFileNotFoundInArchive, @"Wrong error code returned");
+}
+
+- (void)testExtractData_IdleHandleTimeout
+{
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"IdleHandleTimeout.zip"];
+    [[NSFileManager defaultManager] copyItemAtURL:self.testFileURLs[@"Test Archive.zip"]
+                                            toURL:testArchiveURL
+                                            error:nil];
+    
+    NSArray *expectedFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    archive.idleHandleTimeout = 60;
+    
+    for (NSString *expectedFilename in expectedFiles) {
+        NSError *error = nil;
+        NSData *extractedData = [archive extractDataFromFile:expectedFilename
+                                                       error:&error];
+        
+        XCTAssertNil(error, @"Error extracting %@ through an idle handle", expectedFilename);
+        XCTAssertEqualObjects(extractedData, [NSData dataWithContentsOfURL:self.testFileURLs[expectedFilename]],
+                              @"Extracted data doesn't match original file (%@)", expectedFilename);
+    }
+    
+    UZKArchive *otherArchive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    NSData *newFileData = [@"Written by another archive object" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    NSError *writeError = nil;
+    BOOL writeResult = [otherArchive writeData:newFileData
+                                      filePath:@"newFile.txt"
+                                         error:&writeError];
+    XCTAssertTrue(writeResult, @"Failed to write to archive");
+    XCTAssertNil(writeError, @"Error writing to archive");
+    
+    NSError *extractError = nil;
+    NSData *extractedData = [archive extractDataFromFile:@"newFile.txt"
+                                                   error:&extractError];
+    
+    XCTAssertNil(extractError, @"Idle handle was reused after the archive changed");
+    XCTAssertEqualObjects(extractedData, newFileData, @"Incorrect data extracted after the archive changed");
+}
+
+- (void)testExtractDataFromFiles
+{
+    NSArray *testArchives = @[@"Test Archive.zip",
+                              @"Test Archive (Password).zip"];
+    
+    NSArray *expectedFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    
+    for (NSString *testArchiveName in testArchives) {
+        NSURL *testArchiveURL = self.testFileURLs[testArchiveName];
+        NSString *password = ([testArchiveName rangeOfString:@"Password"].location != NSNotFound
+                              ? @"password"
+                              : nil);
+        UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL password:password error:nil];
+        
+        NSError *error = nil;
+        NSDictionary<NSString*, NSData*> *extractedData = [archive extractDataFromFiles:expectedFiles.reverseObjectEnumerator.allObjects
+                                                                                  error:&error];
+        
+        XCTAssertNil(error, @"Error in extractDataFromFiles:error: (%@)", testArchiveName);
+        XCTAssertEqual(extractedData.count, expectedFiles.count, @"Wrong number of files extracted (%@)", testArchiveName);
+        
+        for (NSString *expectedFilename in expectedFiles) {
+            NSData *expectedFileData = [NSData dataWithContentsOfURL:self.testFileURLs[expectedFilename]];
+            XCTAssertEqualObjects(extractedData[expectedFilename], expectedFileData, @"Extracted data doesn't match original file (%@, %@)", testArchiveName, expectedFilename);
+        }
+    }
+}
+
+- (void)testExtractDataFromFiles_ArchiveOrder
+{
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSError *listError = nil;
+    NSArray<NSString*> *archiveOrder = [archive listFilenames:&listError];
+    XCTAssertNil(listError, @"Error listing filenames");
+    
+    NSArray<NSString*> *requestedFiles = [archiveOrder.reverseObjectEnumerator.allObjects arrayByAddingObject:archiveOrder.firstObject];
+    NSMutableArray<NSString*> *extractedFiles = [NSMutableArray array];
+    
+    NSError *error = nil;
+    BOOL success = [archive extractDataFromFiles:requestedFiles
+                                           error:&error
+                                          action:^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+                                              [extractedFiles addObject:fileInfo.filename];
+                                              XCTAssertEqual(fileData.length, fileInfo.uncompressedSize, @"Wrong amount of data extracted for %@", fileInfo.filename);
+                                          }];
+    
+    XCTAssertTrue(success, @"Failed to extract files");
+    XCTAssertNil(error, @"Error extracting files");
+    XCTAssertEqualObjects(extractedFiles, archiveOrder, @"Files weren't read once each, in the order they're stored");
+}
+
+- (void)testExtractDataFromFiles_FileNotFound
+{
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    __block NSUInteger actionCount = 0;
+    NSError *error = nil;
+    BOOL success = [archive extractDataFromFiles:@[@"Test File A.txt", @"Nonexistent File.txt"]
+                                           error:&error
+                                          action:^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+                                              actionCount++;
+                                          }];
+    
+    XCTAssertFalse(success, @"Extraction of a nonexistent file succeeded");
+    XCTAssertEqual(error.code, UZKErrorCodeFileNotFoundInArchive, @"Unexpected error code returned");
+    XCTAssertEqual(actionCount, 0U, @"Files were extracted before the missing one was reported");
+}
+
+- (void)testExtractData_ImplausibleUncompressedSize
+{
+    NSMutableData *archiveData = [NSMutableData dataWithContentsOfURL:self.testFileURLs[@"Test Archive.zip"]];
+    
+    // Claim the stored file A is 2 GB, in both its local header and its central directory record
+    uint32_t lyingSize = CFSwapInt32HostToLittle(0x7FFFFFFF);
+    const char centralDirectorySignature[] = {'P', 'K', 0x01, 0x02};
+    NSRange centralDirectoryRange = [archiveData rangeOfData:[NSData dataWithBytes:centralDirectorySignature length:4]
+                                                     options:(NSDataSearchOptions)0
+                                                       range:NSMakeRange(0, archiveData.length)];
+    XCTAssertNotEqual(centralDirectoryRange.location, (NSUInteger)NSNotFound, @"Central directory not found");
+    
+    [archiveData replaceBytesInRange:NSMakeRange(22, 4) withBytes:&lyingSize];
+    [archiveData replaceBytesInRange:NSMakeRange(centralDirectoryRange.location + 24, 4) withBytes:&lyingSize];
+    
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"Lying Header.zip"];
+    XCTAssertTrue([archiveData writeToURL:testArchiveURL atomically:YES], @"Failed to write modified archive");
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSError *error = nil;
+    NSData *data = [archive extractDataFromFile:@"Test File A.txt"
+                                          error:&error];
+    
+    XCTAssertNil(data, @"Data returned for file with an impossible uncompressed size");
+    XCTAssertNotNil(error, @"No error returned for file with an impossible uncompressed size");
+    XCTAssertEqual(error.code, UZKErrorCodeBadZipFile, @"Unexpected error code returned");
+}
+
 - (void)testExtractData_NoPassword
 {
     NSArray *testArchives = @[@"Test Archive (Password).zip"];
@@ -123,5 +360,86 @@
     XCTAssertEqual(error.code, UZKErrorCodeBadZipFile, @"Unexpected error code returned");
 }
 
+- (void)testPerformance_ExtractData_ReadBufferSize16KB
+{
+    [self measureExtractDataWithReadBufferSize:0];
+}
+
+- (void)testPerformance_ExtractData_ReadBufferSize256KB
+{
+    [self measureExtractDataWithReadBufferSize:256 * 1024];
+}
+
+- (void)testPerformance_ExtractData_ReadBufferSize1MB
+{
+    [self measureExtractDataWithReadBufferSize:1024 * 1024];
+}
+
+- (void)testPerformance_ExtractData_ReadBufferSize4MB
+{
+    [self measureExtractDataWithReadBufferSize:4 * 1024 * 1024];
+}
+
+- (void)testPerformance_ExtractData_Password
+{
+    NSUInteger fileSize = 32 * 1024 * 1024;
+    NSMutableData *randomData = [NSMutableData dataWithLength:fileSize];
+    arc4random_buf(randomData.mutableBytes, fileSize);
+    
+    NSURL *archiveURL = [self.tempDirectory URLByAppendingPathComponent:@"Decryption Benchmark.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL password:@"password" error:nil];
+    
+    NSError *writeError = nil;
+    BOOL writeSuccess = [archive writeData:randomData
+                                  filePath:@"Random.bin"
+                                  fileDate:nil
+                         compressionMethod:UZKCompressionMethodNone
+                                  password:@"password"
+                                     error:&writeError];
+    XCTAssertTrue(writeSuccess, @"Failed to write benchmark archive: %@", writeError);
+    
+    [self measureBlock:^{
+        NSError *error = nil;
+        NSData *extractedData = [archive extractDataFromFile:@"Random.bin"
+                                                       error:&error];
+        
+        XCTAssertNil(error, @"Error extracting encrypted data");
+        XCTAssertEqualObjects(extractedData, randomData, @"Incorrect data extracted");
+    }];
+}
+
+
+#pragma mark - Private methods
+
+
+- (void)measureExtractDataWithReadBufferSize:(NSUInteger)readBufferSize
+{
+    // Random data doesn't compress, so every byte of it has to be read from the archive
+    NSUInteger fileSize = 32 * 1024 * 1024;
+    NSMutableData *randomData = [NSMutableData dataWithLength:fileSize];
+    arc4random_buf(randomData.mutableBytes, fileSize);
+    
+    NSURL *archiveURL = [self.tempDirectory URLByAppendingPathComponent:
+                         [NSString stringWithFormat:@"Read Buffer Size %lu.zip", (unsigned long)readBufferSize]];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    
+    NSError *writeError = nil;
+    BOOL writeSuccess = [archive writeData:randomData
+                                  filePath:@"Random.bin"
+                                     error:&writeError];
+    XCTAssertTrue(writeSuccess, @"Failed to write benchmark archive: %@", writeError);
+    
+    archive.readBufferSize = readBufferSize;
+    
+    [self measureBlock:^{
+        NSError *error = nil;
+        NSData *extractedData = [archive extractDataFromFile:@"Random.bin"
+                                                       error:&error];
+        
+        XCTAssertNil(error, @"Error extracting data with a %lu byte read buffer", (unsigned long)readBufferSize);
+        XCTAssertEqual(extractedData.length, fileSize, @"Incorrect amount of data extracted");
+    }];
+}
+
 
 @end
@@ -73,6 +73,105 @@
     }
 }
 
+- (void)testExtractFiles_Parallel
+{
+    NSArray *testArchives = @[@"Test Archive.zip",
+                              @"Test Archive (Password).zip"];
+    
+    NSSet *expectedFileSet = self.nonZipTestFilePaths;
+    NSArray *expectedFiles = [expectedFileSet.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    
+    NSFileManager *fm = [NSFileManager defaultManager];
+    
+    for (NSString *testArchiveName in testArchives) {
+        NSURL *testArchiveURL = self.testFileURLs[testArchiveName];
+        NSString *extractDirectory = [self randomDirectoryWithPrefix:
+                                      [testArchiveName stringByDeletingPathExtension]];
+        NSURL *extractURL = [self.tempDirectory URLByAppendingPathComponent:extractDirectory];
+        
+        NSString *password = ([testArchiveName rangeOfString:@"Password"].location != NSNotFound
+                              ? @"password"
+                              : nil);
+        UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL password:password error:nil];
+        archive.maxConcurrentExtractions = 0;
+        
+        NSError *error = nil;
+        BOOL success = [archive extractFilesTo:extractURL.path
+                                     overwrite:NO
+                                         error:&error];
+        
+        XCTAssertNil(error, @"Error returned by extractFilesTo:overWrite:error:");
+        XCTAssertTrue(success, @"Failed to extract %@ to %@", testArchiveName, extractURL);
+        
+        error = nil;
+        NSArray *extractedFiles = [[fm contentsOfDirectoryAtPath:extractURL.path
+                                                           error:&error]
+                                   sortedArrayUsingSelector:@selector(compare:)];
+        
+        XCTAssertNil(error, @"Failed to list contents of extract directory: %@", extractURL);
+        
+        XCTAssertNotNil(extractedFiles, @"No list of files returned");
+        XCTAssertEqual(extractedFiles.count, expectedFileSet.count,
+                       @"Incorrect number of files listed in archive");
+        
+        for (NSUInteger i = 0; i < extractedFiles.count; i++) {
+            NSString *extractedFilename = extractedFiles[i];
+            NSString *expectedFilename = expectedFiles[i];
+            
+            XCTAssertEqualObjects(extractedFilename, expectedFilename, @"Incorrect filename listed");
+            
+            NSURL *extractedFileURL = [extractURL URLByAppendingPathComponent:extractedFilename];
+            NSURL *expectedFileURL = self.testFileURLs[expectedFilename];
+            
+            NSData *extractedFileData = [NSData dataWithContentsOfURL:extractedFileURL];
+            NSData *expectedFileData = [NSData dataWithContentsOfURL:expectedFileURL];
+            
+            XCTAssertTrue([expectedFileData isEqualToData:extractedFileData], @"Data in file doesn't match source");
+        }
+    }
+}
+
+- (void)testExtractFiles_ExistingFileNoOverwrite
+{
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    NSData *existingData = [@"Existing data" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    NSFileManager *fm = [NSFileManager defaultManager];
+    
+    // Serial and parallel extractions should stop at the same place
+    for (NSNumber *concurrency in @[@1, @4]) {
+        UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+        archive.maxConcurrentExtractions = concurrency.unsignedIntegerValue;
+        
+        NSArray<NSString*> *filenames = [archive listFilenames:nil];
+        XCTAssertGreaterThan(filenames.count, (NSUInteger)2, @"Test archive needs files after the existing one");
+        NSString *existingFilename = filenames[1];
+        
+        NSString *extractDirectory = [self randomDirectoryWithPrefix:@"ExistingFile"];
+        NSURL *extractURL = [self.tempDirectory URLByAppendingPathComponent:extractDirectory];
+        [fm createDirectoryAtURL:extractURL withIntermediateDirectories:YES attributes:nil error:nil];
+        
+        NSURL *existingFileURL = [extractURL URLByAppendingPathComponent:existingFilename];
+        XCTAssertTrue([existingData writeToURL:existingFileURL atomically:YES], @"Failed to write existing file");
+        
+        NSError *error = nil;
+        BOOL success = [archive extractFilesTo:extractURL.path
+                                     overwrite:NO
+                                         error:&error];
+        
+        XCTAssertTrue(success, @"Extraction failed with %@ concurrent extractions", concurrency);
+        XCTAssertNil(error, @"Error returned with %@ concurrent extractions: %@", concurrency, error);
+        
+        NSArray *extractedFiles = [[fm contentsOfDirectoryAtPath:extractURL.path error:nil]
+                                   sortedArrayUsingSelector:@selector(compare:)];
+        NSArray *expectedFiles = [@[filenames[0], existingFilename] sortedArrayUsingSelector:@selector(compare:)];
+        
+        XCTAssertEqualObjects(extractedFiles, expectedFiles, @"Wrong files extracted with %@ concurrent extractions", concurrency);
+        XCTAssertEqualObjects([NSData dataWithContentsOfURL:existingFileURL], existingData,
+                              @"Existing file overwritten with %@ concurrent extractions", concurrency);
+    }
+}
+
 - (void)testExtractFiles_Unicode
 {
     NSSet *expectedFileSet = self.nonZipUnicodeFilePaths;
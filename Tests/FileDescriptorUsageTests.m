@@ -165,6 +165,35 @@
     
     XCTAssertEqualWithAccuracy(initialFileCount, finalFileCount, 5, @"File descriptors were left open");
 }
+
+- (void)testFileDescriptorUsage_IdleHandleTimeout
+{
+    NSInteger initialFileCount = [self numberOfOpenFileHandles];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:self.testFileURLs[@"Test Archive.zip"] error:nil];
+    archive.idleHandleTimeout = 1;
+    
+    NSError *error = nil;
+    NSArray *fileList = [archive listFilenames:&error];
+    XCTAssertNotNil(fileList, @"No filenames returned");
+    
+    for (NSString *fileName in fileList) {
+        NSData *fileData = [archive extractDataFromFile:fileName
+                                                  error:&error];
+        XCTAssertNotNil(fileData, @"No data returned");
+        XCTAssertNil(error, @"Error extracting data");
+    }
+    
+    NSInteger idleFileCount = [self numberOfOpenFileHandles];
+    XCTAssertGreaterThan(idleFileCount, initialFileCount, @"Idle handle wasn't kept open between reads");
+    
+    [NSThread sleepForTimeInterval:2];
+    
+    NSInteger finalFileCount = [self numberOfOpenFileHandles];
+    
+    XCTAssertLessThan(finalFileCount, idleFileCount, @"Idle handle wasn't closed after its timeout");
+    XCTAssertEqualWithAccuracy(initialFileCount, finalFileCount, 5, @"File descriptors were left open");
+}
 #endif
 
 
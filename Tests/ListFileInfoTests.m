@@ -8,6 +8,7 @@
 
 #import "UZKArchiveTestCase.h"
 #import "UnzipKit.h"
+#import "unzip.h"
 
 @interface ListFileInfoTests : UZKArchiveTestCase
 @end
@@ -166,6 +167,82 @@
     }
 }
 
+- (void)testListFileInfo_ManyEntries
+{
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"ManyEntries.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSUInteger entryCount = 500;
+    NSMutableArray<NSString*> *expectedFilenames = [NSMutableArray array];
+    NSMutableArray<NSData*> *expectedData = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < entryCount; i++) {
+        NSString *filename = [NSString stringWithFormat:@"Folder %lu/File %lu.txt", (unsigned long)(i / 50), (unsigned long)i];
+        NSData *data = [[NSString stringWithFormat:@"Contents of file %lu", (unsigned long)i] dataUsingEncoding:NSUTF8StringEncoding];
+        
+        NSError *writeError = nil;
+        BOOL writeSuccess = [archive writeData:data
+                                      filePath:filename
+                                      fileDate:nil
+                              posixPermissions:0644
+                             compressionMethod:(i % 2) ? UZKCompressionMethodNone : UZKCompressionMethodDefault
+                                      password:nil
+                                     overwrite:NO
+                                         error:&writeError];
+        XCTAssertTrue(writeSuccess, @"Failed to write entry %lu", (unsigned long)i);
+        XCTAssertNil(writeError, @"Error writing entry %lu", (unsigned long)i);
+        
+        [expectedFilenames addObject:filename];
+        [expectedData addObject:data];
+    }
+    
+    NSError *error = nil;
+    NSArray<UZKFileInfo*> *filesInArchive = [archive listFileInfo:&error];
+    
+    XCTAssertNil(error, @"Error returned by listFileInfo");
+    XCTAssertEqual(filesInArchive.count, entryCount, @"Incorrect number of files listed in archive");
+    
+    for (NSUInteger i = 0; i < filesInArchive.count; i++) {
+        UZKFileInfo *fileInfo = filesInArchive[i];
+        NSData *data = expectedData[i];
+        
+        XCTAssertEqualObjects(fileInfo.filename, expectedFilenames[i], @"Incorrect filename");
+        XCTAssertEqual(fileInfo.uncompressedSize, (unsigned long long)data.length, @"Incorrect uncompressed size for %@", fileInfo.filename);
+        XCTAssertEqual(fileInfo.CRC, (NSUInteger)crc32(0, data.bytes, (uInt)data.length), @"Incorrect CRC for %@", fileInfo.filename);
+    }
+}
+
+- (void)testListFileInfo_ArchiveModifiedByAnotherInstance
+{
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    UZKArchive *readingArchive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    UZKArchive *writingArchive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSError *error = nil;
+    NSArray<UZKFileInfo*> *filesBefore = [readingArchive listFileInfo:&error];
+    
+    XCTAssertNil(error, @"Error returned by listFileInfo before modification");
+    XCTAssertEqual(filesBefore.count, self.nonZipTestFilePaths.count, @"Incorrect number of files listed in archive");
+    
+    NSString *newFilename = @"New File.txt";
+    NSData *newFileData = [@"Written by another instance" dataUsingEncoding:NSUTF8StringEncoding];
+    BOOL writeSuccess = [writingArchive writeData:newFileData filePath:newFilename error:&error];
+    
+    XCTAssertTrue(writeSuccess, @"Failed to write new file to archive");
+    XCTAssertNil(error, @"Error writing new file to archive");
+    
+    NSArray<UZKFileInfo*> *filesAfter = [readingArchive listFileInfo:&error];
+    
+    XCTAssertNil(error, @"Error returned by listFileInfo after modification");
+    XCTAssertEqual(filesAfter.count, filesBefore.count + 1, @"Stale central directory returned after archive was modified");
+    XCTAssertEqualObjects(filesAfter.lastObject.filename, newFilename, @"New file not listed");
+    
+    NSData *extractedData = [readingArchive extractDataFromFile:newFilename error:&error];
+    
+    XCTAssertNil(error, @"Error extracting newly written file");
+    XCTAssertEqualObjects(extractedData, newFileData, @"Incorrect data extracted for newly written file");
+}
+
 - (void)testListFileInfo_InvalidArchive
 {
     UZKArchive *archive = [[UZKArchive alloc] initWithURL:self.testFileURLs[@"Test File A.txt"] error:nil];
@@ -8,6 +8,7 @@
 
 #import "UZKArchiveTestCase.h"
 #import "UnzipKit.h"
+#import "unzip.h"
 
 @interface ListFilenamesTests : UZKArchiveTestCase
 @end
@@ -130,5 +131,31 @@
     XCTAssertEqual(error.code, UZKErrorCodeBadZipFile, @"Unexpected error code returned");
 }
 
+- (void)testLocateFileIndexed
+{
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    unzFile file = unzOpen(testArchiveURL.fileSystemRepresentation);
+    XCTAssertTrue(file != NULL, @"Failed to open test archive");
+    
+    NSArray *expectedFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    
+    for (NSString *expectedFilename in expectedFiles.reverseObjectEnumerator) {
+        int err = unzLocateFileIndexed(file, expectedFilename.UTF8String, 1);
+        XCTAssertEqual(err, UNZ_OK, @"Failed to locate %@", expectedFilename);
+        
+        char currentFilename[256];
+        err = unzGetCurrentFileInfo64(file, NULL, currentFilename, sizeof(currentFilename), NULL, 0, NULL, 0);
+        XCTAssertEqual(err, UNZ_OK, @"Failed to get info for %@", expectedFilename);
+        XCTAssertEqualObjects(@(currentFilename), expectedFilename, @"Wrong file located");
+    }
+    
+    const char *differentCase = [expectedFiles.firstObject uppercaseString].UTF8String;
+    XCTAssertEqual(unzLocateFileIndexed(file, differentCase, 1), UNZ_END_OF_LIST_OF_FILE, @"Case-sensitive lookup ignored case");
+    XCTAssertEqual(unzLocateFileIndexed(file, differentCase, 2), UNZ_OK, @"Case-insensitive lookup failed");
+    XCTAssertEqual(unzLocateFileIndexed(file, "Missing File.txt", 1), UNZ_END_OF_LIST_OF_FILE, @"Missing file located");
+    
+    XCTAssertEqual(unzClose(file), UNZ_OK, @"Failed to close test archive");
+}
+
 
 @end
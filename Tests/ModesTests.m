@@ -32,6 +32,23 @@
     XCTAssertNil(readError, @"readError was also non-nil");
 }
 
+- (void)testModes_WriteWhileReading_ConcurrentReads
+{
+    NSURL *testArchiveURL = self.testFileURLs[@"Test Archive.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    archive.allowsConcurrentReads = YES;
+    NSError *readError = nil;
+    
+    [archive performOnDataInArchive:^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+        NSError *writeError = nil;
+        [archive writeData:fileData filePath:@"newPath.txt" error:&writeError];
+        XCTAssertNotNil(writeError, @"Write operation during a read succeeded");
+        XCTAssertEqual(writeError.code, UZKErrorCodeMixedModeAccess, @"Wrong error code returned");
+    } error:&readError];
+    
+    XCTAssertNil(readError, @"readError was also non-nil");
+}
+
 - (void)testModes_NestedReads
 {
     NSArray *expectedFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
@@ -185,6 +185,54 @@
         }
     }];
 }
+
+- (void)testMultithreading_ConcurrentReads {
+    NSURL *largeArchiveURL = [self largeArchive];
+    
+    UZKArchive *serialArchive = [[UZKArchive alloc] initWithURL:largeArchiveURL error:nil];
+    NSMutableDictionary<NSString*, NSData*> *expectedData = [NSMutableDictionary dictionary];
+    
+    NSError *serialError = nil;
+    BOOL serialSuccess = [serialArchive performOnDataInArchive:^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+        expectedData[fileInfo.filename] = fileData;
+    } error:&serialError];
+    
+    XCTAssertTrue(serialSuccess, @"Failed to read archive serially");
+    XCTAssertNil(serialError, @"Error reading archive serially");
+    
+    UZKArchive *largeArchive = [[UZKArchive alloc] initWithURL:largeArchiveURL error:nil];
+    largeArchive.allowsConcurrentReads = YES;
+    
+    NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+    queue.maxConcurrentOperationCount = 3;
+    queue.suspended = YES;
+    
+    for (NSString *name in @[@"A", @"B", @"C"]) {
+        XCTestExpectation *expectation = [self expectationWithDescription:[NSString stringWithFormat:@"%@ finished", name]];
+        
+        [queue addOperationWithBlock:^{
+            NSError *error = nil;
+            __block NSUInteger fileCount = 0;
+            
+            [largeArchive performOnDataInArchive:^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+                fileCount++;
+                XCTAssertEqualObjects(fileData, expectedData[fileInfo.filename], @"Data read concurrently doesn't match (%@)", name);
+            } error:&error];
+            
+            XCTAssertNil(error, @"Failed enumeration %@", name);
+            XCTAssertEqual(fileCount, expectedData.count, @"Wrong number of files enumerated (%@)", name);
+            [expectation fulfill];
+        }];
+    }
+    
+    queue.suspended = NO;
+    
+    [self waitForExpectationsWithTimeout:30 handler:^(NSError *error) {
+        if (error) {
+            UZKLogError("Error while waiting for expectations: %@", error);
+        }
+    }];
+}
 #endif
 
 
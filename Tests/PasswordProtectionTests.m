@@ -106,6 +106,37 @@
     XCTAssertTrue(archive.validatePassword, @"validatePassword = NO when password supplied");
 }
 
+- (void)testValidatePassword_SmallestFileNotEncrypted
+{
+    NSArray *testFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"testValidatePassword_SmallestFileNotEncrypted.zip"];
+    
+    UZKArchive *writeArchive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    for (NSString *testFile in testFiles) {
+        NSData *fileData = [NSData dataWithContentsOfURL:self.testFileURLs[testFile]];
+        
+        NSError *writeError = nil;
+        BOOL result = [writeArchive writeData:(NSData * _Nonnull)fileData
+                                     filePath:testFile
+                                     fileDate:nil
+                            compressionMethod:UZKCompressionMethodDefault
+                                     password:(fileData.length < 1024) ? nil : @"111111"
+                                        error:&writeError];
+        
+        XCTAssertTrue(result, @"Error writing archive data");
+        XCTAssertNil(writeError, @"Error writing to file %@: %@", testFile, writeError);
+    }
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    archive.password = @"wrong";
+    XCTAssertFalse(archive.validatePassword, @"validatePassword = YES when wrong password supplied");
+    
+    archive.password = @"111111";
+    XCTAssertTrue(archive.validatePassword, @"validatePassword = NO when correct password supplied");
+}
+
 #if !TARGET_OS_IPHONE
 - (void)testValidatePassword_LargeFile
 {
@@ -125,4 +156,177 @@
 }
 #endif
 
+
+
+#pragma mark - AES Encryption
+
+
+- (void)testExtractData_AES
+{
+    NSURL *archiveURL = self.testFileURLs[@"Test Archive (AES).zip"];
+    NSArray *testFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    
+    XCTAssertTrue(archive.isPasswordProtected, @"isPasswordProtected = NO for AES-encrypted archive");
+    
+    NSError *error = nil;
+    NSData *noPasswordData = [archive extractDataFromFile:testFiles.firstObject error:&error];
+    
+    XCTAssertNil(noPasswordData, @"Data returned without a password");
+    XCTAssertEqual(error.code, UZKErrorCodeInvalidPassword, @"Unexpected error code without a password");
+    
+    archive.password = @"password";
+    
+    for (NSString *testFile in testFiles) {
+        error = nil;
+        NSData *extractedData = [archive extractDataFromFile:testFile error:&error];
+        
+        XCTAssertNil(error, @"Error extracting %@: %@", testFile, error);
+        XCTAssertEqualObjects(extractedData, [NSData dataWithContentsOfURL:self.testFileURLs[testFile]],
+                              @"Extracted data doesn't match original file %@", testFile);
+    }
+}
+
+- (void)testWriteData_AES256
+{
+    NSArray *testFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"testWriteData_AES256.zip"];
+    NSString *password = @"111111";
+    
+    UZKArchive *writeArchive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    writeArchive.encryptionMethod = UZKEncryptionMethodAES256;
+    
+    for (NSString *testFile in testFiles) {
+        NSError *writeError = nil;
+        BOOL result = [writeArchive writeData:(NSData * _Nonnull)[NSData dataWithContentsOfURL:self.testFileURLs[testFile]]
+                                     filePath:testFile
+                                     fileDate:nil
+                            compressionMethod:UZKCompressionMethodDefault
+                                     password:password
+                                        error:&writeError];
+        
+        XCTAssertTrue(result, @"Error writing archive data");
+        XCTAssertNil(writeError, @"Error writing to file %@: %@", testFile, writeError);
+    }
+    
+    UZKArchive *readArchive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    XCTAssertTrue(readArchive.isPasswordProtected, @"isPasswordProtected = NO for AES-encrypted archive");
+    
+    readArchive.password = @"wrong";
+    
+    NSError *wrongPasswordError = nil;
+    NSData *wrongPasswordData = [readArchive extractDataFromFile:testFiles.firstObject error:&wrongPasswordError];
+    
+    XCTAssertNil(wrongPasswordData, @"Data returned for the wrong password");
+    XCTAssertEqual(wrongPasswordError.code, UZKErrorCodeInvalidPassword, @"Unexpected error code for the wrong password");
+    
+    readArchive.password = password;
+    
+    for (NSString *testFile in testFiles) {
+        NSError *readError = nil;
+        NSData *extractedData = [readArchive extractDataFromFile:testFile error:&readError];
+        
+        XCTAssertNil(readError, @"Error extracting %@: %@", testFile, readError);
+        XCTAssertEqualObjects(extractedData, [NSData dataWithContentsOfURL:self.testFileURLs[testFile]],
+                              @"Extracted data doesn't match original file %@", testFile);
+    }
+    
+    XCTAssertTrue(readArchive.checkDataIntegrity, @"Data integrity check failed for AES-encrypted archive");
+}
+
+- (void)testValidatePassword_AES
+{
+    NSURL *archiveURL = self.testFileURLs[@"Test Archive (AES).zip"];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    
+    XCTAssertFalse(archive.validatePassword, @"validatePassword = YES when no password supplied");
+    
+    archive.password = @"wrong";
+    XCTAssertFalse(archive.validatePassword, @"validatePassword = YES when wrong password supplied");
+    
+    archive.password = @"password";
+    XCTAssertTrue(archive.validatePassword, @"validatePassword = NO when correct password supplied");
+}
+
+- (void)testExtractData_AE2
+{
+    NSURL *archiveURL = self.testFileURLs[@"Test Archive (AE-2).zip"];
+    NSDictionary<NSString*, NSString*> *expectedContents = @{@"Short Text File.txt": @"Hello, AE-2!\n",
+                                                             @"Tiny Text File.txt": @"Tiny\n"};
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    
+    XCTAssertTrue(archive.isPasswordProtected, @"isPasswordProtected = NO for AE-2 archive");
+    
+    archive.password = @"wrong";
+    
+    NSError *error = nil;
+    NSData *wrongPasswordData = [archive extractDataFromFile:@"Tiny Text File.txt" error:&error];
+    
+    XCTAssertNil(wrongPasswordData, @"Data returned for the wrong password");
+    XCTAssertEqual(error.code, UZKErrorCodeInvalidPassword, @"Unexpected error code for the wrong password");
+    
+    archive.password = @"password";
+    
+    for (NSString *filename in expectedContents) {
+        error = nil;
+        NSData *extractedData = [archive extractDataFromFile:filename error:&error];
+        
+        XCTAssertNil(error, @"Error extracting %@ from AE-2 archive: %@", filename, error);
+        XCTAssertEqualObjects(extractedData, [expectedContents[filename] dataUsingEncoding:NSUTF8StringEncoding],
+                              @"Extracted data doesn't match original file %@", filename);
+    }
+}
+
+- (void)testExtractData_AE2_ModifiedData
+{
+    NSURL *archiveURL = self.testFileURLs[@"Modified Data Archive (AE-2).zip"];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL password:@"password" error:nil];
+    
+    NSError *error = nil;
+    NSData *extractedData = [archive extractDataFromFile:@"Short Text File.txt" error:&error];
+    
+    XCTAssertNil(extractedData, @"Data returned for an entry that fails its authentication code check");
+    XCTAssertNotNil(error, @"No error returned for an entry that fails its authentication code check");
+}
+
+- (void)testValidatePassword_AE2
+{
+    NSURL *archiveURL = self.testFileURLs[@"Test Archive (AE-2).zip"];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    
+    XCTAssertFalse(archive.validatePassword, @"validatePassword = YES when no password supplied");
+    
+    archive.password = @"wrong";
+    XCTAssertFalse(archive.validatePassword, @"validatePassword = YES when wrong password supplied");
+    
+    archive.password = @"password";
+    XCTAssertTrue(archive.validatePassword, @"validatePassword = NO when correct password supplied");
+}
+
+- (void)testPerformance_ValidatePasswordAndExtract_AES
+{
+    NSURL *archiveURL = self.testFileURLs[@"Test Archive (AES).zip"];
+    NSArray *testFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:archiveURL error:nil];
+    archive.password = @"password";
+    
+    [self measureBlock:^{
+        XCTAssertTrue(archive.validatePassword, @"validatePassword = NO when correct password supplied");
+        
+        for (NSString *testFile in testFiles) {
+            NSError *error = nil;
+            NSData *extractedData = [archive extractDataFromFile:testFile error:&error];
+            
+            XCTAssertNotNil(extractedData, @"Error extracting %@: %@", testFile, error);
+        }
+    }];
+}
+
 @end
@@ -519,6 +519,72 @@ static NSUInteger observerCallCount;
     XCTAssertEqual(self.fractionsCompletedReported.count, expectedProgressUpdates, @"Incorrect number of progress updates");
 }
 
+- (void)testProgressCancellation_ExtractData_IdleHandle {
+    NSURL *largeArchiveURL = [self largeArchive];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:largeArchiveURL error:nil];
+    archive.idleHandleTimeout = 60;
+    NSString *firstFile = [[archive listFilenames:nil] firstObject];
+    
+    NSProgress *extractFileProgress = [NSProgress progressWithTotalUnitCount:1];
+    [extractFileProgress becomeCurrentWithPendingUnitCount:1];
+    
+    NSString *observedSelector = NSStringFromSelector(@selector(fractionCompleted));
+    
+    [extractFileProgress addObserver:self
+                          forKeyPath:observedSelector
+                             options:NSKeyValueObservingOptionInitial
+                             context:CancelContext];
+    
+    NSError *extractError = nil;
+    NSData *data = [archive extractDataFromFile:firstFile error:&extractError];
+    
+    [extractFileProgress resignCurrent];
+    [extractFileProgress removeObserver:self forKeyPath:observedSelector];
+    
+    XCTAssertEqual(extractError.code, UZKErrorCodeUserCancelled, @"Incorrect error code returned from user cancellation");
+    XCTAssertNil(data, @"extractData didn't return nil when cancelled");
+    
+    NSError *retryError = nil;
+    NSData *retryData = [archive extractDataFromFile:firstFile error:&retryError];
+    
+    XCTAssertNil(retryError, @"Error extracting data with the idle handle left by a cancelled extraction: %@", retryError);
+    XCTAssertNotNil(retryData, @"No data extracted with the idle handle left by a cancelled extraction");
+}
+
+- (void)testProgressCancellation_ExtractDataFromFiles_IdleHandle {
+    NSURL *largeArchiveURL = [self largeArchive];
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:largeArchiveURL error:nil];
+    archive.idleHandleTimeout = 60;
+    NSArray<NSString*> *filenames = [archive listFilenames:nil];
+    
+    NSProgress *extractFilesProgress = [NSProgress progressWithTotalUnitCount:1];
+    [extractFilesProgress becomeCurrentWithPendingUnitCount:1];
+    
+    NSString *observedSelector = NSStringFromSelector(@selector(fractionCompleted));
+    
+    [extractFilesProgress addObserver:self
+                           forKeyPath:observedSelector
+                              options:NSKeyValueObservingOptionInitial
+                              context:CancelContext];
+    
+    NSError *extractError = nil;
+    NSDictionary<NSString*, NSData*> *data = [archive extractDataFromFiles:filenames error:&extractError];
+    
+    [extractFilesProgress resignCurrent];
+    [extractFilesProgress removeObserver:self forKeyPath:observedSelector];
+    
+    XCTAssertEqual(extractError.code, UZKErrorCodeUserCancelled, @"Incorrect error code returned from user cancellation");
+    XCTAssertNil(data, @"extractDataFromFiles didn't return nil when cancelled");
+    
+    NSError *retryError = nil;
+    NSDictionary<NSString*, NSData*> *retryData = [archive extractDataFromFiles:filenames error:&retryError];
+    
+    XCTAssertNil(retryError, @"Error extracting data with the idle handle left by a cancelled extraction: %@", retryError);
+    XCTAssertEqual(retryData.count, filenames.count, @"Not all files extracted with the idle handle left by a cancelled extraction");
+}
+
 - (void)testProgressCancellation_ExtractBufferedData {
     NSURL *largeArchiveURL = [self largeArchive];
     
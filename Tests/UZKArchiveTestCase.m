@@ -53,6 +53,9 @@ BOOL unzipkitIsAtLeast10_13SDK;
     NSArray *testFiles = @[
                            @"Test Archive.zip",
                            @"Test Archive (Password).zip",
+                           @"Test Archive (AES).zip",
+                           @"Test Archive (AE-2).zip",
+                           @"Modified Data Archive (AE-2).zip",
                            @"L'incertain.zip",
                            @"Aces.zip",
                            @"Comments Archive.zip",
@@ -73,6 +73,58 @@
     } error:&readError];
 }
 
+- (void)testWriteInfoBuffer_ConcurrentCompression
+{
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"WriteIntoBufferTest_ConcurrentCompression.zip"];
+    NSString *testFilename = @"Concurrent Compression.txt";
+    
+    NSMutableData *fileData = [NSMutableData data];
+    for (NSUInteger i = 0; i < 50000; i++) {
+        NSString *line = [NSString stringWithFormat:@"Line %lu of a file large enough to be split into several blocks\n", (unsigned long)i];
+        [fileData appendData:(NSData * _Nonnull)[line dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    archive.maxConcurrentCompressions = 4;
+    
+    unsigned int bufferSize = 10000; //Arbitrary, and not a multiple of the block size
+    const void *bytes = fileData.bytes;
+    
+    NSError *writeError = nil;
+    BOOL result = [archive writeIntoBuffer:testFilename
+                                  fileDate:nil
+                         compressionMethod:UZKCompressionMethodDefault
+                                 overwrite:YES
+                                     error:&writeError
+                                     block:
+                   ^BOOL(BOOL(^writeData)(const void *bytes, unsigned int length), NSError**(actionError)) {
+                       for (NSUInteger i = 0; i < fileData.length; i += bufferSize) {
+                           unsigned int size = (unsigned int)MIN(fileData.length - i, bufferSize);
+                           BOOL writeSuccess = writeData(&bytes[i], size);
+                           XCTAssertTrue(writeSuccess, @"Failed to write buffered data");
+                       }
+                       
+                       return YES;
+                   }];
+    
+    XCTAssertTrue(result, @"Error writing archive data");
+    XCTAssertNil(writeError, @"Error writing to file %@: %@", testFilename, writeError);
+    
+    NSError *listError = nil;
+    UZKFileInfo *fileInfo = [archive listFileInfo:&listError].firstObject;
+    
+    XCTAssertNil(listError, @"Error listing file info: %@", listError);
+    XCTAssertEqual(fileInfo.uncompressedSize, fileData.length, @"Incorrect uncompressed size in archive");
+    XCTAssertLessThan(fileInfo.compressedSize, fileData.length / 4, @"Data not compressed");
+    XCTAssertEqual(fileInfo.CRC, crc32(0, fileData.bytes, (unsigned int)fileData.length), @"CRC of written data is incorrect");
+    
+    NSError *readError = nil;
+    NSData *extractedData = [archive extractDataFromFile:testFilename error:&readError];
+    
+    XCTAssertNil(readError, @"Error extracting data: %@", readError);
+    XCTAssertEqualObjects(extractedData, fileData, @"Data extracted doesn't match what was written");
+}
+
 - (void)testWriteInfoBuffer_Failure
 {
     NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"WriteIntoBufferTest_Failure.zip"];
@@ -333,6 +333,94 @@ class WriteDataTests: UZKArchiveTestCase {
         }
     }
     
+    func testWriteData_OverwriteByAppending() {
+        let testFilePaths = [String](nonZipTestFilePaths as! Set<String>).sorted(by: <)
+        let testArchiveURL = tempDirectory.appendingPathComponent("OverwriteByAppendingTest.zip")
+        let archive = try! UZKArchive(url: testArchiveURL)
+        archive.overwritesByAppending = true
+        
+        var testFileData = [String: Data]()
+        
+        for testFilePath in testFilePaths {
+            let fileData = try! Data(contentsOf: testFileURLs[testFilePath] as! URL)
+            testFileData[testFilePath] = fileData
+            
+            try! archive.write(fileData, filePath: testFilePath, fileDate: nil,
+                               compressionMethod: .default, password: nil)
+        }
+        
+        let overwrittenPath = testFilePaths[0]
+        var lastFileSize = try! FileManager.default.attributesOfItem(atPath: testArchiveURL.path)[.size] as! UInt64
+        
+        for i in 0..<3 {
+            let newData = "Overwritten \(i) times".data(using: .utf8)!
+            testFileData[overwrittenPath] = newData
+            
+            do {
+                try archive.write(newData, filePath: overwrittenPath, fileDate: nil,
+                                  compressionMethod: .default, password: nil, overwrite: true)
+            } catch let error as NSError {
+                XCTFail("Error overwriting \(overwrittenPath): \(error)")
+            }
+            
+            let fileSize = try! FileManager.default.attributesOfItem(atPath: testArchiveURL.path)[.size] as! UInt64
+            XCTAssertGreaterThan(fileSize, lastFileSize, "Overwritten data wasn't left in the archive")
+            lastFileSize = fileSize
+        }
+        
+        let expectedFilePaths = Array(testFilePaths.dropFirst()) + [overwrittenPath]
+        XCTAssertEqual(try! archive.listFilenames(), expectedFilePaths, "Overwritten file not moved to the end of the archive")
+        
+        for filePath in expectedFilePaths {
+            XCTAssertEqual(try! archive.extractData(fromFile: filePath), testFileData[filePath], "Incorrect data for \(filePath)")
+        }
+        
+        try! archive.compactArchive()
+        
+        let compactedSize = try! FileManager.default.attributesOfItem(atPath: testArchiveURL.path)[.size] as! UInt64
+        XCTAssertLessThan(compactedSize, lastFileSize, "Archive not compacted")
+        XCTAssertEqual(try! archive.listFilenames(), expectedFilePaths, "Files changed by compaction")
+        
+        for filePath in expectedFilePaths {
+            XCTAssertEqual(try! archive.extractData(fromFile: filePath), testFileData[filePath], "Incorrect data for \(filePath) after compaction")
+        }
+        
+        #if os(OSX)
+        // Read with the unzip command line tool
+        XCTAssertTrue(extractArchive(testArchiveURL, password: nil), "Failed to extract the archive on the command line")
+        #endif
+    }
+    
+    func testWriteData_ConcurrentCompression() {
+        let testArchiveURL = tempDirectory.appendingPathComponent("ConcurrentCompressionTest.zip")
+        let testFilename = "Concurrent Compression.txt"
+        
+        var testFileText = ""
+        for i in 0..<50_000 {
+            testFileText += "Line \(i) of a file large enough to be split into several blocks\n"
+        }
+        let testFileData = testFileText.data(using: .utf8)!
+        let expectedCRC = crc32(0, (testFileData as NSData).bytes.bindMemory(to: Bytef.self, capacity: testFileData.count), uInt(testFileData.count))
+        
+        let archive = try! UZKArchive(url: testArchiveURL)
+        archive.maxConcurrentCompressions = 4
+        
+        do {
+            try archive.write(testFileData, filePath: testFilename, fileDate: nil,
+                              compressionMethod: .default, password: nil)
+        } catch let error as NSError {
+            XCTFail("Error writing to file \(testFilename): \(error)")
+        }
+        
+        let fileInfo = try! archive.listFileInfo().first!
+        XCTAssertEqual(fileInfo.uncompressedSize, UInt64(testFileData.count), "Incorrect uncompressed size in archive")
+        XCTAssertLessThan(fileInfo.compressedSize, fileInfo.uncompressedSize / 4, "Data not compressed")
+        XCTAssertEqual(fileInfo.crc, expectedCRC, "CRC of written data is incorrect")
+        
+        let extractedData = try! archive.extractData(fromFile: testFilename)
+        XCTAssertEqual(extractedData, testFileData, "Data extracted doesn't match what was written")
+    }
+    
 //    func testWriteData_ManyFiles_MemoryUsage_ForProfiling() {
 //        let testArchiveURL = tempDirectory.appendingPathComponent("ManyFilesMemoryUsageTest.zip")
 //        let testFilename = nonZipTestFilePaths.first as! String
@@ -375,6 +463,36 @@ class WriteDataTests: UZKArchiveTestCase {
         XCTAssertEqual(actualDate, expectedDate, accuracy: 30, "Incorrect default date value written to file")
     }
     
+    func testPerformance_WriteData_Password() {
+        measureWriteData(password: "password")
+    }
+    
+    func testPerformance_WriteData_NoPassword() {
+        measureWriteData(password: nil)
+    }
+    
+    func measureWriteData(password: String?) {
+        // Random data doesn't compress, so every byte of it goes through the encryption
+        let fileSize = 32 * 1024 * 1024
+        var randomData = Data(count: fileSize)
+        randomData.withUnsafeMutableBytes { arc4random_buf($0.baseAddress, fileSize) }
+        
+        var iteration = 0
+        
+        measure {
+            iteration += 1
+            let testArchiveURL = self.tempDirectory.appendingPathComponent("WriteBenchmark \(password != nil) \(iteration).zip")
+            let archive = try! UZKArchive(url: testArchiveURL)
+            
+            do {
+                try archive.write(randomData, filePath: "Random.bin", fileDate: nil,
+                                  compressionMethod: .none, password: password)
+            } catch let error as NSError {
+                XCTFail("Error writing benchmark data: \(error)")
+            }
+        }
+    }
+    
     #if os(OSX)
     func testWriteData_PasswordProtected() {
         let testFilePaths = [String](nonZipTestFilePaths as! Set<String>).sorted(by: <)
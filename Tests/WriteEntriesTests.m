@@ -0,0 +1,202 @@
+//
+//  WriteEntriesTests.m
+//  UnzipKit
+//
+//
+
+#import "UZKArchiveTestCase.h"
+#import "zip.h"
+#import "UnzipKit.h"
+#import "UZKWriteEntry_Private.h"
+
+@interface WriteEntriesTests : UZKArchiveTestCase
+@end
+
+@implementation WriteEntriesTests
+
+
+- (void)testWriteEntries
+{
+    NSArray<NSString*> *testFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    NSDate *testDate = [[UZKArchiveTestCase dateFormatter] dateFromString:@"12/20/2014 9:35 AM"];
+    
+    NSMutableArray<UZKWriteEntry*> *entries = [NSMutableArray array];
+    NSMutableArray<NSString*> *expectedFilenames = [NSMutableArray array];
+    NSMutableArray<NSData*> *expectedData = [NSMutableArray array];
+    
+    // Repeat the test files, alternating between sources and compression methods
+    for (NSUInteger i = 0; i < 60; i++) {
+        NSString *testFile = testFiles[i % testFiles.count];
+        NSURL *testFileURL = self.testFileURLs[testFile];
+        NSString *filePath = [NSString stringWithFormat:@"%lu/%@", (unsigned long)i, testFile];
+        NSData *fileData = [NSData dataWithContentsOfURL:testFileURL];
+        
+        UZKWriteEntry *entry;
+        switch (i % 3) {
+            case 0:
+                entry = [UZKWriteEntry entryWithData:fileData filePath:filePath];
+                break;
+            case 1:
+                entry = [UZKWriteEntry entryWithContentsOfURL:testFileURL filePath:filePath];
+                break;
+            default:
+                entry = [UZKWriteEntry entryWithFilePath:filePath producer:^NSData *(NSError **error) {
+                    return fileData;
+                }];
+                break;
+        }
+        
+        entry.fileDate = testDate;
+        entry.compressionMethod = (i % 2) ? UZKCompressionMethodNone : UZKCompressionMethodBest;
+        
+        [entries addObject:entry];
+        [expectedFilenames addObject:filePath];
+        [expectedData addObject:fileData];
+    }
+    
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"WriteEntriesTest.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    archive.maxConcurrentCompressions = 4;
+    
+    NSError *writeError = nil;
+    BOOL result = [archive writeEntries:entries overwrite:YES error:&writeError];
+    
+    XCTAssertTrue(result, @"Failed to write entries");
+    XCTAssertNil(writeError, @"Error writing entries: %@", writeError);
+    
+    __block NSUInteger idx = 0;
+    NSError *readError = nil;
+    
+    [archive performOnDataInArchive:^(UZKFileInfo *fileInfo, NSData *fileData, BOOL *stop) {
+        NSData *expected = expectedData[idx];
+        unsigned long expectedCRC = crc32(0, expected.bytes, (unsigned int)expected.length);
+        
+        XCTAssertEqualObjects(fileInfo.filename, expectedFilenames[idx], @"Entries written out of order");
+        XCTAssertEqualObjects(fileInfo.timestamp, testDate, @"Incorrect timestamp in archive");
+        XCTAssertEqual(fileInfo.compressionMethod, entries[idx].compressionMethod, @"Incorrect compression method in archive");
+        XCTAssertEqual(fileInfo.CRC, expectedCRC, @"Incorrect CRC in archive");
+        XCTAssertEqualObjects(fileData, expected, @"Data extracted doesn't match what was written");
+        
+        idx++;
+    } error:&readError];
+    
+    XCTAssertNil(readError, @"Error reading archive: %@", readError);
+    XCTAssertEqual(idx, entries.count, @"Not all entries written");
+}
+
+- (void)testWriteEntries_Overwrite
+{
+    NSArray<NSString*> *testFiles = [self.nonZipTestFilePaths.allObjects sortedArrayUsingSelector:@selector(compare:)];
+    NSString *testFile = testFiles.firstObject;
+    
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"WriteEntriesTest_Overwrite.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    
+    NSData *oldData = [@"Old data" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *newData = [@"New data" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    NSError *writeError = nil;
+    XCTAssertTrue([archive writeData:oldData filePath:testFile error:&writeError], @"Failed to write initial data: %@", writeError);
+    XCTAssertTrue([archive writeData:oldData filePath:@"Untouched.txt" error:&writeError], @"Failed to write initial data: %@", writeError);
+    
+    BOOL result = [archive writeEntries:@[[UZKWriteEntry entryWithData:newData filePath:testFile]]
+                              overwrite:YES
+                                  error:&writeError];
+    
+    XCTAssertTrue(result, @"Failed to write entries");
+    XCTAssertNil(writeError, @"Error writing entries: %@", writeError);
+    
+    NSError *listError = nil;
+    NSArray<NSString*> *filenames = [archive listFilenames:&listError];
+    
+    XCTAssertNil(listError, @"Error listing files: %@", listError);
+    XCTAssertEqualObjects(filenames, (@[@"Untouched.txt", testFile]), @"Existing file not replaced");
+    XCTAssertEqualObjects([archive extractDataFromFile:testFile error:nil], newData, @"New data not written");
+}
+
+- (void)testWriteEntries_ProducerError
+{
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"WriteEntriesTest_ProducerError.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    archive.maxConcurrentCompressions = 2;
+    
+    NSInteger errorCode = 718;
+    NSData *fileData = [@"Some data" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    NSArray<UZKWriteEntry*> *entries = @[[UZKWriteEntry entryWithData:fileData filePath:@"First.txt"],
+                                         [UZKWriteEntry entryWithFilePath:@"Failing.txt" producer:^NSData *(NSError **error) {
+                                             *error = [NSError errorWithDomain:@"UnzipKitUnitTest"
+                                                                          code:errorCode
+                                                                      userInfo:@{}];
+                                             return nil;
+                                         }],
+                                         [UZKWriteEntry entryWithData:fileData filePath:@"Last.txt"]];
+    
+    NSError *writeError = nil;
+    BOOL result = [archive writeEntries:entries overwrite:YES error:&writeError];
+    
+    XCTAssertFalse(result, @"Success returned when an entry failed to load");
+    XCTAssertEqual(writeError.code, UZKErrorCodeFileRead, @"Wrong error code returned");
+    
+    NSError *underlyingError = writeError.userInfo[NSUnderlyingErrorKey];
+    XCTAssertEqual(underlyingError.code, errorCode, @"Producer's error not included");
+    
+    NSArray<NSString*> *filenames = [archive listFilenames:nil];
+    XCTAssertEqualObjects(filenames, @[@"First.txt"], @"Entries before the failure should be kept");
+}
+
+- (void)testWriteEntries_OverMemoryBudget
+{
+    NSURL *testArchiveURL = [self.tempDirectory URLByAppendingPathComponent:@"WriteEntriesTest_OverMemoryBudget.zip"];
+    UZKArchive *archive = [[UZKArchive alloc] initWithURL:testArchiveURL error:nil];
+    archive.maxConcurrentCompressions = 4;
+    
+    // Together, more than the budget for entries held in memory, so they can't all be started at once
+    NSUInteger fileSize = 40 * 1024 * 1024;
+    NSMutableArray<UZKWriteEntry*> *entries = [NSMutableArray array];
+    NSMutableArray<NSData*> *expectedData = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 4; i++) {
+        NSMutableData *fileData = [NSMutableData dataWithLength:fileSize];
+        arc4random_buf(fileData.mutableBytes, fileSize);
+        
+        UZKWriteEntry *entry = [UZKWriteEntry entryWithData:fileData
+                                                   filePath:[NSString stringWithFormat:@"%lu.bin", (unsigned long)i]];
+        entry.compressionMethod = UZKCompressionMethodNone;
+        
+        [entries addObject:entry];
+        [expectedData addObject:fileData];
+    }
+    
+    NSError *writeError = nil;
+    XCTAssertTrue([archive writeEntries:entries overwrite:NO error:&writeError], @"Failed to write entries: %@", writeError);
+    
+    for (NSUInteger i = 0; i < entries.count; i++) {
+        NSError *extractError = nil;
+        NSData *extractedData = [archive extractDataFromFile:entries[i].filePath error:&extractError];
+        
+        XCTAssertNil(extractError, @"Error extracting %@: %@", entries[i].filePath, extractError);
+        XCTAssertEqualObjects(extractedData, expectedData[i], @"Incorrect data written for %@", entries[i].filePath);
+    }
+}
+
+- (void)testWriteEntries_ExpectedLength
+{
+    NSString *testFile = @"Test File A.txt";
+    NSURL *testFileURL = self.testFileURLs[testFile];
+    NSNumber *testFileSize = nil;
+    [testFileURL getResourceValue:&testFileSize forKey:NSURLFileSizeKey error:nil];
+    
+    NSData *fileData = [@"Some data" dataUsingEncoding:NSUTF8StringEncoding];
+    
+    XCTAssertEqual([UZKWriteEntry entryWithData:fileData filePath:@"Data.txt"].expectedLength,
+                   (unsigned long long)fileData.length, @"Wrong expected length for data entry");
+    XCTAssertEqual([UZKWriteEntry entryWithContentsOfURL:testFileURL filePath:testFile].expectedLength,
+                   testFileSize.unsignedLongLongValue, @"Wrong expected length for file entry");
+    XCTAssertEqual([UZKWriteEntry entryWithFilePath:@"Produced.txt" producer:^NSData *(NSError **error) {
+        return fileData;
+    }].expectedLength, 0ULL, @"Producer entry's length shouldn't be known before it's produced");
+}
+
+
+@end